@@ -0,0 +1,60 @@
+
+#include "arena.h"
+#include "error.h"
+#include "mem.h"
+
+void arena_init(arena_t *arena) {
+  arena->first = arena->last = NULL;
+  return;
+}
+
+void arena_free(arena_t *arena) {
+  arena_chunk_t *chunk = arena->first;
+  while(chunk != NULL) {
+    arena_chunk_t *next = chunk->next;
+    mem_stat_add(MEM_ARENA, -1, -(long)(sizeof(arena_chunk_t) + chunk->capacity));
+    free(chunk);
+    chunk = next;
+  }
+  arena->first = arena->last = NULL;
+  return;
+}
+
+// Returns memory aligned to ARENA_ALIGN bytes; Contents are not initialized
+void *arena_alloc(arena_t *arena, size_t size) {
+  size = arena_round(size);
+  arena_chunk_t *chunk = arena->last;
+  if(chunk == NULL || chunk->used + size > chunk->capacity) {
+    size_t capacity = chunk == NULL ? ARENA_INIT_CHUNK_SIZE : chunk->capacity * 2;
+    if(capacity > ARENA_MAX_CHUNK_SIZE) capacity = ARENA_MAX_CHUNK_SIZE;
+    if(capacity < size) capacity = size;
+    arena_chunk_t *new_chunk = (arena_chunk_t *)malloc(sizeof(arena_chunk_t) + capacity);
+    SYSEXPECT(new_chunk != NULL);
+    new_chunk->next = NULL;
+    new_chunk->capacity = capacity;
+    new_chunk->used = 0;
+    mem_stat_add(MEM_ARENA, 1, sizeof(arena_chunk_t) + capacity);
+    if(chunk == NULL) arena->first = new_chunk;
+    else chunk->next = new_chunk;
+    arena->last = chunk = new_chunk;
+  }
+  void *ret = chunk->data + chunk->used;
+  chunk->used += size;
+  return ret;
+}
+
+// Releases all objects at once, such that the arena can be reused for temporaries; Only the newest (largest)
+// chunk is kept, so an arena that is reset regularly stays at the size of its largest working set
+void arena_reset(arena_t *arena) {
+  arena_chunk_t *chunk = arena->first;
+  if(chunk == NULL) return;
+  while(chunk != arena->last) {
+    arena_chunk_t *next = chunk->next;
+    mem_stat_add(MEM_ARENA, -1, -(long)(sizeof(arena_chunk_t) + chunk->capacity));
+    free(chunk);
+    chunk = next;
+  }
+  chunk->used = 0;
+  arena->first = chunk;
+  return;
+}
@@ -0,0 +1,36 @@
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#define ARENA_INIT_CHUNK_SIZE 512       // Bytes of the first chunk, excluding the header
+#define ARENA_MAX_CHUNK_SIZE  65536     // Chunks double in size until this limit
+#define ARENA_ALIGN           8
+
+// Bump allocator. Memory is carved from chunks in allocation order, and individual objects cannot 
+// be freed; All chunks are released together by arena_free(). Chunks are linked from the oldest to 
+// the newest, such that objects can be visited in allocation order
+typedef struct arena_chunk_t {
+  struct arena_chunk_t *next;
+  size_t capacity;
+  size_t used;
+  char data[];
+} arena_chunk_t;
+
+typedef struct {
+  arena_chunk_t *first;      // NULL until the first allocation
+  arena_chunk_t *last;       // Allocations are served from this chunk
+} arena_t;
+
+void arena_init(arena_t *arena);
+void arena_free(arena_t *arena);
+void *arena_alloc(arena_t *arena, size_t size);
+void arena_reset(arena_t *arena);
+
+static inline size_t arena_round(size_t size) { return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1); }
+
+#endif
@@ -61,29 +61,203 @@ token_t *ast_remove(token_t *token) {
   return token;
 }
 
+// Replaces the node in place with a subtree, which is either detached or a child of the node, such that 
+// links to the node remain valid. Other children of the node are freed, and the root of the subtree is 
+// freed after its contents are moved
+void ast_replace(token_t *token, token_t *with) {
+  token_t *child = token->child;
+  while(child != NULL) {
+    token_t *next = child->sibling;
+    if(child != with) ast_free(child);
+    child = next;
+  }
+  if(token->type >= T_LITERALS_BEGIN && token->type < T_LITERALS_END) {
+    if(mem_stat_enabled) mem_stat_add(MEM_TOKEN_STR, -1, -(long)(strlen(token->str) + 1));
+    free(token->str);
+  }
+  token->type = with->type;
+  token->str = with->str;
+  token->child = with->child;
+  token->offset = with->offset;
+  token->decl_prop = with->decl_prop;
+  token->exp_type = with->exp_type;
+  for(child = token->child;child != NULL;child = child->sibling) child->parent = token;
+  with->type = T_; // The string has been moved
+  with->child = NULL;
+  token_free(with);
+  return;
+}
+
 void ast_print(token_t *token) { ast_print_(token, 0); }
 
+// Prints nodes in pre-order using an explicit stack of (node, depth) pairs, such that the depth
+// of the tree is not limited by the C stack
 void ast_print_(token_t *token, int depth) {
-  for(int i = 0;i < depth * 2;i++) if(i % 2 == 0) printf("|"); else printf(" ");
-  const char *symstr = token_symstr(token->type);
-  printf("%04d:%04d:%s %s\n", 
-         token->type, 
-         token->offset ? error_get_offset(token->offset) : 0,
-         token_typestr(token->type), 
-         token->type == T_BASETYPE ? token_decl_print(token->decl_prop) : 
-          (symstr == NULL ? (token->type >= T_LITERALS_BEGIN && token->type < T_LITERALS_END ? token->str : "") : symstr));
-  for(token_t *child = token->child;child != NULL; child = child->sibling) ast_print_(child, depth + 1);
+  stack_t *stack = stack_init();
+  stack_push(stack, token);
+  stack_push(stack, (void *)(long)depth);
+  while(!stack_empty(stack)) {
+    depth = (int)(long)stack_pop(stack);
+    token = (token_t *)stack_pop(stack);
+    for(int i = 0;i < depth * 2;i++) if(i % 2 == 0) printf("|"); else printf(" ");
+    const char *symstr = token_symstr(token->type);
+    printf("%04d:%04d:%s %s\n", 
+          token->type, 
+          token->offset ? error_get_offset(token->offset) : 0,
+          token_typestr(token->type), 
+          token->type == T_BASETYPE ? token_decl_print(token->decl_prop) : 
+            (symstr == NULL ? (token->type >= T_LITERALS_BEGIN && token->type < T_LITERALS_END ? token->str : "") : symstr));
+    // Children are pushed in order and then reversed, such that the first child is popped first
+    int base = stack_size(stack);
+    for(token_t *child = token->child;child != NULL; child = child->sibling) {
+      stack_push(stack, child);
+      stack_push(stack, (void *)(long)(depth + 1));
+    }
+    for(int i = base, j = stack_size(stack) - 2;i < j;i += 2, j -= 2) {
+      void *temp = stack->data[i];
+      stack->data[i] = stack->data[j];
+      stack->data[j] = temp;
+    }
+  }
+  stack_free(stack);
   return;
 }
 
-// Releases memory for every node in the AST
+// Releases memory for every node in the AST. Children of a node are appended to a work list linked 
+// by sibling pointers before the node is freed, so neither recursion nor a stack is needed
 void ast_free(token_t *token) {
-  while(token->child != NULL) {
-    token_t *next = token->child->sibling;
-    ast_free(token->child);
-    token->child = next;
+  token_t *tail = token;
+  token->sibling = NULL;
+  while(token != NULL) {
+    if(token->child != NULL) {
+      tail->sibling = token->child;
+      while(tail->sibling != NULL) tail = tail->sibling;
+    }
+    token_t *next = token->sibling;
+    token_free(token);
+    token = next;
+  }
+  return;
+}
+
+// Prints the number of nodes and literal bytes of each token type in the AST
+void ast_print_census(token_t *token, FILE *fp) {
+  long *counts = (long *)calloc((T_ILLEGAL + 1) * 2, sizeof(long));
+  SYSEXPECT(counts != NULL);
+  long *str_bytes = counts + T_ILLEGAL + 1;
+  stack_t *stack = stack_init();
+  stack_push(stack, token);
+  while(!stack_empty(stack)) {
+    token = (token_t *)stack_pop(stack);
+    assert(token->type >= 0 && token->type <= T_ILLEGAL);
+    counts[token->type]++;
+    if(token->type >= T_LITERALS_BEGIN && token->type < T_LITERALS_END) str_bytes[token->type] += strlen(token->str) + 1;
+    for(token_t *child = token->child;child != NULL; child = child->sibling) stack_push(stack, child);
+  }
+  stack_free(stack);
+  long total = 0;
+  fprintf(fp, "%-24s %10s %10s %12s\n", "Token Type", "Nodes", "Bytes", "Str Bytes");
+  for(int i = 0;i <= T_ILLEGAL;i++) {
+    if(counts[i] == 0) continue;
+    fprintf(fp, "%-24s %10ld %10ld %12ld\n", token_typestr(i), counts[i], counts[i] * (long)sizeof(token_t), str_bytes[i]);
+    total += counts[i];
+  }
+  fprintf(fp, "%-24s %10ld %10ld\n", "(all)", total, total * (long)sizeof(token_t));
+  free(counts);
+  return;
+}
+
+// Moves source pointers of every node in the AST from the old text to the new text, where the 
+// subtree is displaced by delta bytes. Unparsed bodies also carry an end pointer in str
+// Memoized types are cleared, since the subtree will be checked again by another context
+void ast_relocate(token_t *token, char *old_input, char *new_input, long delta) {
+  stack_t *stack = stack_init();
+  stack_push(stack, token);
+  while(!stack_empty(stack)) {
+    token = (token_t *)stack_pop(stack);
+    if(token->offset) token->offset = new_input + (token->offset - old_input + delta);
+    if(token->type == T_LAZY_BODY) token->str = new_input + (token->str - old_input + delta);
+    token->exp_type = NULL;
+    for(token_t *child = token->child;child != NULL; child = child->sibling) stack_push(stack, child);
+  }
+  stack_free(stack);
+  return;
+}
+
+// Clears types memoized by type_typeof() in the subtree. Types live in the scopes and the context 
+// of the check pass that derived them, so they must be cleared before the tree is checked again, or 
+// before the scopes are released
+void ast_clear_types(token_t *token) {
+  stack_t *stack = stack_init();
+  stack_push(stack, token);
+  while(!stack_empty(stack)) {
+    token = (token_t *)stack_pop(stack);
+    token->exp_type = NULL;
+    for(token_t *child = token->child;child != NULL; child = child->sibling) stack_push(stack, child);
+  }
+  stack_free(stack);
+  return;
+}
+
+void ast_walk_init(ast_walk_t *walk) {
+  walk->stacks = NULL;
+  walk->depth = walk->capacity = 0;
+  return;
+}
+
+void ast_walk_free(ast_walk_t *walk) {
+  for(int i = 0;i < walk->capacity;i++) stack_free(walk->stacks[i]);
+  free(walk->stacks);
+  ast_walk_init(walk);
+  return;
+}
+
+// Generic post-order traversal using explicit stacks. For each node the first arity() children are 
+// visited from left to right, and then visit() is called with their results as an array. Returns the
+// result of the root. Callbacks may start another traversal with the same walk object, which then 
+// uses the next pair of stacks
+void *ast_postorder(ast_walk_t *walk, token_t *token, ast_arity_cb_t arity, ast_visit_cb_t visit, void *arg) {
+  if(walk->depth + 2 > walk->capacity) {
+    walk->stacks = (stack_t **)realloc(walk->stacks, sizeof(stack_t *) * (walk->capacity + 2));
+    SYSEXPECT(walk->stacks != NULL);
+    walk->stacks[walk->capacity++] = stack_init();
+    walk->stacks[walk->capacity++] = stack_init();
+  }
+  stack_t *frames = walk->stacks[walk->depth], *results = walk->stacks[walk->depth + 1];
+  frames->size = results->size = 0; // May be left by a traversal abandoned by an error
+  walk->depth += 2;
+  // Each frame has four slots: node, arity, next child to visit, and children left to visit
+  int count = arity(token, arg);
+  stack_push(frames, token);
+  stack_push(frames, (void *)(long)count);
+  stack_push(frames, token->child);
+  stack_push(frames, (void *)(long)count);
+  while(!stack_empty(frames)) {
+    void **top = stack_topaddr(frames);
+    long left = (long)top[-1];
+    if(left != 0) {
+      token_t *child = (token_t *)top[-2];
+      assert(child != NULL);
+      top[-1] = (void *)(left - 1);
+      top[-2] = child->sibling;
+      count = arity(child, arg);
+      stack_push(frames, child);
+      stack_push(frames, (void *)(long)count);
+      stack_push(frames, child->child);
+      stack_push(frames, (void *)(long)count);
+      continue;
+    }
+    frames->size -= 2;
+    count = (int)(long)stack_pop(frames);
+    token = (token_t *)stack_pop(frames);
+    void *result = visit(token, stack_topaddr(results) - count, arg);
+    results->size -= count;
+    stack_push(results, result);
   }
-  token_free(token);
+  void *result = stack_pop(results);
+  assert(stack_empty(results));
+  walk->depth -= 2;
+  return result;
 }
 
 int ast_child_count(token_t *token) {
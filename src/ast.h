@@ -4,6 +4,18 @@
 
 #include "token.h"
 
+typedef int (*ast_arity_cb_t)(token_t *token, void *arg);                // Number of children to visit
+typedef void *(*ast_visit_cb_t)(token_t *token, void **results, void *arg); // Called after the children
+
+// Stacks of ast_postorder() owned by the caller and reused across traversals. Each level of nested 
+// traversals takes its own pair of stacks. A traversal abandoned by an error leaves its pair, which is 
+// reused once the owner resets depth to 0; The stacks are only released by ast_walk_free()
+typedef struct {
+  stack_t **stacks;
+  int depth;                 // Number of stacks in use
+  int capacity;
+} ast_walk_t;
+
 token_t *ast_make_node(token_t *token);
 int ast_isleaf(token_t *token);
 void ast_update_offset(token_t *token);
@@ -11,9 +23,16 @@ token_t *ast_append_child(token_t *token, token_t *child);
 token_t *ast_push_child(token_t *token, token_t *child);
 token_t *ast_insert_after(token_t *token, token_t *child);
 token_t *ast_remove(token_t *token);
+void ast_replace(token_t *token, token_t *with);
 void ast_print(token_t *token);
 void ast_print_(token_t *token, int depth);
 void ast_free(token_t *token);
+void ast_print_census(token_t *token, FILE *fp);
+void ast_relocate(token_t *token, char *old_input, char *new_input, long delta);
+void ast_clear_types(token_t *token);
+void ast_walk_init(ast_walk_t *walk);
+void ast_walk_free(ast_walk_t *walk);
+void *ast_postorder(ast_walk_t *walk, token_t *token, ast_arity_cb_t arity, ast_visit_cb_t visit, void *arg);
 int ast_child_count(token_t *token);
 token_t *ast_getchild(token_t *token, int index);
 void ast_collect_funcarg(token_t *token);
@@ -0,0 +1,252 @@
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ast_serial.h"
+
+// 64-bit FNV-1a hash of the source text; Used to decide whether a cached file is still valid
+uint64_t ast_serial_hash(const char *input) {
+  uint64_t hash = 0xCBF29CE484222325UL;
+  for(const unsigned char *p = (const unsigned char *)input;*p != '\0';p++) {
+    hash ^= *p;
+    hash *= 0x100000001B3UL;
+  }
+  return hash;
+}
+
+// Returns the offset of the string in the table; Identical strings are stored only once
+uint32_t ast_serial_intern(hashtable_t *strs, str_t *table, const char *s) {
+  void *offset = ht_find(strs, (void *)s);
+  if(offset != HT_NOTFOUND) return (uint32_t)(uintptr_t)offset;
+  uint32_t ret = (uint32_t)str_size(table);
+  str_concat(table, s);
+  str_append(table, '\0');
+  ht_insert(strs, (void *)s, (void *)(uintptr_t)ret);
+  return ret;
+}
+
+// Serializes the AST into a malloc'ed buffer and returns it; Size is written to the argument
+// Nodes are laid out in pre-order using an explicit stack, such that the first child of a node
+// always follows it. Sibling links are patched when the next node of the same depth is written
+char *ast_serial_pack(token_t *root, const char *input, uint32_t *size) {
+  int capacity = 64, count = 0, depth_capacity = 64;
+  ast_serial_node_t *nodes = (ast_serial_node_t *)malloc(sizeof(ast_serial_node_t) * capacity);
+  uint32_t *locs = (uint32_t *)malloc(sizeof(uint32_t) * capacity);
+  int *last = (int *)malloc(sizeof(int) * depth_capacity); // Last node written at each depth
+  SYSEXPECT(nodes != NULL && locs != NULL && last != NULL);
+  hashtable_t *strs = ht_str_init();
+  str_t *table = str_init();
+  stack_t *stack = stack_init(), *rev = stack_init();
+  last[0] = -1;
+  stack_push(stack, root);
+  stack_push(stack, (void *)0L);
+  while(!stack_empty(stack)) {
+    int depth = (int)(long)stack_pop(stack);
+    token_t *token = (token_t *)stack_pop(stack);
+    if(count == capacity) {
+      capacity *= 2;
+      nodes = (ast_serial_node_t *)realloc(nodes, sizeof(ast_serial_node_t) * capacity);
+      locs = (uint32_t *)realloc(locs, sizeof(uint32_t) * capacity);
+      SYSEXPECT(nodes != NULL && locs != NULL);
+    }
+    if(depth + 1 >= depth_capacity) {
+      depth_capacity *= 2;
+      last = (int *)realloc(last, sizeof(int) * depth_capacity);
+      SYSEXPECT(last != NULL);
+    }
+    ast_serial_node_t *node = &nodes[count];
+    node->type = token->type;
+    node->decl_prop = token->decl_prop;
+    node->child = token->child ? 1 : 0;
+    node->sibling = 0;
+    if(token->type == T_LAZY_BODY) node->str = (uint32_t)(token->str - input);
+    else if(token->type >= T_LITERALS_BEGIN && token->type < T_LITERALS_END) node->str = ast_serial_intern(strs, table, token->str);
+    else node->str = AST_SERIAL_NONE;
+    locs[count] = token->offset ? (uint32_t)(token->offset - input) : AST_SERIAL_NONE;
+    if(last[depth] != -1) nodes[last[depth]].sibling = count - last[depth];
+    last[depth] = count++;
+    last[depth + 1] = -1;
+    // Push children in reverse order such that the first child is popped first
+    for(token_t *child = token->child;child != NULL;child = child->sibling) stack_push(rev, child);
+    while(!stack_empty(rev)) {
+      stack_push(stack, stack_pop(rev));
+      stack_push(stack, (void *)(long)(depth + 1));
+    }
+  }
+  ast_serial_header_t header;
+  header.magic = AST_SERIAL_MAGIC;
+  header.version = AST_SERIAL_VERSION;
+  header.hash = ast_serial_hash(input);
+  header.node_count = count;
+  header.node_offset = sizeof(ast_serial_header_t);
+  header.loc_offset = header.node_offset + sizeof(ast_serial_node_t) * count;
+  header.str_offset = header.loc_offset + sizeof(uint32_t) * count;
+  header.str_size = str_size(table);
+  header.size = header.str_offset + header.str_size;
+  char *buffer = (char *)malloc(header.size);
+  SYSEXPECT(buffer != NULL);
+  memcpy(buffer, &header, sizeof(ast_serial_header_t));
+  memcpy(buffer + header.node_offset, nodes, sizeof(ast_serial_node_t) * count);
+  memcpy(buffer + header.loc_offset, locs, sizeof(uint32_t) * count);
+  memcpy(buffer + header.str_offset, str_cstr(table), header.str_size);
+  *size = header.size;
+  stack_free(stack);
+  stack_free(rev);
+  str_free(table);
+  ht_free(strs);
+  free(last);
+  free(locs);
+  free(nodes);
+  return buffer;
+}
+
+void ast_serial_write(const char *path, token_t *root, const char *input) {
+  uint32_t size;
+  char *buffer = ast_serial_pack(root, input, &size);
+  FILE *fp = fopen(path, "wb");
+  SYSEXPECT(fp != NULL);
+  SYSEXPECT(fwrite(buffer, size, 1, fp) == 1);
+  fclose(fp);
+  free(buffer);
+  return;
+}
+
+// Whether the image of the given size is well formed, such that nodes can be walked and unpacked 
+// without reading out of bounds. Tables must be inside the image, and links must only point forward 
+// to nodes that no other link points to, which makes the nodes a tree rooted at node 0. Source text
+// offsets are checked against the text by ast_serial_isvalid()
+int ast_serial_check(const char *base, uint32_t size) {
+  if(size < sizeof(ast_serial_header_t)) return 0;
+  const ast_serial_header_t *header = (const ast_serial_header_t *)base;
+  uint64_t count = header->node_count;
+  if(header->magic != AST_SERIAL_MAGIC || header->version != AST_SERIAL_VERSION || header->size != size) return 0;
+  if(count == 0 || header->node_offset < sizeof(ast_serial_header_t)) return 0;
+  if(header->node_offset % sizeof(uint32_t) != 0 || header->loc_offset % sizeof(uint32_t) != 0) return 0;
+  if(header->node_offset + count * sizeof(ast_serial_node_t) > size) return 0;
+  if(header->loc_offset + count * sizeof(uint32_t) > size) return 0;
+  if((uint64_t)header->str_offset + header->str_size > size) return 0;
+  if(header->str_size != 0 && base[header->str_offset + header->str_size - 1] != '\0') return 0;
+  const ast_serial_node_t *nodes = (const ast_serial_node_t *)(base + header->node_offset);
+  if(nodes[0].sibling != 0) return 0;
+  char *linked = (char *)calloc(count, 1);
+  SYSEXPECT(linked != NULL);
+  int valid = 1;
+  for(uint64_t i = 0;i < count && valid;i++) {
+    const ast_serial_node_t *node = &nodes[i];
+    int32_t links[2] = {node->child, node->sibling};
+    for(int j = 0;j < 2 && valid;j++) {
+      if(links[j] == 0) continue;
+      valid = links[j] > 0 && (uint64_t)links[j] < count - i && !linked[i + links[j]];
+      if(valid) linked[i + links[j]] = 1;
+    }
+    if(node->type == T_LAZY_BODY) continue;
+    if(node->type >= T_LITERALS_BEGIN && node->type < T_LITERALS_END) valid = valid && node->str < header->str_size;
+    else valid = valid && node->str == AST_SERIAL_NONE;
+  }
+  for(uint64_t i = 1;i < count && valid;i++) valid = linked[i];
+  free(linked);
+  return valid;
+}
+
+// Wraps a serialized image of the given size; If mapped is zero the buffer is owned and freed with 
+// the object. Returns NULL if the image is not a valid serialized AST, in which case the caller 
+// still owns the buffer
+ast_serial_t *ast_serial_init(char *base, uint32_t size, int mapped) {
+  if(!ast_serial_check(base, size)) return NULL;
+  ast_serial_header_t *header = (ast_serial_header_t *)base;
+  ast_serial_t *ser = (ast_serial_t *)malloc(sizeof(ast_serial_t));
+  SYSEXPECT(ser != NULL);
+  ser->base = base;
+  ser->mapped = mapped;
+  ser->header = header;
+  ser->nodes = (ast_serial_node_t *)(base + header->node_offset);
+  ser->locs = (uint32_t *)(base + header->loc_offset);
+  ser->strs = base + header->str_offset;
+  return ser;
+}
+
+// Maps a file written by ast_serial_write(); Returns NULL if the file cannot be used
+ast_serial_t *ast_serial_open(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if(fd == -1) return NULL;
+  struct stat st;
+  SYSEXPECT(fstat(fd, &st) == 0);
+  if((size_t)st.st_size < sizeof(ast_serial_header_t) || (uint64_t)st.st_size > UINT32_MAX) {
+    close(fd);
+    return NULL;
+  }
+  char *base = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  SYSEXPECT(base != MAP_FAILED);
+  ast_serial_t *ser = ast_serial_init(base, (uint32_t)st.st_size, 1);
+  if(ser == NULL) {
+    munmap(base, st.st_size);
+    return NULL;
+  }
+  return ser;
+}
+
+void ast_serial_free(ast_serial_t *ser) {
+  if(ser->mapped) munmap(ser->base, ser->header->size);
+  else free(ser->base);
+  free(ser);
+  return;
+}
+
+// Whether the serialized AST is produced from the given text; Source offsets must also be inside 
+// the text, such that unpacking a corrupted image that happens to match the hash is still safe
+int ast_serial_isvalid(ast_serial_t *ser, const char *input) {
+  if(ser->header->hash != ast_serial_hash(input)) return 0;
+  uint32_t len = (uint32_t)strlen(input);
+  for(uint32_t i = 0;i < ser->header->node_count;i++) {
+    if(ser->locs[i] != AST_SERIAL_NONE && ser->locs[i] > len) return 0;
+    if(ser->nodes[i].type == T_LAZY_BODY && ser->nodes[i].str > len) return 0;
+  }
+  return 1;
+}
+
+// Returns the string of a literal node, or NULL
+const char *ast_serial_str(ast_serial_t *ser, ast_serial_node_t *node) {
+  if(node->str == AST_SERIAL_NONE || node->type == T_LAZY_BODY) return NULL;
+  return ser->strs + node->str;
+}
+
+// Returns the byte offset of the node in source text, or -1 if the node has no location
+int ast_serial_loc(ast_serial_t *ser, ast_serial_node_t *node) {
+  uint32_t loc = ser->locs[node - ser->nodes];
+  return loc == AST_SERIAL_NONE ? -1 : (int)loc;
+}
+
+// Rebuilds the token tree; Offsets point into the given text, which should have the same hash
+token_t *ast_serial_unpack(ast_serial_t *ser, char *input) {
+  uint32_t count = ser->header->node_count;
+  token_t **tokens = (token_t **)malloc(sizeof(token_t *) * count);
+  SYSEXPECT(tokens != NULL);
+  for(uint32_t i = 0;i < count;i++) {
+    ast_serial_node_t *node = &ser->nodes[i];
+    token_t *token = tokens[i] = token_alloc_type((token_type_t)node->type);
+    token->decl_prop = node->decl_prop;
+    if(ser->locs[i] != AST_SERIAL_NONE) token->offset = input + ser->locs[i];
+    if(node->type == T_LAZY_BODY) token->str = input + node->str;
+    else if(node->str != AST_SERIAL_NONE) {
+      const char *s = ser->strs + node->str;
+      token_copy_literal(token, s, s + strlen(s));
+    }
+  }
+  // Parents always precede children and previous siblings, so the parent is known when linking
+  for(uint32_t i = 0;i < count;i++) {
+    ast_serial_node_t *node = &ser->nodes[i];
+    if(node->child) {
+      tokens[i]->child = tokens[i + node->child];
+      tokens[i + node->child]->parent = tokens[i];
+    }
+    if(node->sibling) {
+      tokens[i]->sibling = tokens[i + node->sibling];
+      tokens[i + node->sibling]->parent = tokens[i]->parent;
+    }
+  }
+  token_t *root = tokens[0];
+  free(tokens);
+  return root;
+}
@@ -0,0 +1,61 @@
+
+#ifndef _AST_SERIAL_H
+#define _AST_SERIAL_H
+
+#include <stdint.h>
+#include "token.h"
+#include "ast.h"
+#include "str.h"
+
+#define AST_SERIAL_MAGIC   0x54534143 // "CAST" in little endian
+#define AST_SERIAL_VERSION 1
+#define AST_SERIAL_NONE    0xFFFFFFFF // No string or no location
+
+// File layout: header, node array, location table, string table. All offsets in the header are
+// byte offsets from the beginning of the file, such that the file can be used after mmap
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t hash;             // Content hash of the source text
+  uint32_t size;             // Size of the file
+  uint32_t node_count;       // Node 0 is the root; Nodes are in pre-order
+  uint32_t node_offset;
+  uint32_t loc_offset;       // One entry per node, which is a byte offset into the source text
+  uint32_t str_offset;       // Interned zero-terminated strings
+  uint32_t str_size;
+} ast_serial_header_t;
+
+typedef struct {
+  uint32_t type;
+  uint32_t decl_prop;
+  int32_t child;             // Relative index of the first child in the node array; 0 if none
+  int32_t sibling;           // Relative index of the next sibling in the node array; 0 if none
+  uint32_t str;              // Offset into the string table; For T_LAZY_BODY this is the end offset in source
+} ast_serial_node_t;
+
+typedef struct {
+  char *base;                // Either mapped or malloc'ed
+  int mapped;
+  ast_serial_header_t *header;
+  ast_serial_node_t *nodes;
+  uint32_t *locs;
+  const char *strs;
+} ast_serial_t;
+
+inline static ast_serial_node_t *ast_serial_root(ast_serial_t *ser) { return ser->nodes; }
+inline static ast_serial_node_t *ast_serial_child(ast_serial_node_t *node) { return node->child ? node + node->child : NULL; }
+inline static ast_serial_node_t *ast_serial_sibling(ast_serial_node_t *node) { return node->sibling ? node + node->sibling : NULL; }
+
+uint64_t ast_serial_hash(const char *input);
+char *ast_serial_pack(token_t *root, const char *input, uint32_t *size);
+void ast_serial_write(const char *path, token_t *root, const char *input);
+int ast_serial_check(const char *base, uint32_t size);
+ast_serial_t *ast_serial_init(char *base, uint32_t size, int mapped);
+ast_serial_t *ast_serial_open(const char *path);
+void ast_serial_free(ast_serial_t *ser);
+int ast_serial_isvalid(ast_serial_t *ser, const char *input);
+const char *ast_serial_str(ast_serial_t *ser, ast_serial_node_t *node);
+int ast_serial_loc(ast_serial_t *ser, ast_serial_node_t *node);
+token_t *ast_serial_unpack(ast_serial_t *ser, char *input);
+
+#endif
@@ -0,0 +1,255 @@
+
+#include "parse.h"
+#include "cgen.h"
+#include "str.h"
+#include <time.h>
+#include <malloc.h>
+#include <sys/resource.h>
+
+// Front-end throughput benchmark. Each case generates a translation unit, and then runs parse(),
+// cgen() and the release of both as separate phases. Allocation calls are counted by wrapping the
+// allocator at link time (see "make bench"); Peak RSS is reset before each phase when the kernel
+// allows it through /proc/self/clear_refs, otherwise the process-wide peak is reported.
+// Usage: bench_front [-m] [scale], where scale multiplies the size of all generated inputs, and -m
+// prints memory accounting per object kind and AST node counts per token type after cgen()
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+// Allocator statistics of the current phase; Not thread-safe, the benchmark is single-threaded
+typedef struct {
+  long alloc_count;           // malloc, calloc and realloc calls
+  long free_count;
+  long alloc_bytes;           // Total usable bytes returned by the allocator
+  long live_bytes;
+  long peak_live_bytes;
+} bench_mem_t;
+
+bench_mem_t bench_mem;
+
+void bench_mem_add(void *p) {
+  if(p == NULL) return;
+  long size = (long)malloc_usable_size(p);
+  bench_mem.alloc_count++;
+  bench_mem.alloc_bytes += size;
+  bench_mem.live_bytes += size;
+  if(bench_mem.live_bytes > bench_mem.peak_live_bytes) bench_mem.peak_live_bytes = bench_mem.live_bytes;
+}
+
+void bench_mem_remove(void *p) {
+  if(p == NULL) return;
+  bench_mem.free_count++;
+  bench_mem.live_bytes -= (long)malloc_usable_size(p);
+}
+
+void *__wrap_malloc(size_t size) {
+  void *p = __real_malloc(size);
+  bench_mem_add(p);
+  return p;
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  void *p = __real_calloc(count, size);
+  bench_mem_add(p);
+  return p;
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+  bench_mem_remove(p);
+  void *ret = __real_realloc(p, size);
+  if(ret == NULL) bench_mem_add(p); // The old block is still valid
+  else bench_mem_add(ret);
+  return ret;
+}
+
+void __wrap_free(void *p) {
+  bench_mem_remove(p);
+  __real_free(p);
+}
+
+// Returns the peak RSS of the process in KB, from VmHWM or getrusage()
+long bench_peak_rss() {
+  FILE *fp = fopen("/proc/self/status", "r");
+  if(fp != NULL) {
+    char line[256];
+    long kb = -1;
+    while(fgets(line, sizeof(line), fp) != NULL) {
+      if(strncmp(line, "VmHWM:", 6) == 0) { kb = atol(line + 6); break; }
+    }
+    fclose(fp);
+    if(kb != -1) return kb;
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// Resets the peak RSS to the current RSS; Returns 0 if not supported
+int bench_reset_rss() {
+  FILE *fp = fopen("/proc/self/clear_refs", "w");
+  if(fp == NULL) return 0;
+  int ret = fputs("5", fp) >= 0;
+  if(fclose(fp) != 0) ret = 0;
+  return ret;
+}
+
+typedef struct {
+  struct timespec begin;
+  int rss_reset;
+  long live_bytes;            // Live bytes when the phase starts
+} bench_phase_t;
+
+void bench_phase_begin(bench_phase_t *phase) {
+  long live_bytes = bench_mem.live_bytes;
+  memset(&bench_mem, 0x00, sizeof(bench_mem_t));
+  bench_mem.live_bytes = bench_mem.peak_live_bytes = live_bytes;
+  phase->live_bytes = live_bytes;
+  phase->rss_reset = bench_reset_rss();
+  clock_gettime(CLOCK_MONOTONIC, &phase->begin);
+}
+
+void bench_phase_end(bench_phase_t *phase, const char *name) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double ms = (end.tv_sec - phase->begin.tv_sec) * 1e3 + (end.tv_nsec - phase->begin.tv_nsec) / 1e6;
+  printf("  %-6s %10.2f ms %10ld allocs %10ld frees %12ld bytes %12ld peak-live %8ld KB peak-rss%s\n",
+    name, ms, bench_mem.alloc_count, bench_mem.free_count, bench_mem.alloc_bytes,
+    bench_mem.peak_live_bytes - phase->live_bytes, bench_peak_rss(), phase->rss_reset ? "" : " (process)");
+  fflush(stdout);
+}
+
+void bench_appendf(str_t *s, const char *fmt, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
+  str_concat(s, buffer);
+}
+
+// Generators; Each appends a translation unit of roughly n items to the string
+
+void bench_gen_small_funcs(str_t *s, int n) {
+  for(int i = 0;i < n;i++) {
+    bench_appendf(s, "int f%d(int a, int b) { int c = a + b * %d; if(c > 0) return c << 1; "
+                     "while(a < b) a++; return a - b; }\n", i, i);
+  }
+}
+
+void bench_gen_giant_func(str_t *s, int n) {
+  str_concat(s, "int giant(int a, int b) {\n  int x = 0, y = 1;\n");
+  for(int i = 0;i < n;i++) {
+    bench_appendf(s, "  x = x + (a * %d - b) / (y | %d); if(x > %d) y = x & 0xff; else y += a;\n", i, i + 1, i);
+  }
+  str_concat(s, "  return x + y;\n}\n");
+}
+
+void bench_gen_deep_nesting(str_t *s, int n) {
+  str_concat(s, "int deep(int a) {\n");
+  for(int i = 0;i < n;i++) bench_appendf(s, "if(a > %d) {\n", i);
+  str_concat(s, "a = 0;\n");
+  for(int i = 0;i < n;i++) str_concat(s, "}\n");
+  str_concat(s, "return a;\n}\nint deep_exp = ");
+  for(int i = 0;i < n;i++) str_concat(s, "(1 + ");
+  str_concat(s, "1");
+  for(int i = 0;i < n;i++) str_concat(s, ")");
+  str_concat(s, ";\n");
+}
+
+// Left-deep constant expressions ((a + b) + c) + ... as generated for tables; Every level converts its operands
+void bench_gen_deep_const(str_t *s, int n) {
+  str_concat(s, "enum { e0, e1, e2, e3, e4, e5, e6, e7 } deep_enum;\nlong deep_const = ");
+  for(int i = 0;i < n;i++) str_append(s, '(');
+  str_concat(s, "e0");
+  for(int i = 0;i < n;i++) {
+    if(i % 3 == 2) bench_appendf(s, " ^ (long)%d)", i);
+    else bench_appendf(s, " + e%d)", i % 8);
+  }
+  str_concat(s, ";\nenum { e_deep = ");
+  for(int i = 0;i < n;i++) str_append(s, '(');
+  str_concat(s, "1");
+  for(int i = 0;i < n;i++) bench_appendf(s, i % 2 ? " ^ %du)" : " * %du)", i % 2 ? i & 0xff : 1);
+  str_concat(s, " & 0xff } deep_enum2;\nint deep_table[e_deep + 1];\n");
+}
+
+void bench_gen_wide_struct(str_t *s, int n) {
+  str_concat(s, "struct wide {\n");
+  for(int i = 0;i < n;i++) {
+    bench_appendf(s, "  %s m%d;\n", i % 3 == 0 ? "int" : (i % 3 == 1 ? "unsigned" : "long"), i);
+  }
+  str_concat(s, "} w0;\nstruct wide w = {");
+  for(int i = 0;i < n;i++) bench_appendf(s, "%d, ", i % 100);
+  str_concat(s, "};\nunsigned long wide_size = sizeof(struct wide);\n");
+}
+
+void bench_gen_init_list(str_t *s, int n) {
+  str_concat(s, "int big[] = {");
+  for(int i = 0;i < n;i++) bench_appendf(s, "%d, ", i);
+  str_concat(s, "};\nint big2d[][4] = {");
+  for(int i = 0;i < n / 4;i++) bench_appendf(s, "{%d, %d, %d, %d}, ", i, i + 1, i + 2, i + 3);
+  str_concat(s, "};\n");
+}
+
+void bench_gen_typedefs(str_t *s, int n) {
+  for(int i = 0;i < n;i++) {
+    if(i == 0) str_concat(s, "typedef int T0;\n");
+    else bench_appendf(s, "typedef T%d T%d;\n", i - 1, i);
+    bench_appendf(s, "T%d v%d = (T%d)%d;\n", i, i, i, i);
+  }
+}
+
+typedef struct {
+  const char *name;
+  void (*gen)(str_t *, int);
+  int n;                      // Size at scale 1
+} bench_case_t;
+
+bench_case_t bench_cases[] = {
+  {"many small functions", bench_gen_small_funcs, 5000},
+  {"one giant function", bench_gen_giant_func, 5000},
+  {"deep nesting", bench_gen_deep_nesting, 500},
+  {"deep constant expression", bench_gen_deep_const, 20000},
+  {"wide struct", bench_gen_wide_struct, 5000},
+  {"huge initializer list", bench_gen_init_list, 20000},
+  {"many typedefs", bench_gen_typedefs, 10000},
+};
+
+void bench_run(bench_case_t *bench, int scale, int mem_report) {
+  str_t *s = str_init();
+  bench->gen(s, bench->n * scale);
+  printf("%s (n = %d, %d bytes)\n", bench->name, bench->n * scale, str_size(s));
+  mem_stat_reset(); // Objects of the previous case are all released
+  bench_phase_t phase;
+  bench_phase_begin(&phase);
+  parse_cxt_t *parse_cxt = parse_init(str_cstr(s));
+  token_t *root = parse(parse_cxt);
+  bench_phase_end(&phase, "parse");
+  bench_phase_begin(&phase);
+  cgen_cxt_t *cgen_cxt = cgen_init();
+  cgen(cgen_cxt, root);
+  bench_phase_end(&phase, "cgen");
+  if(mem_report) {
+    mem_stat_print(stdout);
+    ast_print_census(root, stdout);
+  }
+  bench_phase_begin(&phase);
+  cgen_free(cgen_cxt);
+  ast_free(root);
+  parse_free(parse_cxt);
+  bench_phase_end(&phase, "free");
+  str_free(s);
+}
+
+int main(int argc, char **argv) {
+  int mem_report = argc > 1 && strcmp(argv[1], "-m") == 0;
+  int scale = argc > 1 + mem_report ? atoi(argv[1 + mem_report]) : 1;
+  if(scale <= 0) {
+    fprintf(stderr, "Usage: %s [-m] [scale]\n", argv[0]);
+    return 1;
+  }
+  if(mem_report) mem_stat_enable(1);
+  for(size_t i = 0;i < sizeof(bench_cases) / sizeof(bench_cases[0]);i++) bench_run(&bench_cases[i], scale, mem_report);
+  return 0;
+}
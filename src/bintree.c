@@ -6,9 +6,44 @@ btnode_t *btnode_alloc(void *key, void *value) {
   SYSEXPECT(node != NULL);
   node->key = key, node->value = value;
   node->left = node->right = NULL;
+  node->height = 1;
+  mem_stat_add(MEM_BINTREE, 0, sizeof(btnode_t));
+  return node;
+}
+void btnode_free(btnode_t *node) { mem_stat_add(MEM_BINTREE, 0, -(long)sizeof(btnode_t)); free(node); }
+
+int btnode_height(btnode_t *node) { return node ? node->height : 0; }
+
+// Recomputes the height of the node from its children
+void btnode_update(btnode_t *node) {
+  int left = btnode_height(node->left), right = btnode_height(node->right);
+  node->height = (left > right ? left : right) + 1;
+}
+
+// Rotates left if the flag is set, otherwise right; Returns the new root of the subtree
+btnode_t *btnode_rotate(btnode_t *node, int left) {
+  btnode_t *child;
+  if(left) { child = node->right; node->right = child->left; child->left = node; } 
+  else { child = node->left; node->left = child->right; child->right = node; }
+  btnode_update(node);
+  btnode_update(child);
+  return child;
+}
+
+// Restores the AVL property of a node whose subtrees differ in height by at most two, and whose 
+// subtrees are balanced; Returns the new root of the subtree
+btnode_t *btnode_balance(btnode_t *node) {
+  btnode_update(node);
+  int diff = btnode_height(node->left) - btnode_height(node->right);
+  if(diff > 1) {
+    if(btnode_height(node->left->left) < btnode_height(node->left->right)) node->left = btnode_rotate(node->left, 1);
+    return btnode_rotate(node, 0);
+  } else if(diff < -1) {
+    if(btnode_height(node->right->right) < btnode_height(node->right->left)) node->right = btnode_rotate(node->right, 0);
+    return btnode_rotate(node, 1);
+  }
   return node;
 }
-void btnode_free(btnode_t *node) { free(node); }
 
 bintree_t *bt_init(cmp_cb_t cmp) {
   bintree_t *bt = (bintree_t *)malloc(sizeof(bintree_t));
@@ -16,9 +51,10 @@ bintree_t *bt_init(cmp_cb_t cmp) {
   bt->cmp = cmp;
   bt->root = NULL;
   bt->size = 0;
+  mem_stat_add(MEM_BINTREE, 1, sizeof(bintree_t));
   return bt;
 }
-void bt_free(bintree_t *bt) { _bt_free(bt->root); free(bt); }
+void bt_free(bintree_t *bt) { _bt_free(bt->root); mem_stat_add(MEM_BINTREE, -1, -(long)sizeof(bintree_t)); free(bt); }
 void _bt_free(btnode_t *node) {
   if(node == NULL) return;
   _bt_free(node->left);
@@ -39,20 +75,21 @@ void *bt_insert(bintree_t *bt, void *key, void *value) {
 btnode_t *_bt_insert(bintree_t *bt, btnode_t *node, void *key, void *value, btnode_t **found) {
   if(node == NULL) { bt->size++; *found = btnode_alloc(key, value); return *found; } // Creates a new node
   int cmp = bt->cmp(key, node->key);
-  if(cmp == 0) *found = node;
+  if(cmp == 0) { *found = node; return node; }
   else if(cmp < 0) node->left = _bt_insert(bt, node->left, key, value, found);
   else node->right = _bt_insert(bt, node->right, key, value, found);
-  return node;
+  return btnode_balance(node);
 }
 
 // Return BT_NOTFOUND if not found, otherwise return the value
 void *bt_find(bintree_t *bt, void *key) { return _bt_find(bt, bt->root, key); }
 void *_bt_find(bintree_t *bt, btnode_t *node, void *key) {
-  if(node == NULL) return BT_NOTFOUND;
-  int cmp = bt->cmp(key, node->key);
-  if(cmp == 0) return node->value;
-  else if(cmp < 0) return _bt_find(bt, node->left, key);
-  else return _bt_find(bt, node->right, key);
+  while(node != NULL) {
+    int cmp = bt->cmp(key, node->key);
+    if(cmp == 0) return node->value;
+    node = cmp < 0 ? node->left : node->right;
+  }
+  return BT_NOTFOUND;
 }
 
 // Removes the given key, and returns the value if the key exists; otherwise return BT_NOTFOUND
@@ -69,22 +106,25 @@ void *_bt_remove(bintree_t *bt, btnode_t *node, void *key, void **found) {
   if(cmp == 0) { *found = node->value; bt->size--; return _bt_remove_node(bt, node); }
   else if(cmp < 0) node->left = _bt_remove(bt, node->left, key, found);
   else node->right = _bt_remove(bt, node->right, key, found);
-  return node;
+  return btnode_balance(node);
 }
 
-// Internal function only called by bt_remove()
+// Internal function only called by bt_remove(); The node is replaced by its successor
 void *_bt_remove_node(bintree_t *bt, btnode_t *node) {
   btnode_t *left = node->left, *right = node->right;
-  if(left == NULL) { btnode_free(node); return right; } // This also covers the leaf node case
-  else if(right == NULL) { btnode_free(node); return left; }
-  if(right->left == NULL) {
-    btnode_free(node);
-    right->left = left;
-    return right;
-  }
-  do { left = right; right = right->left; } while(right->left);
-  node->key = right->key; node->value = right->value;
-  left->left = right->right;
-  btnode_free(right);
-  return node;
-}
\ No newline at end of file
+  btnode_free(node);
+  if(left == NULL) return right; // This also covers the leaf node case
+  else if(right == NULL) return left;
+  btnode_t *min;
+  right = _bt_remove_min(right, &min);
+  min->left = left;
+  min->right = right;
+  return btnode_balance(min);
+}
+
+// Unlinks the leftmost node of the subtree into min, and returns the rest
+btnode_t *_bt_remove_min(btnode_t *node, btnode_t **min) {
+  if(node->left == NULL) { *min = node; return node->right; }
+  node->left = _bt_remove_min(node->left, min);
+  return btnode_balance(node);
+}
@@ -10,11 +10,13 @@
 typedef struct btnode {
   void *key, *value;
   struct btnode *left, *right;
+  int height;              // Height of the subtree; A leaf has height 1
 } btnode_t;
 
 // The good thing about a binary tree search structure is that the physical size
 // grows proportionally with the logical size, which is desirable for structures
-// that are usually small, but sometimes huge
+// that are usually small, but sometimes huge. The tree is kept balanced as an AVL tree, 
+// since keys are often inserted in sorted order, e.g. fields of generated structs
 typedef struct {
   int size;
   cmp_cb_t cmp;
@@ -23,6 +25,10 @@ typedef struct {
 
 btnode_t *btnode_alloc(void *key, void *value);
 void btnode_free(btnode_t *node);
+int btnode_height(btnode_t *node);
+void btnode_update(btnode_t *node);
+btnode_t *btnode_rotate(btnode_t *node, int left);
+btnode_t *btnode_balance(btnode_t *node);
 bintree_t *bt_init(cmp_cb_t cmp);
 void bt_free(bintree_t *bt);
 void _bt_free(btnode_t *node);
@@ -35,5 +41,6 @@ void *_bt_find(bintree_t *bt, btnode_t *node, void *key);
 void *bt_remove(bintree_t *bt, void *key);
 void *_bt_remove(bintree_t *bt, btnode_t *node, void *key, void **found);
 void *_bt_remove_node(bintree_t *bt, btnode_t *node);
+btnode_t *_bt_remove_min(btnode_t *node, btnode_t **min);
 
 #endif
\ No newline at end of file
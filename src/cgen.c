@@ -1,4 +1,5 @@
 
+#include <pthread.h>
 #include "eval.h"
 #include "cgen.h"
 
@@ -13,9 +14,9 @@ void cgen_typed_print(type_t *type, void *data) {
   } else if(type_is_char(type)) {
     printf("CHAR \'%s\'", eval_hex_char(0xFF & *(char *)data));
   } else if(type_is_int(type)) {
-    printf("HEX 0x%lX (DEC %ld)", 
-      eval_const_get_mask(type->size) & *(uint64_t *)data, 
-      eval_const_get_mask(type->size) & *(uint64_t *)data);
+    uint64_t low = (uint64_t)(eval_const_get_mask(type->size) & *(uint64_t *)data);
+    if(type->size > 8 && *((uint64_t *)data + 1)) printf("HEX 0x%lX%016lX", *((uint64_t *)data + 1), low); // High half
+    else printf("HEX 0x%lX (DEC %ld)", low, low);
   } else if(type_is_ptr(type)) {
     printf("PTR 0x%016lX", *(uint64_t *)data);
   } else if(type_is_comp(type)) {
@@ -70,7 +71,7 @@ void cgen_print_cxt(cgen_cxt_t *cxt) {
     char *name = (char *)list_key(node);
     value_t *value = (value_t *)list_value(node);
     if(value->pending) { // Do not print non-pending values (i.e. they have been resolved)
-      printf("%s\n", type_print_str(0, value->type, name, 0));
+      printf("%s\n", type_print_str(cxt->type_cxt, 0, value->type, name, 0));
       count++;
     }
     node = list_next(node);
@@ -84,7 +85,7 @@ void cgen_print_cxt(cgen_cxt_t *cxt) {
   while(node) {
     char *name = (char *)list_key(node);
     value_t *value = (value_t *)list_value(node);
-    printf("%s\n", type_print_str(0, value->type, name, 0));
+    printf("%s\n", type_print_str(cxt->type_cxt, 0, value->type, name, 0));
     node = list_next(node);
   }
   putchar('\n');
@@ -110,6 +111,12 @@ void cgen_print_cxt(cgen_cxt_t *cxt) {
     putchar('\n');
     node = list_next(node);
   }
+  if(mem_stat_enabled) {
+    putchar('\n');
+    printf("Memory\n");
+    printf("------\n");
+    mem_stat_print(stdout);
+  }
 }
 
 cgen_cxt_t *cgen_init() {
@@ -122,11 +129,17 @@ cgen_cxt_t *cgen_init() {
   cxt->gdata_list = list_init();
   cxt->gdata_offset = 0L;
   cxt->reloc_list = list_init();
+  cxt->init_capacity = CGEN_INIT_FRAME_COUNT;
+  cxt->init_frames = malloc(sizeof(cgen_init_frame_t) * cxt->init_capacity);
+  SYSEXPECT(cxt->init_frames != NULL);
+  cxt->body_stack = stack_init();
   return cxt;
 }
 
 void cgen_free(cgen_cxt_t *cxt) { 
   type_sys_free(cxt->type_cxt);
+  free(cxt->init_frames);
+  stack_free(cxt->body_stack);
   list_free(cxt->import_list);
   list_free(cxt->export_list);
   // Free all nodes in the global data list
@@ -153,15 +166,19 @@ cgen_gdata_t *cgen_gdata_init(cgen_cxt_t *cxt, type_t *type) {
   SYSEXPECT(gdata != NULL);
   memset(gdata, 0x00, sizeof(cgen_gdata_t));
   gdata->type = type;
-  gdata->data = (uint8_t *)malloc(type->size + CGEN_GDATA_PADDING); // Avoid zero byte malloc call
-  gdata->offset = cxt->gdata_offset; // Assign an offset relative to the data segment
-  cxt->gdata_offset += type->size;
+  gdata->size = type->size + CGEN_GDATA_PADDING; // Avoid zero byte malloc call
+  gdata->data = (uint8_t *)malloc(gdata->size);
+  gdata->offset = type_align_up(cxt->gdata_offset, type_alignof(type)); // Offset relative to the data segment
+  cxt->gdata_offset = gdata->offset + type->size;
   SYSEXPECT(gdata->data);
+  memset(gdata->data, 0x00, gdata->size); // Padding between fields is not written by initializers
   list_insert(cxt->gdata_list, NULL, gdata);
+  mem_stat_add(MEM_GDATA, 1, sizeof(cgen_gdata_t) + gdata->size);
   return gdata;
 }
 
 void cgen_gdata_free(cgen_gdata_t *gdata) { 
+  mem_stat_add(MEM_GDATA, -1, -(long)(sizeof(cgen_gdata_t) + gdata->size));
   free(gdata->data);
   free(gdata); 
 }
@@ -184,38 +201,9 @@ cgen_gdata_t *cgen_init_comp(cgen_cxt_t *cxt, type_t *type, token_t *token) {
 // Accept next write position, returns the next write position after filling current level
 int64_t cgen_init_comp_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gdata_t *gdata, int64_t offset) {
   assert(type_is_comp(type) && token->type == T_INIT_LIST);
-  if(ast_child_count(token) != list_size(type->comp->field_list)) 
-    error_row_col_exit(token->offset, 
-      "Initializer list for %s does not match definition\n", type_is_struct(type) ? "struct" : "union");
-  listnode_t *curr_field_node = list_head(type->comp->field_list);
-  token_t *curr_elem = ast_getchild(token, 0);
-  if(type_is_struct(type)) {
-    if(ast_child_count(token) != list_size(type->comp->field_list)) // Check length of the struct init list
-      error_row_col_exit(token->offset, "Initializer list for struct must assign a value for every field\n");
-    while(curr_elem) {
-      assert(curr_field_node);
-      field_t *curr_field = (field_t *)list_value(curr_field_node);
-      type_t *curr_type = curr_field->type;
-      if(type_is_array(curr_type)) {
-        offset = cgen_init_array_(cxt, curr_type, curr_elem, gdata, offset);
-      } else if(type_is_comp(curr_type)) {
-        offset = cgen_init_comp_(cxt, curr_type, curr_elem, gdata, offset);
-      } else if(/* is bit field */0) { // TODO: ADD INIT FOR BIT FIELD
-      } else {
-        offset = cgen_init_value_(cxt, curr_type, curr_elem, gdata, offset);
-      }
-      curr_elem = curr_elem->sibling;
-      curr_field_node = list_next(curr_field_node);
-    }
-  } else {
-    assert(type_is_union(type));
-    if(ast_child_count(token) != 1) // Check length of the struct init list
-      error_row_col_exit(token->offset, "Initializer list for union must only assing one field\n");
-  }
-  return offset;
+  return cgen_init_list_(cxt, type, token, gdata, offset);
 }
 
-
 cgen_gdata_t *cgen_init_array(cgen_cxt_t *cxt, type_t *type, token_t *token) {
   cgen_gdata_t *gdata = cgen_gdata_init(cxt, type);
   cgen_init_array_(cxt, type, token, gdata, 0L);
@@ -225,43 +213,101 @@ cgen_gdata_t *cgen_init_array(cgen_cxt_t *cxt, type_t *type, token_t *token) {
 // Accept next write position, returns the next write position after filling current level
 int64_t cgen_init_array_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gdata_t *gdata, int64_t offset) {
   assert(type_is_array(type) && (token->type == T_INIT_LIST || token->type == T_STR_CONST));
-  // This must be true because if there is init list we always know the array size
-  assert(type->array_size != -1 && type->size != TYPE_UNKNOWN_SIZE);
-  assert(ast_child_count(token) <= type->array_size);
-  if(token->type == T_STR_CONST) {
-    if(type_is_char(type->next)) {
-      str_t *str = eval_const_str_token(token);
-      memcpy(gdata->data + offset, str_cstr(str), str_size(str) + 1);
-      int remains = type->array_size - (str_size(str) + 1); // Fill zero
-      assert(remains >= 0);
-      offset += (str_size(str) + 1);
-      str_free(str);
-      if(remains) memset(gdata->data + offset, 0x00, remains);
-      return offset + remains;
+  return cgen_init_list_(cxt, type, token, gdata, offset);
+}
+
+// Fills nested initializer lists of array and composite types. Each level of nesting is a frame on 
+// an explicit stack rather than a recursive call, such that the depth of nesting is not limited by 
+// the C stack. Accept next write position, returns the next write position after filling all levels
+int64_t cgen_init_list_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gdata_t *gdata, int64_t offset) {
+  int depth = 0;
+  cgen_init_frame_t *frames = (cgen_init_frame_t *)cxt->init_frames;
+  while(1) {
+    // Enter a new level if type is set; Frame pointers must not be used across this block
+    if(type != NULL) {
+      if(depth == cxt->init_capacity) {
+        cxt->init_capacity *= 2;
+        frames = (cgen_init_frame_t *)realloc(frames, sizeof(cgen_init_frame_t) * cxt->init_capacity);
+        SYSEXPECT(frames != NULL);
+        cxt->init_frames = frames; // Owned by the context such that it is freed even after an error
+      }
+      cgen_init_frame_t *frame = &frames[depth];
+      frame->type = type;
+      frame->token = token;
+      frame->curr_elem = ast_getchild(token, 0);
+      frame->curr_field = NULL;
+      frame->count = 0;
+      if(type_is_array(type)) {
+        // This must be true because if there is init list we always know the array size
+        assert(type->array_size != -1 && type->size != TYPE_UNKNOWN_SIZE);
+        assert(ast_child_count(token) <= type->array_size);
+        if(token->type == T_STR_CONST) { // String literal is written directly without a frame
+          if(!type_is_char(type->next))
+            error_row_col_exit(token->offset, "Cannot use string literal to initialize type \"%s\"\n", 
+              type_print_str(cxt->type_cxt, 0, type, NULL, 0));
+          str_t *str = eval_const_str_token(token);
+          memcpy(gdata->data + offset, str_cstr(str), str_size(str) + 1);
+          int remains = type->array_size - (str_size(str) + 1); // Fill zero
+          assert(remains >= 0);
+          offset += (str_size(str) + 1);
+          str_free(str);
+          if(remains) memset(gdata->data + offset, 0x00, remains);
+          offset += remains;
+        } else {
+          depth++;
+        }
+      } else {
+        assert(type_is_comp(type) && token->type == T_INIT_LIST);
+        if(ast_child_count(token) != list_size(type->comp->field_list)) 
+          error_row_col_exit(token->offset, 
+            "Initializer list for %s does not match definition\n", type_is_struct(type) ? "struct" : "union");
+        if(type_is_struct(type)) {
+          if(ast_child_count(token) != list_size(type->comp->field_list)) // Check length of the struct init list
+            error_row_col_exit(token->offset, "Initializer list for struct must assign a value for every field\n");
+          frame->curr_field = list_head(type->comp->field_list);
+        } else {
+          assert(type_is_union(type));
+          if(ast_child_count(token) != 1) // Check length of the struct init list
+            error_row_col_exit(token->offset, "Initializer list for union must only assing one field\n");
+          frame->curr_elem = NULL;
+        }
+        depth++;
+      }
+      type = NULL;
+    }
+    if(depth == 0) break;
+    cgen_init_frame_t *frame = &frames[depth - 1];
+    token_t *curr_elem = frame->curr_elem;
+    if(curr_elem == NULL) { // Current level is done
+      if(type_is_array(frame->type)) {
+        type_t *elem_type = frame->type->next;
+        assert(frame->count <= frame->type->array_size);
+        int remains = frame->type->array_size - frame->count;
+        memset(gdata->data + offset, 0x00, remains * elem_type->size); // Fill the remaining space with zero
+        offset += remains * elem_type->size;
+      }
+      depth--;
+      continue;
+    }
+    type_t *curr_type;
+    if(type_is_array(frame->type)) {
+      curr_type = frame->type->next;
     } else {
-      error_row_col_exit(token->offset, "Cannot use string literal to initialize type \"%s\"\n", 
-        type_print_str(0, type, NULL, 0));
+      assert(frame->curr_field);
+      curr_type = ((field_t *)list_value(frame->curr_field))->type;
+      frame->curr_field = list_next(frame->curr_field);
     }
-  }
-
-  type_t *elem_type = type->next;
-  token_t *curr_elem = ast_getchild(token, 0);
-  int count = 0;
-  while(curr_elem) {
-    if(type_is_array(elem_type)) {
-      offset = cgen_init_array_(cxt, elem_type, curr_elem, gdata, offset);
-    } else if(type_is_comp(elem_type)) {
-      offset = cgen_init_comp_(cxt, elem_type, curr_elem, gdata, offset);
+    frame->curr_elem = curr_elem->sibling;
+    frame->count++;
+    if(type_is_array(curr_type) || type_is_comp(curr_type)) {
+      type = curr_type;
+      token = curr_elem;
+    } else if(/* is bit field */0) { // TODO: ADD INIT FOR BIT FIELD
     } else {
-      offset = cgen_init_value_(cxt, elem_type, curr_elem, gdata, offset);
+      offset = cgen_init_value_(cxt, curr_type, curr_elem, gdata, offset);
     }
-    curr_elem = curr_elem->sibling;
-    count++;
   }
-  assert(count <= type->array_size);
-  int remains = type->array_size - count;
-  memset(gdata->data + offset, 0x00, remains * elem_type->size); // Fill the remaining space with zero
-  return offset + remains * elem_type->size; 
+  return offset;
 }
 
 // Processes initializer value for global variable
@@ -282,7 +328,7 @@ int64_t cgen_init_value_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gda
     assert(token->type == T_STR_CONST);
     if(type_is_ptr(type) && type_is_char(type->next)) { // Could only initialize char * (optionally qualifiers)
       str_t *str = eval_const_str_token(token);
-      cgen_gdata_t *gdata_str = cgen_gdata_init(cxt, type_get_strliteral(cxt->type_cxt, str_size(str) + 1, token->offset));
+      cgen_gdata_t *gdata_str = cgen_gdata_init(cxt, type_get_strliteral(cxt->type_cxt, str_size(str) + 1));
       memcpy(gdata_str->data, str_cstr(str), str_size(str) + 1);
       str_free(str);
       *(int64_t *)(gdata->data + offset) = gdata_str->offset; // Write relative value of the global data into ptr value
@@ -293,8 +339,8 @@ int64_t cgen_init_value_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gda
       reloc->size = type->size; // Pointer size
       assert(type->size == TYPE_PTR_SIZE);
     } else {
-      error_row_col_exit(token->offset, "Cannot use string literal to initialize type \"%s\"\n", 
-        type_print_str(0, type, NULL, 0));
+      error_row_col_cont(token->offset, "Cannot use string literal to initialize type \"%s\"\n", 
+        type_print_str(cxt->type_cxt, 0, type, NULL, 0));
     }
   }
   return offset + type->size;
@@ -324,16 +370,17 @@ void cgen_resolve_extern(cgen_cxt_t *cxt, value_t *value) {
 // Final result is that we modify decl_type and def_type such that they are consistent in size
 // Argument both_decl is set if both of them are declaratins. In this case we do not report error even
 // if the size cannot be decided; We implicitly assume that the first two arguments are all valid
-void cgen_resolve_array_size(type_t *decl_type, type_t *def_type, token_t *init, int both_decl) {
+// Returns CGEN_ERROR if an error has been reported and errors are collected, or CGEN_OK
+int cgen_resolve_array_size(cgen_cxt_t *cxt, type_t *decl_type, type_t *def_type, token_t *init, int both_decl) {
   assert(def_type && type_is_array(def_type));
   assert(!init || init->type == T_INIT_LIST || init->type == T_STR_CONST);
   assert(!both_decl || (decl_type && def_type && !init));
   if(def_type->next->size == TYPE_UNKNOWN_SIZE) // Always check this for both cases
-    error_row_col_exit(def_type->next->offset, "Incomplete array base type\n");
+    return cgen_error_cont(def_type->next->offset, "Incomplete array base type\n");
 
   if(!decl_type) {
     if(def_type->array_size == -1) {
-      if(!init) error_row_col_exit(def_type->offset, "Incomplete array type\n"); // Case 1.4
+      if(!init) return cgen_error_cont(def_type->offset, "Incomplete array type\n"); // Case 1.4
       if(init->type == T_INIT_LIST) {
         def_type->array_size = ast_child_count(init);
         def_type->size = def_type->array_size * def_type->next->size; // Case 1.3
@@ -346,16 +393,16 @@ void cgen_resolve_array_size(type_t *decl_type, type_t *def_type, token_t *init,
       }
     } else { // Case 1.1 if no error
       if(init && ast_child_count(init) > def_type->array_size) // Case 1.2
-        error_row_col_exit(def_type->offset, "Array initializer list is longer than array type\n");
+        return cgen_error_cont(def_type->offset, "Array initializer list is longer than array type\n");
     }
-    return;
+    return CGEN_OK;
   }
 
   assert(type_is_array(decl_type));
   if(type_cmp(decl_type->next, def_type->next) != TYPE_CMP_EQ) // Case 0
-    error_row_col_exit(def_type->offset, "Global array %s has inconsistent base type (%s) with previous declaration (%s)\n",
+    return cgen_error_cont(def_type->offset, "Global array %s has inconsistent base type (%s) with previous declaration (%s)\n",
       both_decl ? "declaration" : "definition",
-      type_print_str(0, decl_type, NULL, 0), type_print_str(1, def_type, NULL, 0));
+      type_print_str(cxt->type_cxt, 0, decl_type, NULL, 0), type_print_str(cxt->type_cxt, 1, def_type, NULL, 0));
   int decl_size = decl_type->array_size;
   int def_size = def_type->array_size;
   int init_size;
@@ -374,7 +421,7 @@ void cgen_resolve_array_size(type_t *decl_type, type_t *def_type, token_t *init,
     final_size = decl_size;
     if(def_size != -1) { // Both are valid sizes
       if(def_size != decl_size) 
-        error_row_col_exit(def_type->offset, "Global array size inconsistent with declaration\n");
+        return cgen_error_cont(def_type->offset, "Global array size inconsistent with declaration\n");
     } else { // Only decl size is valid, set def size, and check init
       def_type->array_size = decl_size;
       def_type->size = decl_size * def_type->next->size;
@@ -390,28 +437,33 @@ void cgen_resolve_array_size(type_t *decl_type, type_t *def_type, token_t *init,
       decl_type->size = def_type->size = init_size * decl_type->next->size;
     } else {
       // Only report error if one of them is a definition
-      if(!both_decl) error_row_col_exit(def_type->offset, "Incomplete global array size\n");
+      if(!both_decl) return cgen_error_cont(def_type->offset, "Incomplete global array size\n");
     }
   }
   if(init_size != -1 && init_size > final_size) 
-    error_row_col_exit(init->offset, "Array initializer list is longer than array type\n");
+    return cgen_error_cont(init->offset, "Array initializer list is longer than array type\n");
   assert(decl_type->array_size == def_type->array_size); // This is even true if both are decl of unknown size
   assert(decl_type->size == def_type->size);
-  return;
+  return CGEN_OK;
 }
 
 // Processes global declaration, including normal declaration and function prototype
+// If errors are collected, an invalid declaration is reported and skipped
 void cgen_global_decl(cgen_cxt_t *cxt, type_t *type, token_t *basetype, token_t *decl, token_t *init) {
   token_t *name = ast_getchild(decl, 2);
   // Declaration: has extern, no def, or is function type
   if(name->type == T_) {// Extern type must have a name to be imported
-    error_row_col_exit(decl->offset, "External declaration must have a name\n");
+    error_row_col_cont(decl->offset, "External declaration must have a name\n");
+    return;
   } else if(type_is_func(type) && DECL_ISEXTERN(basetype->decl_prop)) {
-    error_row_col_exit(decl->offset, "You don't need \"extern\" to declare function prototypes\n");
+    error_row_col_cont(decl->offset, "You don't need \"extern\" to declare function prototypes\n");
+    return;
   } else if(type_is_func(type) && init) {
-    error_row_col_exit(decl->offset, "Function prototype does not allow initialization\n");
+    error_row_col_cont(decl->offset, "Function prototype does not allow initialization\n");
+    return;
   } else if(type_is_array(type) && type->next->size == TYPE_UNKNOWN_SIZE) {
-    error_row_col_exit(decl->offset, "Array declaration using incomplete base type\n");
+    error_row_col_cont(decl->offset, "Array declaration using incomplete base type\n");
+    return;
   }
   
   // Decl after decl or decl after def
@@ -419,9 +471,9 @@ void cgen_global_decl(cgen_cxt_t *cxt, type_t *type, token_t *basetype, token_t
   if(prev_value) {
     type_t *prev_type = prev_value->type;
     if(type_is_array(type) && type_is_array(prev_type)) { // Array types are compared more carefully
-      cgen_resolve_array_size(prev_value->type, type, NULL, CGEN_ARRAY_DECL);
+      cgen_resolve_array_size(cxt, prev_value->type, type, NULL, CGEN_ARRAY_DECL);
     } else if(type_cmp(type, prev_type) != TYPE_CMP_EQ) {
-      error_row_col_exit(decl->offset, "Incompatible global declaration with a previous %s",
+      error_row_col_cont(decl->offset, "Incompatible global declaration with a previous %s",
         prev_value->pending ? "declaration" : "definition");
     }
   } else {
@@ -436,6 +488,7 @@ void cgen_global_decl(cgen_cxt_t *cxt, type_t *type, token_t *basetype, token_t
   return;
 }
 
+// If errors are collected, an invalid definition is reported and skipped
 void cgen_global_def(cgen_cxt_t *cxt, type_t *type, token_t *basetype, token_t *decl, token_t *init) {
   token_t *name = ast_getchild(decl, 2);
   assert(!type_is_func(type) && !type_is_void(type));
@@ -443,22 +496,27 @@ void cgen_global_def(cgen_cxt_t *cxt, type_t *type, token_t *basetype, token_t *
   // Unnamed struct, union and enum declaration - do not reserve space
   if(name->type == T_) {
     if(!type_is_comp(type) && !type_is_enum(type)) 
-      error_row_col_exit(decl->offset, "Global variable must have a name\n");
+      error_row_col_cont(decl->offset, "Global variable must have a name\n");
     return;
   }
   
   // Check whether there is already an declaration or func prototype
   value_t *value = (value_t *)scope_search(cxt->type_cxt, SCOPE_VALUE, name->str);
   if(value) {
-    if(value->pending == 0) // Not a declaration - duplicated definition
-      error_row_col_exit(name->offset, "Duplicated global definition of name \"%s\"\n", name->str);
-    if(type_is_array(value->type) && type_is_array(type)) // Resolve decl and def array type
-      cgen_resolve_array_size(value->type, type, init, CGEN_ARRAY_DEF);
-    if(type_cmp(value->type, type) != TYPE_CMP_EQ)
-      error_row_col_exit(decl->offset, "Global variable definition has inconsistent type with previous declaration\n");
+    if(value->pending == 0) { // Not a declaration - duplicated definition
+      error_row_col_cont(name->offset, "Duplicated global definition of name \"%s\"\n", name->str);
+      return;
+    }
+    if(type_is_array(value->type) && type_is_array(type)) { // Resolve decl and def array type
+      if(cgen_resolve_array_size(cxt, value->type, type, init, CGEN_ARRAY_DEF) == CGEN_ERROR) return;
+    }
+    if(type_cmp(value->type, type) != TYPE_CMP_EQ) {
+      error_row_col_cont(decl->offset, "Global variable definition has inconsistent type with previous declaration\n");
+      return;
+    }
   } else {
     // Set array size from either type or init
-    if(type_is_array(type)) cgen_resolve_array_size(NULL, type, init, CGEN_ARRAY_DEF);
+    if(type_is_array(type) && cgen_resolve_array_size(cxt, NULL, type, init, CGEN_ARRAY_DEF) == CGEN_ERROR) return;
     value = value_init(cxt->type_cxt);
     value->addrtype = ADDR_GLOBAL; 
     value->type = type;
@@ -472,7 +530,6 @@ void cgen_global_def(cgen_cxt_t *cxt, type_t *type, token_t *basetype, token_t *
     if(type_is_array(type)) {
       cgen_init_array(cxt, type, init);
     } else if(type_is_comp(type)) {
-      puts(type_print_str(0, type, NULL, 1));
       cgen_init_comp(cxt, type, init);
     } else { // Single variable - eval and do a cast
       cgen_init_value(cxt, type, init);
@@ -514,13 +571,14 @@ void cgen_global(cgen_cxt_t *cxt, token_t *global_decl) {
     
     if(DECL_ISTYPEDEF(basetype->decl_prop)) { // Typedef of a new type
       if(name->type == T_) {
-        error_row_col_exit(decl->offset, "Typedef'ed type must have a name");
+        error_row_col_cont(decl->offset, "Typedef'ed type must have a name");
+      } else {
+        scope_top_insert(cxt->type_cxt, SCOPE_UDEF, name->str, type);
       }
-      scope_top_insert(cxt->type_cxt, SCOPE_UDEF, name->str, type);
     } else if(DECL_ISREGISTER(basetype->decl_prop)) {
-      error_row_col_exit(decl->offset, "Keyword \"register\" is not allowed for outer-most scope\n");
+      error_row_col_cont(decl->offset, "Keyword \"register\" is not allowed for outer-most scope\n");
     } else if(DECL_ISAUTO(basetype->decl_prop)) {
-      error_row_col_exit(decl->offset, "Keyword \"auto\" is not allowed for outer-most scope\n");
+      error_row_col_cont(decl->offset, "Keyword \"auto\" is not allowed for outer-most scope\n");
     } else if((DECL_ISEXTERN(basetype->decl_prop) && !init) || (type_is_func(type))) { 
       // Declaration or function prototype
       cgen_global_decl(cxt, type, basetype, decl, init);
@@ -531,13 +589,209 @@ void cgen_global(cgen_cxt_t *cxt, token_t *global_decl) {
   }
 }
 
+// Declares the function of a definition in the global scope, and returns the type of the definition
+// Returns NULL if an error has been reported and errors are collected
+type_t *cgen_func_decl(cgen_cxt_t *cxt, token_t *func) {
+  assert(func->type == T_GLOBAL_FUNC);
+  token_t *decl = ast_getchild(func, 0);
+  token_t *basetype = ast_getchild(decl, 0);
+  token_t *name = ast_getchild(decl, 2);
+  type_t *type = type_gettype(cxt->type_cxt, decl, basetype, TYPE_ALLOW_STGCLS | TYPE_ALLOW_QUAL);
+  if(!type_is_func(type) || name->type == T_) {
+    error_row_col_cont(decl->offset, "Function definition must have a function type and a name\n");
+    return NULL;
+  } else if(DECL_STGCLS_GET(basetype->decl_prop) && !DECL_ISSTATIC(basetype->decl_prop)) {
+    error_row_col_cont(decl->offset, "Function definition only allows storage class \"static\"\n");
+    return NULL;
+  }
+  value_t *value = (value_t *)scope_search(cxt->type_cxt, SCOPE_VALUE, name->str);
+  if(value) {
+    if(value->pending == 0) {
+      error_row_col_cont(name->offset, "Duplicated global definition of name \"%s\"\n", name->str);
+      return NULL;
+    } else if(type_cmp(value->type, type) != TYPE_CMP_EQ) {
+      error_row_col_cont(decl->offset, "Function definition has inconsistent type with previous declaration\n");
+      return NULL;
+    }
+    cgen_resolve_extern(cxt, value);
+    value->pending = 0;
+  } else {
+    value = value_init(cxt->type_cxt);
+    value->addrtype = ADDR_GLOBAL;
+    value->type = type;
+    value->pending = 0;
+    scope_top_insert(cxt->type_cxt, SCOPE_VALUE, name->str, value);
+  }
+  if(!DECL_ISSTATIC(basetype->decl_prop)) list_insert(cxt->export_list, name->str, value);
+  return type;
+}
+
+// Declares variables and typedefs of a T_DECL_STMT_LIST in the current scope, and derives the type 
+// of initializers; If errors are collected, an invalid declaration is reported and skipped
+void cgen_local_decl(type_cxt_t *type_cxt, token_t *decl_list) {
+  assert(decl_list->type == T_DECL_STMT_LIST);
+  for(token_t *entry = ast_getchild(decl_list, 0);entry != NULL;entry = entry->sibling) {
+    token_t *basetype = ast_getchild(entry, 0);
+    for(token_t *var = basetype->sibling;var != NULL;var = var->sibling) {
+      assert(var->type == T_DECL_STMT_VAR);
+      token_t *decl = ast_getchild(var, 0);
+      token_t *init = ast_getchild(var, 1); // Optional, T_INIT or T_INIT_LIST
+      token_t *name = ast_getchild(decl, 2);
+      type_t *type = type_gettype(type_cxt, decl, basetype, TYPE_ALLOW_STGCLS | TYPE_ALLOW_QUAL);
+      if(DECL_ISTYPEDEF(basetype->decl_prop)) {
+        if(name->type == T_) error_row_col_cont(decl->offset, "Typedef'ed type must have a name\n");
+        else scope_top_insert(type_cxt, SCOPE_UDEF, name->str, type);
+        continue;
+      } else if(name->type == T_) { // Unnamed struct, union and enum declaration
+        if(!type_is_comp(type) && !type_is_enum(type)) error_row_col_cont(decl->offset, "Local variable must have a name\n");
+        continue;
+      } else if(scope_top_find(type_cxt, SCOPE_VALUE, name->str)) {
+        error_row_col_cont(name->offset, "Duplicated local definition of name \"%s\"\n", name->str);
+        continue;
+      }
+      value_t *value = value_init(type_cxt);
+      value->addrtype = (DECL_ISSTATIC(basetype->decl_prop) || DECL_ISEXTERN(basetype->decl_prop)) ? ADDR_GLOBAL : ADDR_STACK;
+      value->type = type;
+      scope_top_insert(type_cxt, SCOPE_VALUE, name->str, value); // Visible in its own initializer
+      if(init == NULL) continue;
+      if(init->type == T_INIT_LIST) {
+        type_annotate(type_cxt, init);
+      } else {
+        token_t *exp = ast_getchild(init, 0);
+        type_t *init_type = type_typeof(type_cxt, exp, 0);
+        // Arrays and composites are initialized in place, so only scalar initializers are casted
+        if(!type_is_array(type) && !type_is_comp(type)) type_cast(type, init_type, TYPE_CAST_IMPLICIT, exp->offset);
+        eval_fold_exp(type_cxt, exp);
+      }
+    }
+  }
+  return;
+}
+
+// Returns 1 if the statement contains a label, or case and default of a switch, such that it may be entered
+// other than from the beginning
+int cgen_has_label(token_t *token) {
+  stack_t *stack = stack_init();
+  stack_push(stack, token);
+  int found = 0;
+  while(!stack_empty(stack) && !found) {
+    token = (token_t *)stack_pop(stack);
+    found = token->type == T_LBL_STMT || token->type == T_CASE || token->type == T_DEFAULT;
+    for(token_t *child = token->child;child != NULL;child = child->sibling) stack_push(stack, child);
+  }
+  stack_free(stack);
+  return found;
+}
+
+// Removes branches of if and while statements that are never taken, if the condition folded to a constant
+// The statement is replaced in place by the branch that is taken or an empty statement. Returns 1 if replaced
+// This is called after all branches are checked, such that errors in dead code are still reported
+// Note: Branches with labels are kept, and so is "while" with a true condition
+int cgen_fold_branch(type_cxt_t *type_cxt, token_t *stmt) {
+  assert(stmt->type == T_IF || stmt->type == T_WHILE);
+  token_t *cond = ast_getchild(stmt, 0);
+  if(!eval_fold_is_literal(cond)) return 0; // Not constant, or has an error
+  value_t *value = eval_const_get_int_value(type_cxt, cond);
+  int taken = !eval_const_is_zero(value, (int)value->type->size);
+  token_t *then_stmt = cond->sibling;
+  token_t *else_stmt = then_stmt->sibling; // T_ELSE or NULL
+  if(stmt->type == T_WHILE) {
+    if(taken || cgen_has_label(then_stmt)) return 0;
+    ast_replace(stmt, token_get_empty());
+  } else if(taken) {
+    if(else_stmt && cgen_has_label(else_stmt)) return 0;
+    ast_replace(stmt, then_stmt);
+  } else {
+    if(cgen_has_label(then_stmt)) return 0;
+    if(else_stmt == NULL) {
+      ast_replace(stmt, token_get_empty());
+    } else {
+      ast_replace(stmt, else_stmt);
+      ast_replace(stmt, stmt->child); // Statement under "else"
+    }
+  }
+  return 1;
+}
+
+// Derives the type of every expression in a function body, with declarations of each compound 
+// statement visible in it. Statements are visited with an explicit stack of next siblings, on which 
+// NULL marks the end of a compound statement, such that the depth of nesting is not limited by the 
+// C stack. An if or while statement is pushed with CGEN_FOLD_BRANCH under its subtree, such that a 
+// constant branch is folded after the subtree is checked. The stack is owned by the caller, which may 
+// reuse it after an error. Types memoized in the body are cleared at the end, since they may live in 
+// the scopes of the body
+// Note: Lazy bodies are skipped since they can only be expanded by the parser
+void cgen_func_body(type_cxt_t *type_cxt, stack_t *stack, type_t *type, token_t *func) {
+  assert(type_is_func(type));
+  token_t *body = ast_getchild(func, 1);
+  if(body->type == T_LAZY_BODY) return;
+  assert(body->type == T_COMP_STMT);
+  while(!stack_empty(stack)) stack_pop(stack); // Left over by an error
+  scope_recurse(type_cxt); // Arguments are in the same scope as the outermost compound statement
+  for(int i = 0;i < type->arg_count;i++) {
+    if(type->arg_names[i] == NULL) continue; // Unnamed argument
+    value_t *value = value_init(type_cxt);
+    value->addrtype = ADDR_STACK;
+    value->type = type->arg_types[i];
+    scope_top_insert(type_cxt, SCOPE_VALUE, type->arg_names[i], value);
+  }
+  stack_push(stack, NULL); // Leaves the argument scope
+  if(ast_getchild(body, 1)->child) stack_push(stack, ast_getchild(body, 1)->child);
+  cgen_local_decl(type_cxt, ast_getchild(body, 0));
+  while(!stack_empty(stack)) {
+    token_t *token = (token_t *)stack_pop(stack);
+    if(token == NULL) { // End of compound statement
+      scope_decurse(type_cxt);
+      continue;
+    } else if(token == CGEN_FOLD_BRANCH) { // Subtree of the statement has been checked
+      cgen_fold_branch(type_cxt, (token_t *)stack_pop(stack));
+      continue;
+    }
+    if(token->sibling) stack_push(stack, token->sibling); // Visited after the subtree of this node
+    if(token->type == T_IF || token->type == T_WHILE) {
+      stack_push(stack, token);
+      stack_push(stack, CGEN_FOLD_BRANCH);
+    }
+    if((token->type >= EXP_BEGIN && token->type < EXP_END) || 
+       (token->type >= T_LITERALS_BEGIN && token->type < T_LITERALS_END)) {
+      if(!type_is_error(type_typeof(type_cxt, token, 0))) eval_fold_exp(type_cxt, token);
+      continue;
+    }
+    switch(token->type) {
+      case T_COMP_STMT: {
+        scope_recurse(type_cxt);
+        cgen_local_decl(type_cxt, ast_getchild(token, 0));
+        stack_push(stack, NULL);
+        if(ast_getchild(token, 1)->child) stack_push(stack, ast_getchild(token, 1)->child);
+      } break;
+      case T_RETURN: {
+        token_t *exp = ast_getchild(token, 0);
+        if(exp == NULL) break;
+        type_t *exp_type = type_typeof(type_cxt, exp, 0);
+        if(type_is_void(type->next)) error_row_col_cont(exp->offset, "Function returning void cannot return a value\n");
+        else type_cast(type->next, exp_type, TYPE_CAST_IMPLICIT, exp->offset);
+        eval_fold_exp(type_cxt, exp);
+      } break;
+      case T_GOTO: break; // Label names are not expressions
+      case T_LBL_STMT: stack_push(stack, ast_getchild(token, 1)); break;
+      default: if(token->child) stack_push(stack, token->child); break;
+    }
+  }
+  ast_clear_types(body);
+  return;
+}
+
+// Declares the function and checks its body
 void cgen_global_func(cgen_cxt_t *cxt, token_t *func) {
-  (void)cxt; (void)func;
+  type_t *type = cgen_func_decl(cxt, func);
+  if(type) cgen_func_body(cxt->type_cxt, cxt->body_stack, type, func);
+  return;
 }
 
 // Main entry point to code generation
 void cgen(cgen_cxt_t *cxt, token_t *root) {
   assert(root->type == T_ROOT);
+  ast_clear_types(root); // The tree may have been checked by another context
   token_t *t = ast_getchild(root, 0);
   while(t) {
     if(t->type == T_GLOBAL_DECL_ENTRY) {
@@ -550,4 +804,133 @@ void cgen(cgen_cxt_t *cxt, token_t *root) {
     t = t->sibling; // Gets NULL if reaches the end
   }
   return;
-}
\ No newline at end of file
+}
+
+// Thread function of cgen_parallel(); Claims and checks bodies until none is left. A body is 
+// abandoned at its first error under fail-fast reporting, or at the limit if errors are collected
+void *cgen_worker(void *arg) {
+  cgen_worker_t *worker = (cgen_worker_t *)arg;
+  int index;
+  while((index = __atomic_fetch_add(worker->next, 1, __ATOMIC_RELAXED)) < worker->count) {
+    error_bind(&worker->errors[index]);
+    worker->type_cxt->frozen_limit = worker->limits[index];
+    if(setjmp(worker->errors[index].env) == ERROR_FIRSTTIME) {
+      cgen_func_body(worker->type_cxt, worker->stack, worker->types[index], worker->funcs[index]);
+    } else {
+      while(scope_numlevel(worker->type_cxt) > 1) scope_decurse(worker->type_cxt);
+      ast_clear_types(ast_getchild(worker->funcs[index], 1)); // Types are released with the scopes
+      worker->type_cxt->eval_depth = 0; // The error may have left an evaluation
+      worker->type_cxt->walk.depth = 0;
+    }
+  }
+  error_bind(NULL);
+  return NULL;
+}
+
+// Buffers the diagnostics of one item of cgen_parallel(), which are merged by the caller in source order
+void cgen_error_buffer(error_cxt_t *errors, error_cxt_t *parent) {
+  memset(errors, 0x00, sizeof(error_cxt_t));
+  errors->begin = parent->begin;
+  errors->inited = parent->inited;
+  errors->recover = 1;
+  errors->quiet = 1;
+  errors->max_errors = parent->max_errors ? parent->max_errors : 1; // Always buffered
+  return;
+}
+
+// Runs the global pass of cgen_parallel() on one item, reporting to the bound error context. Sets the
+// type of a function definition that is declared without error. Returns 0 if the item is abandoned at an
+// error, after which cgen() would not continue
+int cgen_parallel_item(cgen_cxt_t *cxt, token_t *item, type_t **type) {
+  *type = NULL;
+  if(setjmp(error_get_cxt()->env) != ERROR_FIRSTTIME) {
+    while(scope_numlevel(cxt->type_cxt) > 1) scope_decurse(cxt->type_cxt);
+    cxt->type_cxt->eval_depth = 0;
+    cxt->type_cxt->walk.depth = 0;
+    return 0;
+  }
+  if(item->type == T_GLOBAL_DECL_ENTRY) {
+    cgen_global(cxt, item);
+  } else if(item->type == T_GLOBAL_FUNC) {
+    *type = cgen_func_decl(cxt, item);
+  } else {
+    assert(0);   // Should not appear at global level
+  }
+  return 1;
+}
+
+// Processes the translation unit with function bodies checked concurrently on num_threads threads
+// The global pass declares all functions, after which the global scope is frozen and shared read-only
+// by worker contexts. A body only sees globals declared before it, as in cgen(). Diagnostics of the 
+// global pass and of bodies are buffered per item, and reported in source order after all workers finish
+void cgen_parallel(cgen_cxt_t *cxt, token_t *root, int num_threads) {
+  assert(root->type == T_ROOT);
+  assert(num_threads > 0 && num_threads <= CGEN_MAX_THREADS);
+  if(num_threads == 1) {
+    cgen(cxt, root);
+    return;
+  }
+  ast_clear_types(root);
+  int item_count = ast_child_count(root);
+  token_t **funcs = (token_t **)malloc(sizeof(token_t *) * item_count);
+  type_t **types = (type_t **)malloc(sizeof(type_t *) * item_count);
+  int *limits = (int *)malloc(sizeof(int) * item_count);
+  error_cxt_t *errors = (error_cxt_t *)malloc(sizeof(error_cxt_t) * item_count);       // Bodies
+  error_cxt_t *item_errors = (error_cxt_t *)malloc(sizeof(error_cxt_t) * item_count);  // Global pass
+  SYSEXPECT(funcs != NULL && types != NULL && limits != NULL && errors != NULL && item_errors != NULL);
+  error_cxt_t *error_cxt = error_get_cxt();
+  int count = 0, done = 0; // Functions to check, and items processed by the global pass
+  int finished = 1;        // Whether the global pass reaches the end
+  for(token_t *t = ast_getchild(root, 0);t != NULL && finished;t = t->sibling) {
+    cgen_error_buffer(&item_errors[done], error_cxt);
+    error_cxt_t *prev = error_bind(&item_errors[done++]);
+    type_t *type;
+    finished = cgen_parallel_item(cxt, t, &type);
+    error_bind(prev);
+    if(type == NULL) continue;
+    funcs[count] = t;
+    types[count] = type;
+    limits[count] = cxt->type_cxt->binding_count; // Includes the function itself
+    cgen_error_buffer(&errors[count++], error_cxt);
+  }
+  if(num_threads > count) num_threads = count;
+  cgen_worker_t workers[CGEN_MAX_THREADS];
+  pthread_t threads[CGEN_MAX_THREADS];
+  int next = 0;
+  for(int i = 0;i < num_threads;i++) {
+    workers[i].type_cxt = type_sys_init(); // Not thread-safe; Must be done before starting workers
+    workers[i].type_cxt->frozen_global = cxt->type_cxt;
+    workers[i].stack = stack_init();
+    workers[i].funcs = funcs;
+    workers[i].types = types;
+    workers[i].limits = limits;
+    workers[i].errors = errors;
+    workers[i].count = count;
+    workers[i].next = &next;
+  }
+  for(int i = 0;i < num_threads;i++) {
+    SYSEXPECT(pthread_create(&threads[i], NULL, cgen_worker, &workers[i]) == 0);
+  }
+  for(int i = 0;i < num_threads;i++) {
+    SYSEXPECT(pthread_join(threads[i], NULL) == 0);
+    type_sys_free(workers[i].type_cxt);
+    stack_free(workers[i].stack);
+  }
+  int stop = 0, index = 0, item = 0;
+  for(token_t *t = ast_getchild(root, 0);item < done;t = t->sibling, item++) {
+    if(stop) error_diag_free(&item_errors[item]);
+    else stop = error_diag_merge(&item_errors[item]);
+    if(index < count && funcs[index] == t) { // Diagnostics of the body follow those of the declaration
+      if(stop) error_diag_free(&errors[index]);
+      else stop = error_diag_merge(&errors[index]);
+      index++;
+    }
+  }
+  free(funcs);
+  free(types);
+  free(limits);
+  free(errors);
+  free(item_errors);
+  if(stop || !finished) error_exit_or_jump(ERROR_ACTION_EXIT);
+  return;
+}
@@ -13,6 +13,17 @@
 #define CGEN_RELOC_CODE     0
 #define CGEN_RELOC_DATA     1
 
+#define CGEN_INIT_FRAME_COUNT 16 // Initial number of frames for nested initializer lists
+#define CGEN_MAX_THREADS 64      // Upper bound of worker threads in cgen_parallel()
+#define CGEN_FOLD_BRANCH ((token_t *)-1) // Walk stack entry of cgen_func_body(); The next entry is folded
+
+// Return values of functions that may recover from an error
+#define CGEN_OK             0
+#define CGEN_ERROR          1
+
+// Reports a recoverable error and evaluates to CGEN_ERROR
+#define cgen_error_cont(s, fmt, ...) (error_row_col_cont(s, fmt, ##__VA_ARGS__), CGEN_ERROR)
+
 typedef struct {
   type_cxt_t *type_cxt;  // Owns memory; will automatically init and free
   list_t *import_list;       // Externally declared variable, function or array - only valid import is pending is 1
@@ -20,6 +31,9 @@ typedef struct {
   list_t *gdata_list;   // A list of global data, i.e. actual storage
   int64_t gdata_offset; // Next global data offset
   list_t *reloc_list;   // A list of cgen_reloc_t *; Owns memory
+  void *init_frames;    // Frame stack of cgen_init_list_(), reused across calls; Owns memory
+  int init_capacity;    // Number of frames allocated
+  stack_t *body_stack;  // Walk stack of cgen_func_body(), reused across calls; Owns memory
 } cgen_cxt_t;
 
 // A relocation entry provides info for converting relative reference (starting at address 0)
@@ -36,8 +50,31 @@ typedef struct cgen_data_struct_t {
   uint8_t *data;   // Actual data; NULL means uninitialized
   type_t *type;    // Type of the global data, which also contains the size
   int64_t offset;  // Offset relative to the beginning of data segment
+  int64_t size;    // Bytes allocated for data, which includes padding
 } cgen_gdata_t;
 
+// One level of nested initializer list being processed by cgen_init_list_()
+typedef struct {
+  type_t *type;            // Array or composite type of this level
+  token_t *token;          // The T_INIT_LIST node
+  token_t *curr_elem;      // Next element to initialize; NULL if this level is done
+  listnode_t *curr_field;  // Field of curr_elem for composite types
+  int count;               // Number of elements initialized so far
+} cgen_init_frame_t;
+
+// Per-thread state of cgen_parallel(). Workers claim function bodies by atomically incrementing
+// the shared index, and report errors of each function to the error context of the same index
+typedef struct {
+  type_cxt_t *type_cxt;      // Private scope stack over the frozen global scope
+  stack_t *stack;            // Walk stack of cgen_func_body()
+  token_t **funcs;           // T_GLOBAL_FUNC nodes in source order
+  type_t **types;            // Function types declared by the global pass
+  int *limits;               // Number of global bindings made before each body, see frozen_limit
+  error_cxt_t *errors;       // Diagnostics of each function; Merged by the caller in source order
+  int count;
+  int *next;                 // Shared index of the next unclaimed function
+} cgen_worker_t;
+
 void cgen_typed_print(type_t *type, void *data);
 void cgen_print_cxt(cgen_cxt_t *cxt);
 
@@ -54,14 +91,24 @@ cgen_gdata_t *cgen_init_comp(cgen_cxt_t *cxt, type_t *type, token_t *token);
 int64_t cgen_init_comp_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gdata_t *gdata, int64_t offset);
 cgen_gdata_t *cgen_init_array(cgen_cxt_t *cxt, type_t *type, token_t *token);
 int64_t cgen_init_array_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gdata_t *gdata, int64_t offset);
+int64_t cgen_init_list_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gdata_t *gdata, int64_t offset);
 cgen_gdata_t *cgen_init_value(cgen_cxt_t *cxt, type_t *type, token_t *token);
 int64_t cgen_init_value_(cgen_cxt_t *cxt, type_t *type, token_t *token, cgen_gdata_t *gdata, int64_t offset);
 
-void cgen_resolve_array_size(type_t *decl_type, type_t *def_type, token_t *init, int both_decl);
+int cgen_resolve_array_size(cgen_cxt_t *cxt, type_t *decl_type, type_t *def_type, token_t *init, int both_decl);
 void cgen_global_decl(cgen_cxt_t *cxt, type_t *type, token_t *basetype, token_t *decl, token_t *init);
 void cgen_global_def(cgen_cxt_t *cxt, type_t *type, token_t *basetype, token_t *decl, token_t *init);
+type_t *cgen_func_decl(cgen_cxt_t *cxt, token_t *func);
+void cgen_local_decl(type_cxt_t *type_cxt, token_t *decl_list);
+int cgen_has_label(token_t *token);
+int cgen_fold_branch(type_cxt_t *type_cxt, token_t *stmt);
+void cgen_func_body(type_cxt_t *type_cxt, stack_t *stack, type_t *type, token_t *func);
 void cgen_global_func(cgen_cxt_t *cxt, token_t *func);
 void cgen_global(cgen_cxt_t *cxt, token_t *global_decl);
 void cgen(cgen_cxt_t *cxt, token_t *root);
+void *cgen_worker(void *arg);
+void cgen_error_buffer(error_cxt_t *errors, error_cxt_t *parent);
+int cgen_parallel_item(cgen_cxt_t *cxt, token_t *item, type_t **type);
+void cgen_parallel(cgen_cxt_t *cxt, token_t *root, int num_threads);
 
 #endif
\ No newline at end of file
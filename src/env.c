@@ -19,18 +19,18 @@ void env_init_include_path(env_t *env) {
       while(*q != ':' && *q != '\0') {
         q++;
       }
-      if(*q == '\0') {
-        break;
-      }
       int size = q - p;
       if(size != 0) {
-        char *path = (char *)malloc(sizeof(q - p) + 1);
+        char *path = (char *)malloc(size + 1);
         SYSEXPECT(path != NULL);
         memcpy(path, p, size);
         path[size] = '\0';
         list_insertat(env->include_paths, path, path, count);
         count++;
       }
+      if(*q == '\0') {
+        break;
+      }
       p = q + 1;
     }
   }
@@ -1,37 +1,48 @@
 
+#include <stdarg.h>
+#include <string.h>
 #include "error.h"
 
-// This global pointer holds the begin of the text. We use this pointer and 
-// a given pointer to compute the line and column number
-static const char *begin = NULL;
-static int inited = 0;
-// Whether test mode is on. Under test mode, error reporting functions calls 
-// longjmp to jump to a previously set location
-static int testmode = 0;
+// Default context of each thread, and the context bound by error_bind(); NULL means the default
+__thread error_cxt_t error_default_cxt;
+__thread error_cxt_t *error_curr_cxt = NULL;
 
-jmp_buf env;
+error_cxt_t *error_get_cxt() { return error_curr_cxt ? error_curr_cxt : &error_default_cxt; }
+
+// Binds a context to the calling thread and returns the previous one; NULL restores the default
+error_cxt_t *error_bind(error_cxt_t *cxt) {
+  error_cxt_t *prev = error_curr_cxt;
+  error_curr_cxt = cxt;
+  return prev;
+}
 
 // This must be called in order for line number to work
 void error_init(const char *s) { 
-  begin = s; 
-  inited = 1; 
+  error_cxt_t *cxt = error_get_cxt();
+  cxt->begin = s; 
+  cxt->inited = 1; 
   return;
 }
 
+// Also releases buffered diagnostics
 void error_free() { 
-  inited = 0; 
+  error_get_cxt()->inited = 0; 
+  error_diag_clear();
   return;
 }
 
 void error_testmode(int mode) { 
-  testmode = mode; 
+  error_get_cxt()->testmode = mode; 
   return;
 }
 
 void error_exit_or_jump(int need_exit) { 
-  if(testmode != 0) { 
+  error_cxt_t *cxt = error_get_cxt();
+  if(cxt->testmode != 0) { 
     fprintf(stderr, "*** %s are redirected ***\n", need_exit ? "Errors" : "Warnings"); 
-    longjmp(env, 1); 
+    longjmp(cxt->env, 1); 
+  } else if(cxt->recover != 0 && need_exit) { // Used by servers to abandon the current request
+    longjmp(cxt->env, 1); 
   } else if(need_exit) { 
     #ifndef NDEBUG
     assert(0); 
@@ -48,7 +59,9 @@ void error_exit_or_jump(int need_exit) {
 //   2. If the pointer is not in the string registered during initialization
 //      then row and col will be set to -2
 void error_get_row_col(const char *s, int *row, int *col) {
-  if(inited == 0) { 
+  error_cxt_t *cxt = error_get_cxt();
+  const char *begin = cxt->begin;
+  if(cxt->inited == 0) { 
     *row = *col = -1; 
   } else {
     *row = *col = 1;
@@ -65,8 +78,8 @@ void error_get_row_col(const char *s, int *row, int *col) {
     }
     if(*p == '\0' && p != s) { // if p == s then still valid
       *row = *col = -2;
-      fprintf(stderr, "Did you forget to register a new pointer with error module?\n");
-    } else { 
+      if(!cxt->quiet) fprintf(stderr, "Did you forget to register a new pointer with error module?\n");
+    } else if(!cxt->quiet) { 
       // Print from line head to next line
       printf("----\n");
       while(*line_head != '\n' && *line_head != '\0') {
@@ -83,11 +96,131 @@ void error_get_row_col(const char *s, int *row, int *col) {
   return;
 }
 
+// Appends an uninitialized diagnostic to the buffer of the context
+error_diag_t *error_diag_append(error_cxt_t *cxt) {
+  if(cxt->diag_count == cxt->diag_capacity) {
+    cxt->diag_capacity = cxt->diag_capacity ? cxt->diag_capacity * 2 : ERROR_DIAG_COUNT;
+    cxt->diags = (error_diag_t *)realloc(cxt->diags, sizeof(error_diag_t) * cxt->diag_capacity);
+    SYSEXPECT(cxt->diags != NULL);
+  }
+  return &cxt->diags[cxt->diag_count++];
+}
+
+// Prints a diagnostic with its location, and buffers it if the context collects errors
+void error_vreport(int kind, const char *s, const char *fmt, va_list args) {
+  error_cxt_t *cxt = error_get_cxt();
+  int row, col;
+  error_get_row_col(s, &row, &col);
+  va_list copy;
+  if(!cxt->quiet) {
+    fprintf(stderr, "%s (row %d col %d): ", kind == ERROR_KIND_ERROR ? "Error" : "Warning", row, col);
+    va_copy(copy, args);
+    vfprintf(stderr, fmt, copy);
+    va_end(copy);
+  }
+  if(kind == ERROR_KIND_ERROR) cxt->error_count++;
+  if(cxt->max_errors != 0) {
+    error_diag_t *diag = error_diag_append(cxt);
+    diag->kind = kind;
+    diag->row = row;
+    diag->col = col;
+    va_copy(copy, args);
+    int size = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    diag->msg = (char *)malloc(size + 1);
+    SYSEXPECT(diag->msg != NULL);
+    vsnprintf(diag->msg, size + 1, fmt, args);
+  }
+  return;
+}
+
+void error_report(int kind, const char *s, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  error_vreport(kind, s, fmt, args);
+  va_end(args);
+  return;
+}
+
+// Reports a recoverable error. Returns to the caller only if the context collects errors and the 
+// limit has not been reached; Otherwise the error is handled in the same way as error_row_col_exit()
+void error_report_cont(const char *s, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  error_vreport(ERROR_KIND_ERROR, s, fmt, args);
+  va_end(args);
+  error_cxt_t *cxt = error_get_cxt();
+  if(cxt->max_errors == 0) {
+    error_exit_or_jump(ERROR_ACTION_EXIT);
+  } else if(cxt->error_count >= cxt->max_errors) {
+    if(!cxt->quiet) fprintf(stderr, "Too many errors (%d), stopping\n", cxt->error_count);
+    error_exit_or_jump(ERROR_ACTION_EXIT);
+  }
+  return;
+}
+
+// Buffers up to max_errors errors before stopping; 0 restores fail-fast reporting
+void error_collect(int max_errors) {
+  error_get_cxt()->max_errors = max_errors;
+  return;
+}
+
+int error_diag_count() { return error_get_cxt()->diag_count; }
+
+error_diag_t *error_diag_at(int index) {
+  error_cxt_t *cxt = error_get_cxt();
+  assert(index >= 0 && index < cxt->diag_count);
+  return &cxt->diags[index];
+}
+
+// Frees buffered diagnostics and resets the error count
+void error_diag_clear() {
+  error_diag_free(error_get_cxt());
+  return;
+}
+
+// Same as error_diag_clear() on a context that need not be bound to the calling thread
+void error_diag_free(error_cxt_t *cxt) {
+  for(int i = 0;i < cxt->diag_count;i++) free(cxt->diags[i].msg);
+  free(cxt->diags);
+  cxt->diags = NULL;
+  cxt->diag_count = cxt->diag_capacity = 0;
+  cxt->error_count = 0;
+  return;
+}
+
+// Reports diagnostics buffered by another context, e.g. of a worker thread, as if they were reported
+// by the calling thread, and frees them in the other context. Returns 1 if the calling thread should
+// stop, i.e. any error is merged under fail-fast reporting, or the error limit is reached, in which 
+// case the remaining diagnostics are dropped; The caller then stops with error_exit_or_jump()
+int error_diag_merge(error_cxt_t *from) {
+  error_cxt_t *cxt = error_get_cxt();
+  int stop = 0;
+  for(int i = 0;i < from->diag_count;i++) {
+    error_diag_t *diag = &from->diags[i];
+    if(stop) {
+      free(diag->msg);
+      continue;
+    }
+    if(!cxt->quiet) 
+      fprintf(stderr, "%s (row %d col %d): %s", diag->kind == ERROR_KIND_ERROR ? "Error" : "Warning", 
+        diag->row, diag->col, diag->msg);
+    if(diag->kind == ERROR_KIND_ERROR) cxt->error_count++;
+    if(cxt->max_errors != 0) *error_diag_append(cxt) = *diag; // Takes the message
+    else free(diag->msg);
+    if(diag->kind == ERROR_KIND_ERROR) stop = cxt->max_errors == 0 || cxt->error_count >= cxt->max_errors;
+  }
+  from->diag_count = 0; // Messages are either taken or freed
+  error_diag_free(from);
+  if(stop && cxt->max_errors != 0 && !cxt->quiet) fprintf(stderr, "Too many errors (%d), stopping\n", cxt->error_count);
+  return stop;
+}
+
 void syserror(const char *prompt) { 
   fputs(prompt, stderr);
   exit(ERROR_CODE_EXIT); 
 }
 
 int error_get_offset(const char *offset) { 
-  return offset - begin + 1; // Begin with column 1 
+  return offset - error_get_cxt()->begin + 1; // Begin with column 1 
 } 
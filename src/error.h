@@ -5,10 +5,35 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <setjmp.h>
 #include <assert.h>
 
-extern jmp_buf env;
+// A buffered diagnostic; Recorded when the context collects errors, see error_collect()
+typedef struct {
+  int kind;           // ERROR_KIND_ series
+  int row, col;       // Same as error_get_row_col()
+  char *msg;          // Formatted message; Owns memory
+} error_diag_t;
+
+// Error reporting state. Each thread reports to the context bound to it, or to a default context of
+// the thread if none is bound, such that several translation units can be processed concurrently
+typedef struct {
+  const char *begin;  // Beginning of the text; Used with a given pointer to compute row and column
+  int inited;
+  int testmode;       // Under test mode, error reporting functions longjmp to env
+  int recover;        // Errors longjmp to env without the test banner; Warnings continue
+  int quiet;          // Diagnostics are only buffered, not printed; Used by worker threads, see error_diag_merge()
+  int max_errors;     // If non-zero, recoverable errors are buffered until this many are reported
+  int error_count;    // Number of errors reported since the last error_diag_clear()
+  error_diag_t *diags;
+  int diag_count, diag_capacity;
+  jmp_buf env;
+} error_cxt_t;
+
+#define ERROR_KIND_ERROR 0
+#define ERROR_KIND_WARN  1
+#define ERROR_DIAG_COUNT 16 // Initial capacity of the diagnostic buffer
 
 #define ERROR_CODE_EXIT 1
 // Input to function error_exit_or_jump()
@@ -16,27 +41,40 @@ extern jmp_buf env;
 #define ERROR_ACTION_EXIT 1
 #define error_exit(fmt, ...) do { fprintf(stderr, "Error: " fmt, ##__VA_ARGS__); error_exit_or_jump(ERROR_ACTION_EXIT); } while(0);
 #define error_row_col_exit(s, fmt, ...) do { \
-                                          int row, col; error_get_row_col(s, &row, &col); \
-                                          fprintf(stderr, "Error (row %d col %d): " fmt, row, col, ##__VA_ARGS__); \
+                                          error_report(ERROR_KIND_ERROR, s, fmt, ##__VA_ARGS__); \
                                           error_exit_or_jump(ERROR_ACTION_EXIT); } while(0);
 #define warn_row_col_exit(s, fmt, ...) do { \
-                                          int row, col; error_get_row_col(s, &row, &col); \
-                                          fprintf(stderr, "Warning (row %d col %d): " fmt, row, col, ##__VA_ARGS__); \
+                                          error_report(ERROR_KIND_WARN, s, fmt, ##__VA_ARGS__); \
                                           error_exit_or_jump(ERROR_ACTION_CONT); } while(0);
+// Reports an error the caller can recover from with a placeholder; Same as error_row_col_exit() unless 
+// the context collects errors. This is an expression such that it can be used with the comma operator
+#define error_row_col_cont(s, fmt, ...) error_report_cont(s, fmt, ##__VA_ARGS__)
 
 // The following two macros are used for testing. It redirects the control flow back to the testing function
 // if an error occurs. The testing function should set testmode to 1.
 // Usage: if(error_trycatch()) { ...code goes here } else { ... error happens } ... error did not happen
-#define error_trycatch() (setjmp(env) == ERROR_FIRSTTIME)
+#define error_trycatch() (setjmp(error_get_cxt()->env) == ERROR_FIRSTTIME)
 #define ERROR_FIRSTTIME 0
 
 #define SYSEXPECT(expr) do { if(!(expr)) syserror(__func__); } while(0) // Assertion for system calls; Valid under all modes
 
+error_cxt_t *error_get_cxt();
+error_cxt_t *error_bind(error_cxt_t *cxt);
 void error_init(const char *s);
 void error_free();
 void error_testmode(int mode);
 void error_exit_or_jump(int need_exit);
 void error_get_row_col(const char *s, int *row, int *col);
+void error_vreport(int kind, const char *s, const char *fmt, va_list args);
+void error_report(int kind, const char *s, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void error_report_cont(const char *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void error_collect(int max_errors);
+error_diag_t *error_diag_append(error_cxt_t *cxt);
+int error_diag_count();
+error_diag_t *error_diag_at(int index);
+void error_diag_clear();
+void error_diag_free(error_cxt_t *cxt);
+int error_diag_merge(error_cxt_t *from);
 void syserror(const char *prompt);
 
 int error_get_offset(const char *offset); // Returns integer offset
@@ -3,169 +3,130 @@
 #include "eval.h"
 #include "type.h"
 
-// Indicex are number of bytes in the number; 0UL is undefined
-uint64_t eval_int_masks[9] = {
-  0UL, 0xFFUL, 0xFFFFUL, 0UL, 0xFFFFFFFFUL, 0UL, 0UL, 0UL, 0xFFFFFFFFFFFFFFFF, // 0 - 8
-};
+// The following functions perform constant evaluation on the low "size" bytes of values, up to 16 bytes
+// Arithmetic is carried out natively on 128-bit integers, with overflow reported by compiler builtins;
+// Results are returned zero-extended to 128 bits, and value type is not altered
 
-// The following functions perform constant evaluation
-// value type is not altered
-
-uint64_t eval_const_get_mask(int size) {
+__uint128_t eval_const_get_mask(int size) {
   assert(size <= TYPE_INT_SIZE_MAX && size > 0);
   assert(size <= EVAL_MAX_CONST_SIZE);
-  uint64_t op_mask = eval_int_masks[size];
-  assert(op_mask);
-  return op_mask;
+  if(size == EVAL_MAX_CONST_SIZE) return ~(__uint128_t)0;
+  return ((__uint128_t)1 << (8 * size)) - 1;
+}
+
+__uint128_t eval_const_get_sign_mask(int size) {
+  return (__uint128_t)1 << (8 * size - 1);
+}
+
+// Returns the low size bytes as a 128-bit integer, sign extended if is_signed is set
+__int128_t eval_const_load(value_t *value, int size, int is_signed) {
+  __uint128_t ret = value->uint128 & eval_const_get_mask(size);
+  if(is_signed && (ret & eval_const_get_sign_mask(size))) ret |= ~eval_const_get_mask(size);
+  return (__int128_t)ret;
 }
 
-uint64_t eval_const_get_sign_mask(int size) {
-  uint64_t sign_mask = eval_int_masks[size];
-  sign_mask -= (sign_mask >> 1);
-  return sign_mask;
+// Returns 1 if the result of a native signed operation can be represented with size bytes
+int eval_const_in_range(__int128_t result, int size) {
+  if(size == EVAL_MAX_CONST_SIZE) return 1; // Overflow is detected by the builtin
+  __int128_t max = (__int128_t)(eval_const_get_sign_mask(size) - 1);
+  return result <= max && result >= -max - 1;
 }
 
 // Returns 1 if the underlying literal is zero
 int eval_const_is_zero(value_t *value, int size) {
-  uint64_t mask = eval_const_get_mask(size);
-  return (value->uint64 & mask) == 0;
+  return (value->uint128 & eval_const_get_mask(size)) == 0;
 }
 
 // If signed == 1 and to > from, it is sign extension; We do not use or change value->type
 // Returns the value itself
-uint64_t eval_const_adjust_size(value_t *value, int to, int from, int is_signed) {
-  uint64_t to_mask = eval_const_get_mask(to), from_mask = eval_const_get_mask(from);
-  uint64_t ret = value->uint64;
-  if(from == to) {
-    return ret;
-  } else if(to < from) { // Truncation
-    ret &= to_mask;
-  } else { // Extension
-    uint64_t from_sign_mask = eval_const_get_sign_mask(from);
-    if((ret & from_sign_mask) && is_signed) { // Sign extension
-      ret |= (to_mask - from_mask);
-    } else { // Zero extension
-      ret &= from_mask; // Clear higher bits
+__uint128_t eval_const_adjust_size(value_t *value, int to, int from, int is_signed) {
+  return (__uint128_t)eval_const_load(value, from, is_signed) & eval_const_get_mask(to);
+}
+
+// Computes op1 + - * op2 natively; Returns result raw binary representation, and sets overflow flag if the 
+// result cannot be represented. Unsigned operands are computed as unsigned 128-bit integers, since 16-byte 
+// operands may not fit into signed ones
+__uint128_t eval_const_arith(token_type_t op, value_t *op1, value_t *op2, int size, int is_signed, int *overflow) {
+  __uint128_t mask = eval_const_get_mask(size);
+  if(!is_signed) {
+    __uint128_t op1_value = op1->uint128 & mask, op2_value = op2->uint128 & mask, result = 0;
+    switch(op) {
+      case EXP_ADD: *overflow = __builtin_add_overflow(op1_value, op2_value, &result); break;
+      case EXP_SUB: *overflow = __builtin_sub_overflow(op1_value, op2_value, &result); break;
+      case EXP_MUL: *overflow = __builtin_mul_overflow(op1_value, op2_value, &result); break;
+      default: assert(0); break;
     }
+    *overflow = *overflow || (result & ~mask) != 0;
+    return result & mask;
   }
-  return ret;
+  __int128_t op1_value = eval_const_load(op1, size, 1), op2_value = eval_const_load(op2, size, 1), result = 0;
+  switch(op) {
+    case EXP_ADD: *overflow = __builtin_add_overflow(op1_value, op2_value, &result); break;
+    case EXP_SUB: *overflow = __builtin_sub_overflow(op1_value, op2_value, &result); break;
+    case EXP_MUL: *overflow = __builtin_mul_overflow(op1_value, op2_value, &result); break;
+    default: assert(0); break;
+  }
+  *overflow = *overflow || !eval_const_in_range(result, size);
+  return (__uint128_t)result & mask;
 }
 
-// Return NULL if operation overflows; Return result raw binary representation
-uint64_t eval_const_add(value_t *op1, value_t *op2, int size, int is_signed, int *overflow) {
-  *overflow = 0;
-  uint64_t mask = eval_const_get_mask(size);
-  uint64_t result = ((op1->uint64 & mask) + (op2->uint64 & mask)) & mask;
-  // If result is less than one of them, we have seen a carry
-  int carry = ((result & mask) < (op1->uint64 & mask)) || ((result & mask) < (op2->uint64 & mask)); 
-  if(!is_signed && carry) { // Overflow - unsigned addition, and we see a carray bit
-    *overflow = 1;
-  } else if(is_signed) {
-    uint64_t sign_mask = eval_const_get_sign_mask(size);
-    uint64_t op1_sign = op1->uint64 & sign_mask;
-    uint64_t op2_sign = op2->uint64 & sign_mask;
-    uint64_t result_sign = result & sign_mask;
-    if(op1_sign && op2_sign && !result_sign) *overflow = 1; // Underflow - neg + neg = pos
-    else if(!op1_sign && !op2_sign && result_sign) *overflow = 1; // Overflow - pos + pos = neg
-  }
-  return result;
+__uint128_t eval_const_add(value_t *op1, value_t *op2, int size, int is_signed, int *overflow) {
+  return eval_const_arith(EXP_ADD, op1, op2, size, is_signed, overflow);
 }
 
-uint64_t eval_const_sub(value_t *op1, value_t *op2, int size, int is_signed, int *overflow) {
-  *overflow = 0;
-  uint64_t mask = eval_const_get_mask(size);
-  if(!is_signed) {
-    if((op1->uint64 & mask) < (op2->uint64 & mask)) *overflow = 1; // Unsigned overflow
-    return ((op1->uint64 & mask) - (op2->uint64 & mask)) & mask;
-  }
-  value_t temp;
-  temp.uint64 = (~op2->uint64 + 1) & mask; // 2's complement
-  return eval_const_add(op1, &temp, size, is_signed, overflow);
-}
-
-uint64_t eval_const_mul(value_t *op1, value_t *op2, int size, int is_signed, int *overflow) {
-  *overflow = 0;
-  int final_invert_sign = 0;
-  __uint128_t mask = (__uint128_t)eval_const_get_mask(size);
-  __uint128_t sign_mask = (__uint128_t)eval_const_get_sign_mask(size);
-  __uint128_t op1_value = (__uint128_t)op1->uint64 & mask;
-  __uint128_t op2_value = (__uint128_t)op2->uint64 & mask;
-  if(op1_value == 0 || op2_value == 0) return 0UL; // Special handling for zero
-  uint64_t op1_sign = op1_value & sign_mask;
-  uint64_t op2_sign = op2_value & sign_mask;
-  if(is_signed && op1_sign) { op1_value = (~op1_value + 1) & mask; final_invert_sign++; }
-  if(is_signed && op2_sign) { op2_value = (~op2_value + 1) & mask; final_invert_sign++; }
-  final_invert_sign %= 2; // This is 1 if we need to invert the sign after MUL
-  __uint128_t result = op1_value * op2_value;
-  if(result & ~mask) *overflow = 1;
-  else if(is_signed && (result & sign_mask)) *overflow = 1; // Result is negative number
-  result &= mask;
-  return final_invert_sign ? (~result + 1) & mask : result;
+__uint128_t eval_const_sub(value_t *op1, value_t *op2, int size, int is_signed, int *overflow) {
+  return eval_const_arith(EXP_SUB, op1, op2, size, is_signed, overflow);
+}
+
+__uint128_t eval_const_mul(value_t *op1, value_t *op2, int size, int is_signed, int *overflow) {
+  return eval_const_arith(EXP_MUL, op1, op2, size, is_signed, overflow);
 }
 
 // First argument controls whether it is div or mod
-uint64_t eval_const_div_mod(int is_div, value_t *op1, value_t *op2, int size, int is_signed, int *div_zero) {
-  *div_zero = 0;
-  int final_invert_sign = 0;
-  __uint128_t mask = (__uint128_t)eval_const_get_mask(size);
-  __uint128_t sign_mask = (__uint128_t)eval_const_get_sign_mask(size);
-  __uint128_t op1_value = (__uint128_t)op1->uint64 & mask;
-  __uint128_t op2_value = (__uint128_t)op2->uint64 & mask;
-  if(op1_value == 0 || op2_value == 0) return 0UL; // Special handling for zero
-  uint64_t op1_sign = op1_value & sign_mask;
-  uint64_t op2_sign = op2_value & sign_mask;
-  if(is_signed && op1_sign) { op1_value = (~op1_value + 1) & mask; final_invert_sign++; }
-  if(is_signed && op2_sign) { op2_value = (~op2_value + 1) & mask; final_invert_sign++; }
-  final_invert_sign %= 2; // This is 1 if we need to invert the sign after MUL
-  if(op2_value == (__uint128_t)0UL) { // Check div by zero error and returns 0 if it is the case
-    *div_zero = 1; 
-    return 0;
+__uint128_t eval_const_div_mod(int is_div, value_t *op1, value_t *op2, int size, int is_signed, int *div_zero) {
+  __uint128_t mask = eval_const_get_mask(size);
+  *div_zero = (op2->uint128 & mask) == 0;
+  if(*div_zero) return 0; // Returns 0 on div by zero error
+  if(!is_signed) {
+    __uint128_t op1_value = op1->uint128 & mask, op2_value = op2->uint128 & mask;
+    return is_div ? op1_value / op2_value : op1_value % op2_value;
   }
-  __uint128_t result;
-  if(is_div) result = (op1_value / op2_value) & mask;
-  else result = (op1_value % op2_value) & mask;
-  return final_invert_sign ? (uint64_t)((~result + 1) & mask) : (uint64_t)result;
+  __int128_t op1_value = eval_const_load(op1, size, 1), op2_value = eval_const_load(op2, size, 1);
+  if(op2_value == -1) return is_div ? (__uint128_t)-op1_value & mask : 0; // Minimum divided by -1 wraps around
+  return (__uint128_t)(is_div ? op1_value / op2_value : op1_value % op2_value) & mask;
 }
 
 // If first arg is 1 then we left shift and ignore sign; Otherwise right shift and may propagate sign bit
 // op2 is always treated as an unsigned number; If it is larger than size of op1, and it is left shift or right unsigned shift
 // we set overflow flag to 1
-uint64_t eval_const_shift(int is_left, value_t *op1, value_t *op2, int size, int is_signed, int *shift_overflow) {
+__uint128_t eval_const_shift(int is_left, value_t *op1, value_t *op2, int size, int is_signed, int *shift_overflow) {
   *shift_overflow = 0;
-  uint64_t mask = eval_const_get_mask(size);
-  uint64_t sign_mask = eval_const_get_sign_mask(size);
-  uint64_t op1_value = op1->uint64 & mask;
-  uint64_t op2_value = op2->uint64 & mask;
-  uint64_t op1_sign = op1_value & sign_mask;
-  if(op2_value >= 8 * (uint64_t)size) { // Note that we compare bit size
-    if(is_left || (!is_left && !is_signed)) { // Always result in zero
+  __uint128_t mask = eval_const_get_mask(size);
+  __uint128_t op2_value = op2->uint128 & mask;
+  __int128_t op1_value = eval_const_load(op1, size, is_signed && !is_left);
+  if(op2_value >= 8 * (__uint128_t)size) { // Note that we compare bit size
+    if(is_left || !is_signed) { // Always result in zero
       *shift_overflow = 1;
-      return 0UL;
-    } else if(!is_left && is_signed) {
-      return op1_sign ? mask : 0UL; // All 1's, because the sign bit
+      return 0;
     }
+    return op1_value < 0 ? mask : 0; // All 1's, because the sign bit
   }
-  if(is_left) op1_value <<= op2_value;
-  else op1_value >>= op2_value; // This is unsigned shift
-  if(!is_left && op1_sign && is_signed) op1_value |= (mask - (mask >> op2_value)); // Fill high bits with all 1's
-  return op1_value & mask;
+  if(is_left) return ((__uint128_t)op1_value << op2_value) & mask;
+  else if(is_signed) return (__uint128_t)(op1_value >> op2_value) & mask; // Arithmetic shift fills high bits with the sign
+  else return ((__uint128_t)op1_value >> op2_value) & mask;
 }
 
 // Note: This function returns integer because logical operations always returns integer
 // The first argument indicates the type of operation
 int eval_const_cmp(token_type_t op, value_t *op1, value_t *op2, int size, int is_signed) {
-  uint64_t mask = eval_const_get_mask(size);
-  uint64_t op1_value = op1->uint64 & mask;
-  uint64_t op2_value = op2->uint64 & mask;
+  __int128_t op1_value = eval_const_load(op1, size, is_signed), op2_value = eval_const_load(op2, size, is_signed);
+  __uint128_t op1_uvalue = (__uint128_t)op1_value, op2_uvalue = (__uint128_t)op2_value; // Zero extended if unsigned
   int ret = 0;
-  int shift_bits = (8 * (TYPE_LONG_SIZE - size)); // We shift all valid bits of this size to MSB and use native cmp
-  op1_value <<= shift_bits;
-  op2_value <<= shift_bits;
   switch(op) {
-    case EXP_LESS: ret = is_signed ? op1_value < op2_value : (int64_t)op1_value < (int64_t)op2_value; break;
-    case EXP_LEQ: ret = is_signed ? op1_value <= op2_value : (int64_t)op1_value <= (int64_t)op2_value; break;
-    case EXP_GREATER: ret = is_signed ? op1_value > op2_value : (int64_t)op1_value > (int64_t)op2_value; break;
-    case EXP_GEQ: ret = is_signed ? op1_value >= op2_value : (int64_t)op1_value >= (int64_t)op2_value; break;
+    case EXP_LESS: ret = is_signed ? op1_value < op2_value : op1_uvalue < op2_uvalue; break;
+    case EXP_LEQ: ret = is_signed ? op1_value <= op2_value : op1_uvalue <= op2_uvalue; break;
+    case EXP_GREATER: ret = is_signed ? op1_value > op2_value : op1_uvalue > op2_uvalue; break;
+    case EXP_GEQ: ret = is_signed ? op1_value >= op2_value : op1_uvalue >= op2_uvalue; break;
     case EXP_EQ: ret = op1_value == op2_value; break; // == and != ignores sign
     case EXP_NEQ: ret = op1_value != op2_value; break;
     default: assert(0); break;
@@ -174,38 +135,51 @@ int eval_const_cmp(token_type_t op, value_t *op1, value_t *op2, int size, int is
 }
 
 // Binary bitwise operations: AND/OR/XOR
-uint64_t eval_const_bitwise(token_type_t op, value_t *op1, value_t *op2, int size) {
-  uint64_t mask = eval_const_get_mask(size);
-  uint64_t op1_value = op1->uint64 & mask;
-  uint64_t op2_value = op2->uint64 & mask;
-  uint64_t ret = 0;
+__uint128_t eval_const_bitwise(token_type_t op, value_t *op1, value_t *op2, int size) {
+  __uint128_t mask = eval_const_get_mask(size);
+  __uint128_t ret = 0;
   switch(op) {
-    case EXP_BIT_AND: ret = op1_value & op2_value; break;
-    case EXP_BIT_OR: ret = op1_value | op2_value; break;
-    case EXP_BIT_XOR: ret = op1_value ^ op2_value; break;
+    case EXP_BIT_AND: ret = op1->uint128 & op2->uint128; break;
+    case EXP_BIT_OR: ret = op1->uint128 | op2->uint128; break;
+    case EXP_BIT_XOR: ret = op1->uint128 ^ op2->uint128; break;
     default: assert(0); break;
   }
   return ret & mask;
 }
 
 // Unary operator: logical AND, bitwise AND, negate, plus (which does not change the value)
-// Note that logical not returns uint64_t which is different from comparison
-uint64_t eval_const_unary(token_type_t op, value_t *value, int size) {
-  uint64_t mask = eval_const_get_mask(size);
-  uint64_t ret = 0UL;
+// Note that logical not returns the same type as the operand which is different from comparison
+__uint128_t eval_const_unary(token_type_t op, value_t *value, int size) {
+  __uint128_t mask = eval_const_get_mask(size);
+  __uint128_t ret = 0;
   switch(op) {
-    case EXP_PLUS: ret = value->uint64 & mask; break;
-    case EXP_MINUS: ret = (~value->uint64 + 1) & mask; break;
-    case EXP_BIT_NOT: ret = ~value->uint64 & mask; break;
-    case EXP_LOGICAL_NOT: ret = !value->uint64; break;
+    case EXP_PLUS: ret = value->uint128 & mask; break;
+    case EXP_MINUS: ret = (~value->uint128 + 1) & mask; break;
+    case EXP_BIT_NOT: ret = ~value->uint128 & mask; break;
+    case EXP_LOGICAL_NOT: ret = (value->uint128 & mask) == 0; break;
     default: assert(0); break;
   }
   return ret;
 }
 
-// Represent a character as \xhh
-char *eval_hex_char(char ch) {
-  static char buffer[5];
+// Prints the low size bytes of the value in decimal to the end of the buffer, which should have at least 
+// EVAL_INT_STR_SIZE bytes; Returns the beginning of the string
+char *eval_print_int_buf(value_t *value, int size, int is_signed, char *buffer) {
+  __int128_t signed_value = eval_const_load(value, size, is_signed);
+  int negative = is_signed && signed_value < 0;
+  __uint128_t abs_value = negative ? -(__uint128_t)signed_value : (__uint128_t)signed_value;
+  char *s = buffer + EVAL_INT_STR_SIZE - 1;
+  *s = '\0';
+  do {
+    *--s = (char)('0' + (int)(abs_value % 10));
+    abs_value /= 10;
+  } while(abs_value != 0);
+  if(negative) *--s = '-';
+  return s;
+}
+
+// Represent a character as \xhh in the buffer, which should have at least EVAL_HEX_CHAR_SIZE bytes
+char *eval_hex_char_buf(char ch, char *buffer) {
   if(isprint(ch)) sprintf(buffer, "%c", ch);
   else sprintf(buffer, "\\x%02X", (unsigned char)ch); // Use a cast to avoid sign extension
   return buffer;
@@ -343,6 +317,14 @@ str_t *eval_const_str_token(token_t *token) {
   return s;
 }
 
+// Allocates a zero-initialized temporary value; Temporaries are released together when the next outermost 
+// eval_const_exp() begins, so callers must copy the result before evaluating another expression
+value_t *eval_value_init(type_cxt_t *cxt) {
+  value_t *value = (value_t *)arena_alloc(&cxt->eval_arena, sizeof(value_t));
+  memset(value, 0x00, sizeof(value_t));
+  return value;
+}
+
 value_t *eval_const_get_int_value(type_cxt_t *cxt, token_t *token) {
   assert(BASETYPE_GET(token->decl_prop) >= BASETYPE_CHAR && BASETYPE_GET(token->decl_prop) <= BASETYPE_ULLONG);
   char *s = token->str;
@@ -354,9 +336,9 @@ value_t *eval_const_get_int_value(type_cxt_t *cxt, token_t *token) {
     case T_DEC_INT_CONST: base = 10; break;
     default: assert(0); break;
   }
-  value_t *value = value_init(cxt);
+  value_t *value = eval_value_init(cxt);
   value->addrtype = ADDR_IMM;
-  value->type = type_init_from(cxt, &type_builtin_ints[BASETYPE_INDEX(token->decl_prop)], token->offset);
+  value->type = type_getint(token->decl_prop);
   if(token->type == T_CHAR_CONST) { // Char const is directly evaluated because we know the size
     assert(token->decl_prop == BASETYPE_CHAR);
     value->int8 = (int8_t)eval_const_char_token(token);
@@ -368,8 +350,10 @@ value_t *eval_const_get_int_value(type_cxt_t *cxt, token_t *token) {
     if(size > EVAL_MAX_CONST_SIZE)
       error_row_col_exit(token->offset, "Currently only support constants within %d bytes\n", EVAL_MAX_CONST_SIZE);
     value_t base_value, digit_value;
-    base_value.int32 = base;
+    base_value.uint128 = (__uint128_t)base;
     int already_warned = 0;
+    int negative = *s == '-'; // Only in folded constants, see eval_fold_literal()
+    if(negative) s++;
     while(*s) {
       char ch = *s;
       int digit = 999; // Always > base if none of the below satisfies
@@ -378,10 +362,11 @@ value_t *eval_const_get_int_value(type_cxt_t *cxt, token_t *token) {
       else if(ch >= 'a' && ch <= 'f') digit = (int)(ch - 'a' + 10);
       if(digit >= base) 
         error_row_col_exit(token->offset, "Invalid character '%s' for base %d\n", eval_hex_char(ch), base);
-      digit_value.int32 = digit;
+      digit_value.uint128 = (__uint128_t)digit;
       int of1, of2;
-      value->uint64 = eval_const_mul(value, &base_value, size, sign, &of1);
-      value->uint64 = eval_const_add(value, &digit_value, size, sign, &of2);
+      value->uint128 = eval_const_mul(value, &base_value, size, sign, &of1);
+      if(negative) value->uint128 = eval_const_sub(value, &digit_value, size, sign, &of2);
+      else value->uint128 = eval_const_add(value, &digit_value, size, sign, &of2);
       if(!already_warned && (of1 || of2)) {
         warn_row_col_exit(token->offset, "Integer literal \"%s\" overflows for type \"%s\"\n", 
           token->str, token_decl_print(token->decl_prop));
@@ -393,30 +378,76 @@ value_t *eval_const_get_int_value(type_cxt_t *cxt, token_t *token) {
   return value;
 }
 
+// Returns a zero value of the error type, which is used as the result of an invalid expression
+value_t *eval_const_error_value(type_cxt_t *cxt) {
+  value_t *value = eval_value_init(cxt);
+  value->addrtype = ADDR_IMM;
+  value->type = &type_builtin_error;
+  return value;
+}
+
+// Returns the number of leading children whose values are needed by eval_const_node()
+int eval_const_arity(token_t *exp, void *arg) {
+  if(BASETYPE_GET(exp->decl_prop) || exp->type == T_STR_CONST || exp->type == T_IDENT) return 0;
+  switch(exp->type) {
+    case EXP_ADD: case EXP_SUB: case EXP_MUL: case EXP_DIV: case EXP_MOD:
+    case EXP_LSHIFT: case EXP_RSHIFT:
+    case EXP_LESS: case EXP_LEQ: case EXP_GREATER: case EXP_GEQ:
+    case EXP_EQ: case EXP_NEQ: case EXP_BIT_AND: case EXP_BIT_OR: case EXP_BIT_XOR: return 2;
+    case EXP_COND: return 3;
+    case EXP_PLUS: case EXP_MINUS: case EXP_BIT_NOT: case EXP_LOGICAL_NOT: case EXP_CAST: return 1;
+    default: return 0; // sizeof() does not evaluate its operand; Unsupported operators report error in the node
+  }
+}
+
+void *eval_const_visit(token_t *exp, void **results, void *arg) {
+  return eval_const_node((type_cxt_t *)arg, exp, (value_t **)results);
+}
+
 // This function evaluates a constant expression
+// Operands are evaluated exactly once in post-order with an explicit stack, such that deeply nested 
+// expressions do not overflow the C stack; Leaf nodes are evaluated directly
+// The result is a temporary, see eval_value_init(); Nested evaluations, e.g. array sizes in a cast, keep the
+// temporaries of the enclosing one
 value_t *eval_const_exp(type_cxt_t *cxt, token_t *exp) {
+  if(cxt->eval_depth == 0) arena_reset(&cxt->eval_arena);
+  cxt->eval_depth++;
+  value_t *value;
+  if(eval_const_arity(exp, cxt) == 0) value = eval_const_node(cxt, exp, NULL);
+  else value = (value_t *)ast_postorder(&cxt->walk, exp, eval_const_arity, eval_const_visit, cxt);
+  cxt->eval_depth--;
+  return value;
+}
+
+// Evaluates a single node given values of its children in the array, the number of which is 
+// determined by eval_const_arity(); Child values are owned by this function and may be modified
+value_t *eval_const_node(type_cxt_t *cxt, token_t *exp, value_t **values) {
   // Leaf types: Integer literal, string literal and identifiers
   if(BASETYPE_GET(exp->decl_prop) >= BASETYPE_CHAR && BASETYPE_GET(exp->decl_prop) <= BASETYPE_ULLONG) {
     return eval_const_get_int_value(cxt, exp);
   } else if(exp->type == T_STR_CONST) { // I tested with GCC and it does not support this, so let's keep it consistent
-    error_row_col_exit(exp->offset, "String literal is not allowed in a constant expression\n");
+    return eval_error_cont(cxt, exp->offset, "String literal is not allowed in a constant expression\n");
   } else if(BASETYPE_GET(exp->decl_prop)) {  // Unsupported base type literal
     type_error_not_supported(exp->offset, exp->decl_prop);
   } else if(exp->type == T_IDENT) { // Might be of type ADDR_IMM, in which case we take int32
     value_t *value = scope_search(cxt, SCOPE_VALUE, exp->str);
     if(!value) {
-      error_row_col_exit(exp->offset, "Name \"%s\" does not exist in current scope\n", exp->str);
+      return eval_error_cont(cxt, exp->offset, "Name \"%s\" does not exist in current scope\n", exp->str);
     } else if(value->addrtype != ADDR_IMM) {
-      error_row_col_exit(exp->offset, "Name \"%s\" is not a compile-time constant\n", exp->str);
+      return eval_error_cont(cxt, exp->offset, "Name \"%s\" is not a compile-time constant\n", exp->str);
     }
     // Make a copy and return - we may modify this object, so a copy is needed
-    value_t *ret = value_init(cxt);
+    value_t *ret = eval_value_init(cxt);
     ret->int32 = value->int32;
     ret->type = value->type;
     ret->addrtype = ADDR_IMM;
     return ret;
   }
 
+  // An operand with an error has been reported; Do not report again for the enclosing expression
+  int arity = eval_const_arity(exp, cxt);
+  for(int i = 0;i < arity;i++) if(type_is_error(values[i]->type)) return values[i];
+
   // For supported binary operands, first determine result type, and cast operands
   // to that type
   token_t *op1 = ast_getchild(exp, 0);
@@ -429,35 +460,35 @@ value_t *eval_const_exp(type_cxt_t *cxt, token_t *exp) {
     case EXP_LESS: case EXP_LEQ: case EXP_GREATER: case EXP_GEQ:
     case EXP_EQ: case EXP_NEQ: case EXP_BIT_AND: case EXP_BIT_OR: case EXP_BIT_XOR: {
       assert(op1 && op2);
-      op1_value = eval_const_exp(cxt, op1);
-      op2_value = eval_const_exp(cxt, op2);
+      op1_value = values[0];
+      op2_value = values[1];
       if(!type_is_int(op1_value->type) || !type_is_int(op2_value->type))
-        error_row_col_exit(exp->offset, "Consant expression operator must only have integer operands\n");
+        return eval_error_cont(cxt, exp->offset, "Consant expression operator must only have integer operands\n");
       target_type = type_int_convert(op1_value->type, op2_value->type);
-      // Eval and then convert to the target type
-      op1_value = eval_const_to_type(cxt, op1, target_type, TYPE_CAST_IMPLICIT);
-      op2_value = eval_const_to_type(cxt, op2, target_type, TYPE_CAST_IMPLICIT);
+      // Convert both operands to the target type
+      eval_const_convert(op1_value, target_type, TYPE_CAST_IMPLICIT, op1->offset);
+      eval_const_convert(op2_value, target_type, TYPE_CAST_IMPLICIT, op2->offset);
     } break;
     case EXP_COND: { // It has three operands: op1 (cond), op2, op3
       token_t *op3 = ast_getchild(exp, 2);
       assert(op1 && op2 && op3);
-      op1_value = eval_const_exp(cxt, op1);
-      op2_value = eval_const_exp(cxt, op2);
+      op1_value = values[0];
+      op2_value = values[1];
       if(!type_is_int(op1_value->type)) // Only check the condition; op2 and op3 will be checked by upper levels
-        error_row_col_exit(exp->offset, "Consant expression operator must only have integer operands\n");
-      value_t *op3_value = eval_const_exp(cxt, op3);
+        return eval_error_cont(cxt, exp->offset, "Consant expression operator must only have integer operands\n");
+      value_t *op3_value = values[2];
       if(type_cmp(op3_value->type, op2_value->type) != TYPE_CMP_EQ) 
-        error_row_col_exit(exp->offset, "Condition operator must return two identical types\n");
+        return eval_error_cont(cxt, exp->offset, "Condition operator must return two identical types\n");
       int cond = eval_const_is_zero(op1_value, op1_value->type->size);
       if(cond) return op3_value;
       else return op2_value;
     } break;
     case EXP_PLUS: case EXP_MINUS: case EXP_BIT_NOT: case EXP_LOGICAL_NOT: {
       assert(op1);
-      op1_value = eval_const_exp(cxt, op1);
+      op1_value = values[0];
       if(!type_is_int(op1_value->type))
-        error_row_col_exit(exp->offset, "Consant expression operator must only have integer operands\n");
-      op1_value->uint64 = eval_const_unary(exp->type, op1_value, op1_value->type->size);
+        return eval_error_cont(cxt, exp->offset, "Consant expression operator must only have integer operands\n");
+      op1_value->uint128 = eval_const_unary(exp->type, op1_value, op1_value->type->size);
       return op1_value;
     } break;
     case EXP_CAST: {
@@ -465,7 +496,8 @@ value_t *eval_const_exp(type_cxt_t *cxt, token_t *exp) {
       token_t *basetype_token = ast_getchild(decl_token, 0);
       // Allow casting to void or functions returning void; Does not casting to anything with const/volatile
       type_t *target = type_gettype(cxt, decl_token, basetype_token, TYPE_ALLOW_VOID); 
-      op1_value = eval_const_to_type(cxt, op1, target, TYPE_CAST_EXPLICIT);
+      op1_value = values[0];
+      eval_const_convert(op1_value, target, TYPE_CAST_EXPLICIT, op1->offset);
       return op1_value;
     } break;
     case EXP_SIZEOF: {
@@ -476,54 +508,54 @@ value_t *eval_const_exp(type_cxt_t *cxt, token_t *exp) {
         assert(basetype);
         type = type_gettype(cxt, op1, basetype, TYPE_ALLOW_VOID | TYPE_ALLOW_QUAL); // Allow void but not storage class
         if(type_is_void(type)) {
-          error_row_col_exit(exp->offset, "\"void\" cannot be used in sizeof() expression\n");
+          return eval_error_cont(cxt, exp->offset, "\"void\" cannot be used in sizeof() expression\n");
         } else if(type_is_func(type)) {
-          error_row_col_exit(exp->offset, "Function type cannot be used in sizeof() expression\n");
+          return eval_error_cont(cxt, exp->offset, "Function type cannot be used in sizeof() expression\n");
         } else if(type->size == TYPE_UNKNOWN_SIZE) {
-          error_row_col_exit(exp->offset, "Sizeof operator with an incomplete type\n");
+          return eval_error_cont(cxt, exp->offset, "Sizeof operator with an incomplete type\n");
         }
       } else {
         type = type_typeof(cxt, op1, TYPEOF_IGNORE_FUNC_ARG | TYPEOF_IGNORE_ARRAY_INDEX);
+        if(type_is_error(type)) return eval_const_error_value(cxt);
       }
-      value_t *value = value_init(cxt);
+      value_t *value = eval_value_init(cxt);
       value->addrtype = ADDR_IMM;
       value->type = type_getint(TYPE_SIZEOF_TYPE);
       value->uint64 = type->size;
       return value;
     } break;
-    default: error_row_col_exit(exp->offset, "Operator \"%s\" is not supported for constant expression\n", 
+    default: return eval_error_cont(cxt, exp->offset, "Operator \"%s\" is not supported for constant expression\n", 
       token_symstr(exp->type));
-      break;
   }
   
-  value_t *ret = value_init(cxt); // Value will be set in switch statement
+  value_t *ret = eval_value_init(cxt); // Value will be set in switch statement
   ret->addrtype = ADDR_IMM;
   ret->type = target_type; // This might be changed below in case branches
   int target_size = (int)target_type->size;
-  //printf("exp %s target type %s target size %d\n", token_typestr(exp->type), type_print_str(0, target_type, 0, 0), target_size);
+  //printf("exp %s target type %s target size %d\n", token_typestr(exp->type), type_print_str(cxt, 0, target_type, 0, 0), target_size);
   //printf("op1 0x%lX op2 0x%lX\n", op1_value->uint64, op2_value->uint64);
   int flag = 0; // Overflow or div-by-zero
   int is_signed = type_is_signed(target_type);
   assert(op1_value && op2_value);
   switch(exp->type) {
     case EXP_ADD: {
-      ret->uint64 = eval_const_add(op1_value, op2_value, target_size, is_signed, &flag);
+      ret->uint128 = eval_const_add(op1_value, op2_value, target_size, is_signed, &flag);
       if(flag) warn_row_col_exit(exp->offset, "Operator '+' overflows during constant evaluation\n");
     } break;
     case EXP_SUB: {
-      ret->uint64 = eval_const_sub(op1_value, op2_value, target_size, is_signed, &flag);
+      ret->uint128 = eval_const_sub(op1_value, op2_value, target_size, is_signed, &flag);
       if(flag) warn_row_col_exit(exp->offset, "Operator '-' overflows during constant evaluation\n");
     } break;
     case EXP_MUL: {
-      ret->uint64 = eval_const_mul(op1_value, op2_value, target_size, is_signed, &flag);
+      ret->uint128 = eval_const_mul(op1_value, op2_value, target_size, is_signed, &flag);
       if(flag) warn_row_col_exit(exp->offset, "Operator '*' overflows during constant evaluation\n");
     } break;
     case EXP_DIV: case EXP_MOD: {
-      ret->uint64 = eval_const_div_mod(exp->type == EXP_DIV, op1_value, op2_value, target_size, is_signed, &flag);
+      ret->uint128 = eval_const_div_mod(exp->type == EXP_DIV, op1_value, op2_value, target_size, is_signed, &flag);
       if(flag) warn_row_col_exit(exp->offset, "Divide-by-zero during constant evaluation\n");
     } break;
     case EXP_LSHIFT: case EXP_RSHIFT: {
-      ret->uint64 = eval_const_shift(exp->type == EXP_LSHIFT, op1_value, op2_value, target_size, is_signed, &flag);
+      ret->uint128 = eval_const_shift(exp->type == EXP_LSHIFT, op1_value, op2_value, target_size, is_signed, &flag);
       if(flag) warn_row_col_exit(exp->offset, "Shift length is greater than integer size\n");
     } break;
     case EXP_LESS: case EXP_GREATER: case EXP_LEQ: case EXP_GEQ: case EXP_EQ: case EXP_NEQ: {
@@ -531,19 +563,165 @@ value_t *eval_const_exp(type_cxt_t *cxt, token_t *exp) {
       ret->int32 = eval_const_cmp(exp->type, op1_value, op2_value, target_size, is_signed);
     } break;
     case EXP_BIT_AND: case EXP_BIT_OR: case EXP_BIT_XOR: {  
-      ret->uint64 = eval_const_bitwise(exp->type, op1_value, op2_value, target_size);
+      ret->uint128 = eval_const_bitwise(exp->type, op1_value, op2_value, target_size);
     } break;
     default: assert(0); break; // If there is an unknown op it must not pass the previous switch stmt
   }
   return ret;
 }
 
-value_t *eval_const_to_type(type_cxt_t *cxt, token_t *exp, type_t *type, int cast_type) {
+// Converts an evaluated value to the given type in-place; Offset is used for error reporting
+// If the cast is invalid and errors are collected, the value becomes an error value
+void eval_const_convert(value_t *value, type_t *type, int cast_type, char *offset) {
   assert(cast_type == TYPE_CAST_IMPLICIT || cast_type == TYPE_CAST_EXPLICIT);
-  value_t *value = eval_const_exp(cxt, exp);
-  int cast_action = type_cast(type, value->type, cast_type, exp->offset);
+  int cast_action = type_cast(type, value->type, cast_type, offset);
+  if(cast_action == TYPE_CAST_INVALID || type_is_error(type) || type_is_error(value->type)) {
+    value->uint128 = 0;
+    value->type = &type_builtin_error;
+    return;
+  }
   int sign_ext = cast_action == TYPE_CAST_SIGN_EXT;
-  value->uint64 = eval_const_adjust_size(value, type->size, value->type->size, sign_ext);
+  value->uint128 = eval_const_adjust_size(value, type->size, value->type->size, sign_ext);
   value->type = type; // Assign the new type
+  return;
+}
+
+value_t *eval_const_to_type(type_cxt_t *cxt, token_t *exp, type_t *type, int cast_type) {
+  value_t *value = eval_const_exp(cxt, exp);
+  eval_const_convert(value, type, cast_type, exp->offset);
   return value;
-}
\ No newline at end of file
+}
+
+// The following functions fold constant subtrees of type checked expressions in function bodies, such 
+// that later passes see smaller trees. Nodes are rewritten in place with ast_replace()
+
+// Returns 1 if the token is an integer literal, including folded ones
+int eval_fold_is_literal(token_t *token) {
+  return token->type >= T_DEC_INT_CONST && token->type <= T_CHAR_CONST && 
+    BASETYPE_GET(token->decl_prop) >= BASETYPE_CHAR && BASETYPE_GET(token->decl_prop) <= BASETYPE_ULLONG;
+}
+
+// Returns 1 if the token is an integer literal whose value is the given number
+int eval_fold_is_value(type_cxt_t *cxt, token_t *token, int number) {
+  if(!eval_fold_is_literal(token)) return 0;
+  value_t *value = eval_const_get_int_value(cxt, token);
+  return eval_const_load(value, (int)value->type->size, type_is_signed(value->type)) == number;
+}
+
+// Turns the expression into a decimal literal of the value, which is converted to the type of the expression
+void eval_fold_literal(token_t *exp, value_t *value) {
+  type_t *type = exp->exp_type;
+  eval_const_convert(value, type, TYPE_CAST_IMPLICIT, exp->offset);
+  char buffer[EVAL_INT_STR_SIZE];
+  char *s = eval_print_int_buf(value, (int)type->size, type_is_signed(type), buffer);
+  token_t *literal = token_alloc_type(T_DEC_INT_CONST);
+  token_copy_literal(literal, s, buffer + EVAL_INT_STR_SIZE - 1);
+  literal->decl_prop = BASETYPE_GET(type->decl_prop);
+  literal->offset = exp->offset;
+  literal->exp_type = type;
+  ast_replace(exp, literal);
+  return;
+}
+
+// Returns the number of leading children that are expressions
+int eval_fold_arity(token_t *exp, void *arg) {
+  if(exp->type < EXP_BEGIN || exp->type >= EXP_END) return 0;
+  switch(exp->type) {
+    case EXP_SIZEOF: return 0; // The operand is not evaluated
+    case EXP_DOT: case EXP_ARROW: case EXP_CAST: return 1; // Field names and type names follow
+    default: return ast_child_count(exp);
+  }
+}
+
+void *eval_fold_visit(token_t *exp, void **results, void *arg) {
+  eval_fold_node((type_cxt_t *)arg, exp);
+  return NULL;
+}
+
+// Folds the expression in place bottom-up, and returns the same node; The expression must have been type checked 
+// by type_typeof() with all checks. Temporaries are released as in eval_const_exp()
+token_t *eval_fold_exp(type_cxt_t *cxt, token_t *exp) {
+  if(cxt->eval_depth == 0) arena_reset(&cxt->eval_arena);
+  cxt->eval_depth++;
+  if(eval_fold_arity(exp, cxt) == 0) eval_fold_node(cxt, exp);
+  else ast_postorder(&cxt->walk, exp, eval_fold_arity, eval_fold_visit, cxt);
+  cxt->eval_depth--;
+  return exp;
+}
+
+// Folds a single node whose children have been folded:
+//   1. Operators on integer literals, casts of literals to integers, and sizeof() become literals
+//   2. x + 0, x - 0, x * 1, x / 1, x << 0, x >> 0, x | 0 and x ^ 0 become x if the type does not change
+//   3. Conditional and logical operators with constant conditions keep only the operand that is evaluated
+// Division by a literal zero is kept as is, and nodes with errors or non-integer types are not folded
+void eval_fold_node(type_cxt_t *cxt, token_t *exp) {
+  type_t *type = exp->exp_type;
+  if(type == NULL || type_is_error(type)) return;
+  int is_int = type_is_int(type) && BASETYPE_GET(type->decl_prop) >= BASETYPE_CHAR && 
+    BASETYPE_GET(type->decl_prop) <= BASETYPE_ULLONG;
+  token_t *op1 = exp->child;
+  token_t *op2 = op1 ? op1->sibling : NULL;
+  token_t *keep = NULL; // Operand that replaces the node
+  switch(exp->type) {
+    case EXP_SIZEOF: {
+      if(!is_int) return;
+      value_t *value = eval_const_node(cxt, exp, NULL);
+      if(!type_is_error(value->type)) eval_fold_literal(exp, value);
+    } return;
+    case EXP_CAST: case EXP_PLUS: case EXP_MINUS: case EXP_BIT_NOT: case EXP_LOGICAL_NOT: {
+      if(!is_int || !eval_fold_is_literal(op1)) return;
+      value_t *value = eval_const_get_int_value(cxt, op1);
+      if(exp->type == EXP_LOGICAL_NOT) {
+        value->uint128 = eval_const_is_zero(value, (int)value->type->size);
+        value->type = type;
+      } else { // Operands are promoted before the operator applies
+        eval_const_convert(value, type, exp->type == EXP_CAST ? TYPE_CAST_EXPLICIT : TYPE_CAST_IMPLICIT, op1->offset);
+        if(exp->type != EXP_CAST) value->uint128 = eval_const_unary(exp->type, value, (int)type->size);
+      }
+      if(!type_is_error(value->type)) eval_fold_literal(exp, value);
+    } return;
+    case EXP_COND: {
+      if(!eval_fold_is_literal(op1)) return;
+      value_t *value = eval_const_get_int_value(cxt, op1);
+      keep = eval_const_is_zero(value, (int)value->type->size) ? op2->sibling : op2;
+    } break;
+    case EXP_LOGICAL_AND: case EXP_LOGICAL_OR: {
+      if(!is_int || !eval_fold_is_literal(op1)) return;
+      value_t *value = eval_const_get_int_value(cxt, op1);
+      int result = !eval_const_is_zero(value, (int)value->type->size);
+      if(result == (exp->type == EXP_LOGICAL_AND)) { // The second operand decides
+        if(!eval_fold_is_literal(op2)) return;
+        value = eval_const_get_int_value(cxt, op2);
+        result = !eval_const_is_zero(value, (int)value->type->size);
+      } // Otherwise the second operand is not evaluated
+      value->uint128 = (__uint128_t)result;
+      value->type = type;
+      eval_fold_literal(exp, value);
+    } return;
+    case EXP_ADD: case EXP_SUB: case EXP_MUL: case EXP_DIV: case EXP_MOD:
+    case EXP_LSHIFT: case EXP_RSHIFT:
+    case EXP_LESS: case EXP_LEQ: case EXP_GREATER: case EXP_GEQ:
+    case EXP_EQ: case EXP_NEQ: case EXP_BIT_AND: case EXP_BIT_OR: case EXP_BIT_XOR: {
+      if(is_int && eval_fold_is_literal(op1) && eval_fold_is_literal(op2)) {
+        if((exp->type == EXP_DIV || exp->type == EXP_MOD) && eval_fold_is_value(cxt, op2, 0)) return; // Kept for run time
+        value_t *values[2] = {eval_const_get_int_value(cxt, op1), eval_const_get_int_value(cxt, op2)};
+        value_t *value = eval_const_node(cxt, exp, values);
+        if(!type_is_error(value->type)) eval_fold_literal(exp, value);
+        return;
+      }
+      switch(exp->type) {
+        case EXP_ADD: case EXP_BIT_OR: case EXP_BIT_XOR: 
+          keep = eval_fold_is_value(cxt, op2, 0) ? op1 : (eval_fold_is_value(cxt, op1, 0) ? op2 : NULL); break;
+        case EXP_MUL: keep = eval_fold_is_value(cxt, op2, 1) ? op1 : (eval_fold_is_value(cxt, op1, 1) ? op2 : NULL); break;
+        case EXP_SUB: case EXP_LSHIFT: case EXP_RSHIFT: keep = eval_fold_is_value(cxt, op2, 0) ? op1 : NULL; break;
+        case EXP_DIV: keep = eval_fold_is_value(cxt, op2, 1) ? op1 : NULL; break;
+        default: break;
+      }
+    } break;
+    default: return;
+  }
+  // The remaining operand must have the type of the expression, otherwise a conversion is lost
+  if(keep == NULL || keep->exp_type == NULL || type_cmp(type, keep->exp_type) != TYPE_CMP_EQ) return;
+  ast_replace(exp, keep);
+  return;
+}
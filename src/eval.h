@@ -14,24 +14,33 @@
 #define ATOI_CHECK_END      1  // Do not report error if there is still char after the int literal
 #define ATOI_NO_MAX_CHAR    0  // For \xhh \ooo we only eat 2 and 3 chars respectively
 
-#define EVAL_MAX_CONST_SIZE 8  // We only support evaluating constants smaller than this size
-
-uint64_t eval_int_masks[9];
-
-uint64_t eval_const_get_mask(int size);
-uint64_t eval_const_get_sign_mask(int size);
-int eval_const_is_zero(value_t *value, int size);
-uint64_t eval_const_adjust_size(value_t *value, int to, int from, int is_signed);
-uint64_t eval_const_add(value_t *op1, value_t *op2, int size, int is_signed, int *overflow);
-uint64_t eval_const_sub(value_t *op1, value_t *op2, int size, int is_signed, int *overflow);
-uint64_t eval_const_mul(value_t *op1, value_t *op2, int size, int is_signed, int *overflow);
-uint64_t eval_const_div_mod(int is_div, value_t *op1, value_t *op2, int size, int is_signed, int *div_zero);
-uint64_t eval_const_shift(int is_left, value_t *op1, value_t *op2, int size, int is_signed, int *shift_overflow);
-int      eval_const_cmp(token_type_t op, value_t *op1, value_t *op2, int size, int is_signed);
-uint64_t eval_const_bitwise(token_type_t op, value_t *op1, value_t *op2, int size);
-uint64_t eval_const_unary(token_type_t op, value_t *value, int size);
-
-char *eval_hex_char(char ch);
+#define EVAL_MAX_CONST_SIZE 16 // We only support evaluating constants up to this size
+#define EVAL_HEX_CHAR_SIZE  5  // Buffer size for eval_hex_char_buf(), i.e. \xhh
+#define EVAL_INT_STR_SIZE   41 // Buffer size for eval_print_int_buf(), i.e. sign and 39 digits of 128-bit integers
+
+// Uses a temporary buffer that lives until the end of the enclosing block
+#define eval_hex_char(ch) eval_hex_char_buf(ch, (char [EVAL_HEX_CHAR_SIZE]){0})
+// Reports a recoverable error and evaluates to a zero value of the error type
+#define eval_error_cont(cxt, s, fmt, ...) (error_row_col_cont(s, fmt, ##__VA_ARGS__), eval_const_error_value(cxt))
+
+__uint128_t eval_const_get_mask(int size);
+__uint128_t eval_const_get_sign_mask(int size);
+__int128_t  eval_const_load(value_t *value, int size, int is_signed);
+int         eval_const_in_range(__int128_t result, int size);
+int         eval_const_is_zero(value_t *value, int size);
+__uint128_t eval_const_adjust_size(value_t *value, int to, int from, int is_signed);
+__uint128_t eval_const_arith(token_type_t op, value_t *op1, value_t *op2, int size, int is_signed, int *overflow);
+__uint128_t eval_const_add(value_t *op1, value_t *op2, int size, int is_signed, int *overflow);
+__uint128_t eval_const_sub(value_t *op1, value_t *op2, int size, int is_signed, int *overflow);
+__uint128_t eval_const_mul(value_t *op1, value_t *op2, int size, int is_signed, int *overflow);
+__uint128_t eval_const_div_mod(int is_div, value_t *op1, value_t *op2, int size, int is_signed, int *div_zero);
+__uint128_t eval_const_shift(int is_left, value_t *op1, value_t *op2, int size, int is_signed, int *shift_overflow);
+int         eval_const_cmp(token_type_t op, value_t *op1, value_t *op2, int size, int is_signed);
+__uint128_t eval_const_bitwise(token_type_t op, value_t *op1, value_t *op2, int size);
+__uint128_t eval_const_unary(token_type_t op, value_t *value, int size);
+
+char *eval_hex_char_buf(char ch, char *buffer);
+char *eval_print_int_buf(value_t *value, int size, int is_signed, char *buffer);
 str_t *eval_print_const_str(str_t *s);
 
 // Take a maximum bite and return the next to read
@@ -44,8 +53,23 @@ char eval_const_char_token(token_t *token); // Evaluates char type token to char
 str_t *eval_const_str_token(token_t *token); // Evaluates string token to str_t *
 
 // Evaluating const expression using value_t objects
+value_t *eval_value_init(type_cxt_t *cxt); // Temporary value owned by the evaluator
 value_t *eval_const_get_int_value(type_cxt_t *cxt, token_t *token); // Evaluates int literal and returns value object
+value_t *eval_const_error_value(type_cxt_t *cxt);
+int eval_const_arity(token_t *exp, void *arg);
+void *eval_const_visit(token_t *exp, void **results, void *arg);
 value_t *eval_const_exp(type_cxt_t *cxt, token_t *exp);
+value_t *eval_const_node(type_cxt_t *cxt, token_t *exp, value_t **values);
+void eval_const_convert(value_t *value, type_t *type, int cast_type, char *offset);
 value_t *eval_const_to_type(type_cxt_t *cxt, token_t *exp, type_t *type, int cast_type); // Evaluates and cast to type
 
+// Folding constant subtrees of expressions in function bodies
+int eval_fold_is_literal(token_t *token);
+int eval_fold_is_value(type_cxt_t *cxt, token_t *token, int number);
+void eval_fold_literal(token_t *exp, value_t *value);
+int eval_fold_arity(token_t *exp, void *arg);
+void *eval_fold_visit(token_t *exp, void **results, void *arg);
+token_t *eval_fold_exp(type_cxt_t *cxt, token_t *exp);
+void eval_fold_node(type_cxt_t *cxt, token_t *exp);
+
 #endif
\ No newline at end of file
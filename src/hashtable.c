@@ -14,18 +14,25 @@ hashval_t strhash_cb(void *a) {
 }
 
 hashtable_t *ht_init(eq_cb_t eq, hash_cb_t hash) {
+  return ht_init_size(eq, hash, HT_INIT_CAPACITY);
+}
+
+// Capacity must be a power of two
+hashtable_t *ht_init_size(eq_cb_t eq, hash_cb_t hash, int capacity) {
+  assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
   hashtable_t *ht = (hashtable_t *)malloc(sizeof(hashtable_t));
   SYSEXPECT(ht != NULL);
   ht->eq = eq;
   ht->hash = hash;
-  ht->mask = HT_INIT_MASK;
+  ht->mask = (hashval_t)capacity - 1;
   ht->size = 0;
-  ht->capacity = HT_INIT_CAPACITY;
-  ht->keys = (void **)malloc(sizeof(void *) * HT_INIT_CAPACITY);
-  ht->values = (void **)malloc(sizeof(void *) * HT_INIT_CAPACITY);
+  ht->capacity = capacity;
+  ht->keys = (void **)malloc(sizeof(void *) * capacity);
+  ht->values = (void **)malloc(sizeof(void *) * capacity);
   SYSEXPECT(ht->keys != NULL && ht->values != NULL);
   memset(ht->keys, 0x00, sizeof(void *) * ht->capacity);
   memset(ht->values, 0x00, sizeof(void *) * ht->capacity);
+  mem_stat_add(MEM_HASHTABLE, 1, sizeof(hashtable_t) + sizeof(void *) * 2 * ht->capacity);
   return ht;
 }
 
@@ -34,6 +41,7 @@ hashtable_t *ht_str_init() {
 }
 
 void ht_free(hashtable_t *ht) {
+  mem_stat_add(MEM_HASHTABLE, -1, -(long)(sizeof(hashtable_t) + sizeof(void *) * 2 * ht->capacity));
   free(ht->keys);
   free(ht->values);
   free(ht);
@@ -81,6 +89,7 @@ void ht_resize(hashtable_t *ht) {
   }
   free(ht->keys);
   free(ht->values);
+  mem_stat_add(MEM_HASHTABLE, 0, sizeof(void *) * ht->capacity); // Two arrays of half the capacity
   ht->keys = new_keys;
   ht->values = new_values;
   return;
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "error.h"
+#include "mem.h"
 
 // Must be a power of two
 #define HT_INIT_CAPACITY 128
@@ -36,6 +37,7 @@ int streq_cb(void *a, void *b);
 int strcmp_cb(void *a, void *b);
 hashval_t strhash_cb(void *a);
 hashtable_t *ht_init(eq_cb_t eq, hash_cb_t hash);
+hashtable_t *ht_init_size(eq_cb_t eq, hash_cb_t hash, int capacity);
 hashtable_t *ht_str_init();
 void ht_free(hashtable_t *ht);
 int ht_size(hashtable_t *ht);
@@ -11,6 +11,8 @@ list_t *list_init() {
   SYSEXPECT(list != NULL);
   list->size = 0;
   list->head = list->tail = NULL;
+  list->key_free_cb = list->value_free_cb = NULL;
+  mem_stat_add(MEM_LIST, 1, sizeof(list_t));
   return list;
 }
 
@@ -28,6 +30,7 @@ void list_free(list_t *list) {
     listnode_free(node);
     node = next;
   }
+  mem_stat_add(MEM_LIST, -1, -(long)sizeof(list_t));
   free(list);
   return;
 }
@@ -46,9 +49,11 @@ int list_size(list_t *list) {
 listnode_t *listnode_alloc() {
   listnode_t *node = (listnode_t *)malloc(sizeof(listnode_t));
   SYSEXPECT(node != NULL);
+  mem_stat_add(MEM_LISTNODE, 1, sizeof(listnode_t));
   return node;
 }
 void listnode_free(listnode_t *node) { 
+  mem_stat_add(MEM_LISTNODE, -1, -(long)sizeof(listnode_t));
   free(node); 
   return;
 }
@@ -0,0 +1,57 @@
+
+#include "mem.h"
+#include <string.h>
+
+int mem_stat_enabled = 0;
+mem_stat_t mem_stats[MEM_KIND_COUNT];
+const char *mem_kind_names[MEM_KIND_COUNT] = {
+  "token", "token str", "type_t", "comp_t", "field_t", "enum_t", "value_t", 
+  "hashtable", "list", "list node", "bintree", "cgen_gdata_t", "arena chunk",
+};
+
+// Objects allocated before accounting is enabled are not tracked, so counters restart from zero
+void mem_stat_enable(int enabled) {
+  mem_stat_reset();
+  mem_stat_enabled = enabled;
+  return;
+}
+
+void mem_stat_reset() {
+  memset(mem_stats, 0x00, sizeof(mem_stats));
+  return;
+}
+
+// Raises peak to at least value
+void mem_stat_raise(long *peak, long value) {
+  long prev = __atomic_load_n(peak, __ATOMIC_RELAXED);
+  while(prev < value && !__atomic_compare_exchange_n(peak, &prev, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  return;
+}
+
+void mem_stat_add_(mem_kind_t kind, long count, long bytes) {
+  mem_stat_t *stat = &mem_stats[kind];
+  long live = __atomic_add_fetch(&stat->count, count, __ATOMIC_RELAXED);
+  long live_bytes = __atomic_add_fetch(&stat->bytes, bytes, __ATOMIC_RELAXED);
+  if(count > 0) {
+    __atomic_add_fetch(&stat->total_count, count, __ATOMIC_RELAXED);
+    mem_stat_raise(&stat->peak_count, live);
+  }
+  if(bytes > 0) mem_stat_raise(&stat->peak_bytes, live_bytes);
+  return;
+}
+
+void mem_stat_print(FILE *fp) {
+  fprintf(fp, "%-14s %10s %10s %10s %12s %12s\n", "Kind", "Live", "Peak", "Total", "Bytes", "Peak Bytes");
+  long bytes = 0, peak_bytes = 0;
+  for(int i = 0;i < MEM_KIND_COUNT;i++) {
+    mem_stat_t *stat = &mem_stats[i];
+    fprintf(fp, "%-14s %10ld %10ld %10ld %12ld %12ld\n", mem_kind_names[i], 
+      stat->count, stat->peak_count, stat->total_count, stat->bytes, stat->peak_bytes);
+    if(i == MEM_ARENA) continue; // Objects in arena chunks are already counted by kind
+    bytes += stat->bytes;
+    peak_bytes += stat->peak_bytes;
+  }
+  // Peaks of different kinds may not coincide, so their sum is an upper bound
+  fprintf(fp, "%-14s %10s %10s %10s %12ld %12ld\n", "(all)", "", "", "", bytes, peak_bytes);
+  return;
+}
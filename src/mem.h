@@ -0,0 +1,50 @@
+
+#ifndef _MEM_H
+#define _MEM_H
+
+#include <stdio.h>
+
+// Memory accounting per object kind. Disabled by default; When enabled, the init and free functions
+// of each kind update live, peak and total counts as well as bytes. Counters are updated atomically
+// since parse_parallel() allocates tokens on worker threads
+
+typedef enum {
+  MEM_TOKEN = 0,
+  MEM_TOKEN_STR,             // Literals copied into tokens
+  MEM_TYPE,
+  MEM_COMP,
+  MEM_FIELD,
+  MEM_ENUM,
+  MEM_VALUE,
+  MEM_HASHTABLE,             // Including key and value arrays
+  MEM_LIST,
+  MEM_LISTNODE,
+  MEM_BINTREE,               // Including nodes
+  MEM_GDATA,                 // Including data
+  MEM_ARENA,                 // Arena chunks; Objects allocated from them are also counted by kind
+  MEM_KIND_COUNT,
+} mem_kind_t;
+
+typedef struct {
+  long count;                // Live objects
+  long peak_count;
+  long total_count;          // Objects ever allocated
+  long bytes;                // Live bytes
+  long peak_bytes;
+} mem_stat_t;
+
+extern int mem_stat_enabled;
+extern mem_stat_t mem_stats[MEM_KIND_COUNT];
+extern const char *mem_kind_names[MEM_KIND_COUNT];
+
+void mem_stat_enable(int enabled);
+void mem_stat_reset();
+void mem_stat_add_(mem_kind_t kind, long count, long bytes);
+void mem_stat_print(FILE *fp);
+
+// Count is 1 for a new object, -1 for a freed one, and 0 if only the size changes
+static inline void mem_stat_add(mem_kind_t kind, long count, long bytes) {
+  if(mem_stat_enabled) mem_stat_add_(kind, count, bytes);
+}
+
+#endif
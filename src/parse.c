@@ -1,73 +1,354 @@
 
+#include <pthread.h>
 #include "parse.h"
 
 parse_stmt_cxt_t *parse_init(char *input) { return parse_exp_init(input); }
 void parse_free(parse_cxt_t *cxt) { parse_exp_free(cxt); }
 
 // Top-level parsing, i.e., global level parsing
+// If lazy_body is set in the context then function bodies are only skimmed, and can be parsed
+// later on demand using parse_func_body()
+token_t *parse(parse_cxt_t *cxt) {
+  token_t *root = cxt->root = token_alloc_type(T_ROOT);
+  while(token_lookahead(cxt->token_cxt, 1) != NULL) { // Until EOF
+    parse_global_item(cxt, root);
+  }
+  return root;
+}
+
+// Parses a single top-level item, appends it to the root, and returns the item
+// The offset of the item is its first token, such that items partition the source text
 // There are five possible cases:
 //  1. Base type + ';' must be a type declaration, most likely struct/union/enum
 //  2. Base type + decl + "," must be a type declaration or data definition
 //  3. Base type + decl + "=" must be a data definition with initializer
 //  4. Base type + decl + ";" must be a global declaration, or function prototype
 //  5. Base type + func decl + '{' must be function definition
-token_t *parse(parse_cxt_t *cxt) {
-  token_t *root = token_alloc_type(T_ROOT);
+token_t *parse_global_item(parse_cxt_t *cxt, token_t *root) {
+  char *begin = token_lookahead_notnull(cxt->token_cxt, 1)->offset;
+  token_t *basetype = parse_decl_basetype(cxt);
+  if(token_lookahead_notnull(cxt->token_cxt, 1)->type == T_SEMICOLON) { // Case 1
+    token_consume_type(cxt->token_cxt, T_SEMICOLON);
+    token_t *entry = token_alloc_type(T_GLOBAL_DECL_ENTRY);
+    entry->offset = begin;
+    ast_append_child(root, ast_append_child(entry, basetype));
+    return entry;
+  }
+  token_t *decl = parse_decl(cxt, PARSE_DECL_NOBASETYPE);
+  token_t *la = token_lookahead_notnull(cxt->token_cxt, 1);
+  //printf("la type %s\n", token_typestr(la->type));
+  if(la->type == T_LCPAREN) { // Case 5
+    assert(ast_getchild(decl, 0) != NULL);
+    //ast_print(decl, 0);
+    //if(ast_getchild(decl, 0)->type != EXP_FUNC_CALL) // Only function type could have a body
+    //  error_row_col_exit(cxt->token_cxt->s, "Only function definition can have a body\n");
+    token_t *comp_stmt = cxt->lazy_body ? parse_skim_body(cxt) : parse_comp_stmt(cxt);
+    token_free(ast_remove(ast_getchild(decl, 0))); // Base type takes the place of the placeholder
+    ast_push_child(decl, basetype);
+    token_t *func = token_alloc_type(T_GLOBAL_FUNC);
+    func->offset = begin;
+    ast_append_child(root, ast_append_child(ast_append_child(func, decl), comp_stmt));
+    return func;
+  }
+  token_t *entry = ast_append_child(token_alloc_type(T_GLOBAL_DECL_ENTRY), basetype);
+  entry->offset = begin;
+  ast_append_child(root, entry);
   while(1) {
-    if(token_lookahead(cxt->token_cxt, 1) == NULL) {
-      break; // Reached EOF
+    // Check decl's name here; If it is typedef then add the name into the token cxt
+    if(DECL_ISTYPEDEF(basetype->decl_prop)) {
+      token_t *name = ast_gettype(decl, T_IDENT);
+      if(name == NULL) {
+        error_row_col_exit(cxt->token_cxt->s, "Expecting a name for typedef\n");
+      }
+      assert(name->type == T_IDENT);
+      token_add_utype(cxt->token_cxt, name);
     }
-    token_t *basetype = parse_decl_basetype(cxt);
-    if(token_lookahead_notnull(cxt->token_cxt, 1)->type == T_SEMICOLON) { // Case 1
-      token_consume_type(cxt->token_cxt, T_SEMICOLON);
-      ast_append_child(root, ast_append_child(token_alloc_type(T_GLOBAL_DECL_ENTRY), basetype));
-      continue;
+    token_t *var = ast_append_child(token_alloc_type(T_GLOBAL_DECL_VAR), decl);
+    ast_append_child(entry, var);
+    if(la->type == T_ASSIGN) { // case 3
+      token_consume_type(cxt->token_cxt, T_ASSIGN);
+      if(token_lookahead_notnull(cxt->token_cxt, 1)->type == T_LCPAREN) ast_append_child(var, parse_init_list(cxt));
+      else ast_append_child(var, parse_exp(cxt, PARSE_EXP_NOCOMMA));
+      la = token_lookahead_notnull(cxt->token_cxt, 1);
     }
-    token_t *decl = parse_decl(cxt, PARSE_DECL_NOBASETYPE);
-    token_t *la = token_lookahead_notnull(cxt->token_cxt, 1);
-    //printf("la type %s\n", token_typestr(la->type));
-    if(la->type == T_LCPAREN) { // Case 5
-      assert(ast_getchild(decl, 0) != NULL);
-      //ast_print(decl, 0);
-      //if(ast_getchild(decl, 0)->type != EXP_FUNC_CALL) // Only function type could have a body
-      //  error_row_col_exit(cxt->token_cxt->s, "Only function definition can have a body\n");
-      token_t *comp_stmt = parse_comp_stmt(cxt);
-      ast_push_child(decl, basetype);
-      ast_append_child(root, ast_append_child(ast_append_child(token_alloc_type(T_GLOBAL_FUNC), decl), comp_stmt));
+    if(la->type == T_SEMICOLON) { // case 4
+      token_consume_type(cxt->token_cxt, T_SEMICOLON); 
+      break; 
+    } else if(la->type == T_COMMA) { // case 2
+      token_consume_type(cxt->token_cxt, T_COMMA);
+      decl = parse_decl(cxt, PARSE_DECL_NOBASETYPE);
+      la = token_lookahead_notnull(cxt->token_cxt, 1);
       continue;
+    } else {
+      error_row_col_exit(la->offset, "Expecting \',\', \'=\' or \';\' for global declaration\n");
     }
-    token_t *entry = ast_append_child(token_alloc_type(T_GLOBAL_DECL_ENTRY), basetype);
-    ast_append_child(root, entry);
-    while(1) {
-      // Check decl's name here; If it is typedef then add the name into the token cxt
-      if(DECL_ISTYPEDEF(basetype->decl_prop)) {
-        token_t *name = ast_gettype(decl, T_IDENT);
-        if(name == NULL) {
-          error_row_col_exit(cxt->token_cxt->s, "Expecting a name for typedef\n");
+  }
+  return entry;
+}
+
+// Toggles global typedef names declared by a top-level item in the set. After toggling names of 
+// both the replaced and the reparsed items, the set is empty iff the typedef set does not change
+void parse_typedef_toggle(set_t *names, token_t *item) {
+  if(item->type != T_GLOBAL_DECL_ENTRY || !DECL_ISTYPEDEF(item->child->decl_prop)) return;
+  for(token_t *var = item->child->sibling;var != NULL;var = var->sibling) {
+    token_t *name = ast_gettype(var->child, T_IDENT);
+    assert(name != NULL);
+    if(set_find(names, name->str)) set_remove(names, name->str);
+    else set_insert(names, name->str);
+  }
+  return;
+}
+
+// Reparses a text after edits, reusing top-level items of the previous AST whose text is unchanged
+// The context must be initialized with the new text; The previous root is consumed. Items touched 
+// by an edit are reparsed, and parsing continues until the stream is aligned with the beginning of 
+// the next unchanged item. If the global typedef set changes, everything after is reparsed since 
+// the lexer may classify identifiers differently. Reused items are relocated to the new text
+token_t *parse_incremental(parse_cxt_t *cxt, token_t *prev, char *old_input, parse_edit_t *edits, int edit_count) {
+  assert(prev->type == T_ROOT);
+  char *new_input = cxt->token_cxt->begin;
+  int count = ast_child_count(prev), old_size = (int)strlen(old_input);
+  token_t **items = (token_t **)malloc(sizeof(token_t *) * (count + 1));
+  int *begins = (int *)malloc(sizeof(int) * (count + 1)); // Offset of the first token of each item
+  long *deltas = (long *)malloc(sizeof(long) * (count + 1));  // Displacement of unchanged items
+  char *affected = (char *)malloc(count + 1);
+  SYSEXPECT(items != NULL && begins != NULL && deltas != NULL && affected != NULL);
+  count = 0;
+  for(token_t *item = prev->child;item != NULL;item = item->sibling) {
+    items[count] = item;
+    begins[count++] = (int)(item->offset - old_input);
+  }
+  prev->child = NULL;
+  ast_free(prev);
+  // Items partition the old text, including whitespaces after them; An edit touching either end of
+  // the range affects the item, since it may merge tokens with the neighbor
+  for(int i = 0, e = 0;i < count;i++) {
+    int begin = i == 0 ? 0 : begins[i], end = i == count - 1 ? old_size : begins[i + 1];
+    deltas[i] = i == 0 ? 0 : deltas[i - 1];
+    while(e < edit_count && edits[e].end < begin) {
+      assert(edits[e].begin <= edits[e].end && (e == 0 || edits[e - 1].end <= edits[e].begin));
+      deltas[i] += edits[e].size - (edits[e].end - edits[e].begin);
+      e++;
+    }
+    affected[i] = e < edit_count && edits[e].begin <= end;
+  }
+  token_t *root = token_alloc_type(T_ROOT);
+  token_t *dropped = token_alloc_type(T_ROOT); // Freed at the end, since names are still in the set
+  set_t *names = set_str_init();
+  for(int i = 0;i < count;) {
+    if(!affected[i]) {
+      ast_relocate(items[i], old_input, new_input, deltas[i]);
+      if(items[i]->type == T_GLOBAL_DECL_ENTRY && DECL_ISTYPEDEF(items[i]->child->decl_prop)) {
+        for(token_t *var = items[i]->child->sibling;var != NULL;var = var->sibling) {
+          token_add_utype(cxt->token_cxt, ast_gettype(var->child, T_IDENT));
         }
-        assert(name->type == T_IDENT);
-        token_add_utype(cxt->token_cxt, name);
-      }
-      token_t *var = ast_append_child(token_alloc_type(T_GLOBAL_DECL_VAR), decl);
-      ast_append_child(entry, var);
-      if(la->type == T_ASSIGN) { // case 3
-        token_consume_type(cxt->token_cxt, T_ASSIGN);
-        if(token_lookahead_notnull(cxt->token_cxt, 1)->type == T_LCPAREN) ast_append_child(var, parse_init_list(cxt));
-        else ast_append_child(var, parse_exp(cxt, PARSE_EXP_NOCOMMA));
-        la = token_lookahead_notnull(cxt->token_cxt, 1);
       }
-      if(la->type == T_SEMICOLON) { // case 4
-        token_consume_type(cxt->token_cxt, T_SEMICOLON); 
-        break; 
-      } else if(la->type == T_COMMA) { // case 2
-        token_consume_type(cxt->token_cxt, T_COMMA);
-        decl = parse_decl(cxt, PARSE_DECL_NOBASETYPE);
-        la = token_lookahead_notnull(cxt->token_cxt, 1);
-        continue;
-      } else {
-        error_row_col_exit(la->offset, "Expecting \',\', \'=\' or \';\' for global declaration\n");
+      ast_append_child(root, items[i++]);
+      continue;
+    }
+    // The reparse starts from where the previous (unchanged) item ends in the new text
+    token_cxt_seek(cxt->token_cxt, i == 0 ? new_input : new_input + (begins[i] + deltas[i]));
+    while(1) {
+      token_t *la = token_lookahead(cxt->token_cxt, 1);
+      char *pos = la ? la->offset : new_input + strlen(new_input);
+      // Old items that begin before the current position are replaced, as well as changed ones
+      while(i < count && (affected[i] || new_input + (begins[i] + deltas[i]) < pos)) {
+        parse_typedef_toggle(names, items[i]);
+        ast_append_child(dropped, items[i++]);
       }
+      if(la == NULL) break;
+      if(i < count && new_input + (begins[i] + deltas[i]) == pos && set_size(names) == 0) break;
+      parse_typedef_toggle(names, parse_global_item(cxt, root));
     }
   }
+  // If the old text is empty then there is nothing to reuse
+  if(count == 0) {
+    while(token_lookahead(cxt->token_cxt, 1) != NULL) parse_global_item(cxt, root);
+  }
+  token_cxt_seek(cxt->token_cxt, new_input + strlen(new_input)); // Reused items are consumed
+  set_free(names);
+  ast_free(dropped);
+  free(items);
+  free(begins);
+  free(deltas);
+  free(affected);
+  return root;
+}
+
+// Skims over a function body by matching curly braces without building the AST
+// Returns a T_LAZY_BODY node; Its offset is the opening '{', and str points to the character after 
+// the matching '}'. Note that str is a pointer into the source text, which is not owned by the node
+token_t *parse_skim_body(parse_cxt_t *cxt) {
+  token_t *body = token_get_next(cxt->token_cxt);
+  assert(body != NULL && body->type == T_LCPAREN);
+  body->type = T_LAZY_BODY;
+  body->str = token_skip_block(cxt->token_cxt);
+  return body;
+}
+
+// Parses a T_LAZY_BODY node recorded by parse_skim_body() and returns the T_COMP_STMT
+// The current token stream is saved before the body is lexed, and restored after that
+// Typedef names visible to the body are those in the global scope that are declared before the body
+token_t *parse_lazy_body(parse_cxt_t *cxt, token_t *body) {
+  assert(body->type == T_LAZY_BODY);
+  token_cxt_t *token_cxt = cxt->token_cxt;
+  char *s = token_cxt->s;
+  token_t *pb_head = token_cxt->pb_head, *pb_tail = token_cxt->pb_tail;
+  int pb_count = token_cxt->pb_count;
+  token_cxt->s = body->offset;
+  token_cxt->pb_head = token_cxt->pb_tail = NULL;
+  token_cxt->pb_count = 0;
+  char *udef_limit = token_cxt->udef_limit;
+  token_cxt->udef_limit = body->offset;
+  token_t *comp_stmt = parse_comp_stmt(cxt);
+  token_cxt->udef_limit = udef_limit;
+  token_cxt_seek(token_cxt, s); // Drops lookahead tokens after the body
+  token_cxt->pb_head = pb_head;
+  token_cxt->pb_tail = pb_tail;
+  token_cxt->pb_count = pb_count;
+  return comp_stmt;
+}
+
+// Replaces the T_LAZY_BODY node of a function with the parsed body, and frees the lazy node
+void parse_replace_body(token_t *func, token_t *comp_stmt) {
+  token_t *body = func->child->sibling;
+  assert(body->type == T_LAZY_BODY);
+  func->child->sibling = comp_stmt;
+  comp_stmt->parent = func;
+  comp_stmt->sibling = body->sibling;
+  token_free(body);
+  return;
+}
+
+// Parses the body of a function definition that was skimmed in lazy mode, and replaces the 
+// T_LAZY_BODY node with the T_COMP_STMT. Returns the body, which may have already been parsed
+token_t *parse_func_body(parse_cxt_t *cxt, token_t *func) {
+  assert(func->type == T_GLOBAL_FUNC);
+  token_t *body = ast_getchild(func, 1);
+  assert(body != NULL);
+  if(body->type != T_LAZY_BODY) return body;
+  token_t *comp_stmt = parse_lazy_body(cxt, body);
+  parse_replace_body(func, comp_stmt);
+  return comp_stmt;
+}
+
+// Parses all function bodies that are skimmed in lazy mode, in source order
+void parse_expand_all(parse_cxt_t *cxt, token_t *root) {
+  assert(root->type == T_ROOT);
+  for(token_t *item = root->child;item != NULL;item = item->sibling) {
+    if(item->type == T_GLOBAL_FUNC) parse_func_body(cxt, item);
+  }
+  return;
+}
+
+// Thread function of parse_parallel(); Claims and parses bodies until none is left
+// After an error the context may hold partial nodes and scopes, so it is rebuilt for the next body, 
+// and tokens of the body are released with the token pool
+void *parse_worker(void *arg) {
+  parse_worker_t *worker = (parse_worker_t *)arg;
+  worker->pool = token_pool_init();
+  token_pool_bind(worker->pool);
+  int index;
+  while((index = __atomic_fetch_add(worker->next, 1, __ATOMIC_RELAXED)) < worker->count) {
+    error_bind(&worker->errors[index]);
+    if(setjmp(worker->errors[index].env) == ERROR_FIRSTTIME) {
+      worker->bodies[index] = parse_lazy_body(worker->cxt, ast_getchild(worker->funcs[index], 1));
+      token_pool_commit(worker->pool);
+    } else {
+      char *input = worker->cxt->token_cxt->begin;
+      parse_free(worker->cxt);
+      token_pool_bind(NULL);
+      token_pool_free(worker->pool);
+      worker->pool = token_pool_init();
+      token_pool_bind(worker->pool);
+      worker->cxt = parse_init(input);
+      worker->cxt->token_cxt->frozen_udef = worker->frozen_udef;
+    }
+  }
+  token_pool_bind(NULL);
+  token_pool_free(worker->pool);
+  error_bind(NULL);
+  return NULL;
+}
+
+// Parses the translation unit with function bodies parsed concurrently on num_threads threads
+// The global pass skims bodies, after which global typedef names are frozen with their declaration 
+// offsets and shared read-only by worker contexts, such that each body only sees typedefs declared 
+// before it. Bodies are stitched back into the root in source order, and diagnostics of bodies are 
+// reported in source order after all workers finish. An error in any body is rethrown to the caller
+token_t *parse_parallel(parse_cxt_t *cxt, int num_threads) {
+  assert(num_threads > 0 && num_threads <= PARSE_MAX_THREADS);
+  int lazy_body = cxt->lazy_body;
+  cxt->lazy_body = 1;
+  token_t *root = parse(cxt);
+  cxt->lazy_body = lazy_body;
+  int count = 0;
+  for(token_t *item = root->child;item != NULL;item = item->sibling) {
+    if(item->type == T_GLOBAL_FUNC && ast_getchild(item, 1)->type == T_LAZY_BODY) count++;
+  }
+  if(num_threads == 1 || count < 2) {
+    parse_expand_all(cxt, root);
+    return root;
+  }
+  if(num_threads > count) num_threads = count;
+  token_t **funcs = (token_t **)malloc(sizeof(token_t *) * count * 2);
+  error_cxt_t *errors = (error_cxt_t *)malloc(sizeof(error_cxt_t) * count);
+  SYSEXPECT(funcs != NULL && errors != NULL);
+  token_t **bodies = funcs + count;
+  error_cxt_t *error_cxt = error_get_cxt();
+  count = 0;
+  for(token_t *item = root->child;item != NULL;item = item->sibling) {
+    if(item->type != T_GLOBAL_FUNC || ast_getchild(item, 1)->type != T_LAZY_BODY) continue;
+    bodies[count] = NULL;
+    error_cxt_t *errors_func = &errors[count];
+    memset(errors_func, 0x00, sizeof(error_cxt_t));
+    errors_func->begin = error_cxt->begin;
+    errors_func->inited = error_cxt->inited;
+    errors_func->recover = 1;
+    errors_func->quiet = 1;
+    errors_func->max_errors = error_cxt->max_errors ? error_cxt->max_errors : 1; // Always buffered
+    funcs[count++] = item;
+  }
+  // Only the global scope is on the stack after parse(); Names are copied with the offsets of their
+  // declarators, which stay valid while the root is alive
+  assert(stack_size(cxt->token_cxt->udef_types) == 1);
+  hashtable_t *global_udef = (hashtable_t *)stack_peek(cxt->token_cxt->udef_types);
+  hashtable_t *frozen_udef = ht_str_init();
+  for(int i = 0;i < global_udef->capacity;i++) {
+    if(global_udef->keys[i] == NULL || global_udef->keys[i] == HT_REMOVED) continue;
+    ht_insert(frozen_udef, global_udef->keys[i], ((token_t *)global_udef->values[i])->offset);
+  }
+  parse_worker_t workers[PARSE_MAX_THREADS];
+  pthread_t threads[PARSE_MAX_THREADS];
+  int next = 0;
+  for(int i = 0;i < num_threads;i++) {
+    workers[i].cxt = parse_init(cxt->token_cxt->begin);
+    workers[i].cxt->token_cxt->frozen_udef = frozen_udef;
+    workers[i].frozen_udef = frozen_udef;
+    workers[i].funcs = funcs;
+    workers[i].bodies = bodies;
+    workers[i].errors = errors;
+    workers[i].count = count;
+    workers[i].next = &next;
+  }
+  for(int i = 0;i < num_threads;i++) {
+    SYSEXPECT(pthread_create(&threads[i], NULL, parse_worker, &workers[i]) == 0);
+  }
+  for(int i = 0;i < num_threads;i++) {
+    SYSEXPECT(pthread_join(threads[i], NULL) == 0);
+    parse_free(workers[i].cxt);
+  }
+  ht_free(frozen_udef);
+  // Bodies that failed keep their T_LAZY_BODY node, such that the root can still be freed
+  // Diagnostics after the first failed body are dropped, since parse() would have stopped there
+  int stop = 0;
+  for(int i = 0;i < count;i++) {
+    if(bodies[i] != NULL) parse_replace_body(funcs[i], bodies[i]);
+    if(stop) error_diag_free(&errors[i]);
+    else stop = error_diag_merge(&errors[i]) || bodies[i] == NULL;
+  }
+  free(funcs);
+  free(errors);
+  if(stop) error_exit_or_jump(ERROR_ACTION_EXIT);
   return root;
-}
\ No newline at end of file
+}
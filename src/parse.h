@@ -7,10 +7,43 @@
 #ifndef _PARSE_H
 #define _PARSE_H
 
+#define PARSE_MAX_THREADS 64 // Upper bound of worker threads in parse_parallel()
+
 typedef parse_exp_cxt_t parse_cxt_t;
 
+// Per-thread state of parse_parallel(). Workers claim function bodies by atomically incrementing
+// the shared index, and write results into the slot of the same index
+typedef struct {
+  parse_cxt_t *cxt;          // Private parser context with its own scope stack
+  token_pool_t *pool;        // Tokens of the body being parsed; Released if the body has an error
+  hashtable_t *frozen_udef;  // Global typedef names -> declaration offset; Restored when cxt is rebuilt
+  token_t **funcs;           // T_GLOBAL_FUNC nodes with lazy bodies, in source order
+  token_t **bodies;          // Parsed bodies, or NULL on error; Written by workers, stitched by the caller
+  error_cxt_t *errors;       // Diagnostics of each body; Merged by the caller in source order
+  int count;
+  int *next;                 // Shared index of the next unclaimed function
+} parse_worker_t;
+
+// A single edit of the text for incremental parsing; Byte range [begin, end) of the old text
+// is replaced by size bytes in the new text. Edits must be sorted and must not overlap
+typedef struct {
+  int begin;
+  int end;
+  int size;
+} parse_edit_t;
+
 parse_cxt_t *parse_init(char *input);
 void parse_free(parse_cxt_t *cxt);
 token_t *parse(parse_cxt_t *cxt);
+token_t *parse_global_item(parse_cxt_t *cxt, token_t *root);
+void parse_typedef_toggle(set_t *names, token_t *item);
+token_t *parse_incremental(parse_cxt_t *cxt, token_t *prev, char *old_input, parse_edit_t *edits, int edit_count);
+token_t *parse_skim_body(parse_cxt_t *cxt);
+token_t *parse_lazy_body(parse_cxt_t *cxt, token_t *body);
+void parse_replace_body(token_t *func, token_t *comp_stmt);
+token_t *parse_func_body(parse_cxt_t *cxt, token_t *func);
+void parse_expand_all(parse_cxt_t *cxt, token_t *root);
+void *parse_worker(void *arg);
+token_t *parse_parallel(parse_cxt_t *cxt, int num_threads);
 
 #endif
\ No newline at end of file
@@ -116,94 +116,132 @@ token_t *parse_decl_basetype(parse_decl_cxt_t *cxt) {
   return basetype;
 }
 
+// Whether a '(' in a declarator begins a parameter list rather than a parenthesized declarator
+int parse_decl_isfunc(parse_decl_cxt_t *cxt) {
+  token_t *la = token_lookahead(cxt->token_cxt, 2);
+  return la != NULL && (parse_decl_isbasetype(cxt, la) || la->type == T_RPAREN);
+}
+
+// Parses the parameter list of a function declarator after '(' into the EXP_FUNC_CALL node
+void parse_decl_param(parse_decl_cxt_t *cxt, token_t *func) {
+  if(token_consume_type(cxt->token_cxt, T_RPAREN)) {
+    ast_append_child(func, token_get_empty());
+    return;
+  }
+  while(1) {
+    ast_append_child(func, parse_decl(cxt, PARSE_DECL_HASBASETYPE));
+    if(token_consume_type(cxt->token_cxt, T_COMMA)) { // Special: check "..." after ","
+      if(token_lookahead_notnull(cxt->token_cxt, 1)->type == T_ELLIPSIS) { // after '...' there can only be ')'
+        ast_append_child(func, token_get_next(cxt->token_cxt));
+        if(!token_consume_type(cxt->token_cxt, T_RPAREN))
+          error_row_col_exit(cxt->token_cxt->s, "\"...\" could only be the last function argument\n");
+        return;
+      }
+    }
+    else if(token_consume_type(cxt->token_cxt, T_RPAREN)) { return; }
+    else error_row_col_exit(func->offset, "Function declaration expects \')\' or \',\' or \"...\"\n");
+  }
+}
+
+// Parses a declarator directly by its grammar, i.e. pointers, then an optional name or a parenthesized 
+// declarator, then array and function suffixes, without operator precedence. Pending '*' and '(' are 
+// kept on the operator stack and the derivation built so far on the AST stack, such that nothing is 
+// lost on error and nesting depth is not limited by the C stack
+// T_DECL has three children, base type, derivation and name, where derivation is an expression of 
+// EXP_DEREF, EXP_ARRAY_SUB and EXP_FUNC_CALL with an empty node as the innermost operand. Base type 
+// and name are empty nodes if absent
 token_t *parse_decl(parse_decl_cxt_t *cxt, int hasbasetype) {
   parse_exp_recurse(cxt);
   assert(parse_exp_size(cxt, OP_STACK) == 0 && parse_exp_size(cxt, AST_STACK) == 0); // Must start on a new stack
+  // Base type is parsed before anything is shifted, such that struct bodies start on a fresh level
+  token_t *basetype = hasbasetype == PARSE_DECL_HASBASETYPE ? parse_decl_basetype(cxt) : token_get_empty();
   token_t *decl = token_alloc_type(T_DECL);
-  // Append base type node if the flag indicates so, or empty node as placeholder
-  ast_append_child(decl, hasbasetype == PARSE_DECL_HASBASETYPE ? parse_decl_basetype(cxt) : token_get_empty()); 
-  token_t *placeholder = token_get_empty();
-  // Placeholder operand for the innremost operator because we do not push ident to AST stack
-  parse_exp_shift(cxt, AST_STACK, placeholder); 
-  token_t *decl_name = NULL;  // If not an abstract declarator this is the name
+  ast_append_child(decl, basetype); 
+  parse_exp_shift(cxt, AST_STACK, decl); // Such that it is released with the stacks on error
+  parse_exp_shift(cxt, AST_STACK, token_get_empty()); // Innermost operand
+  token_t *decl_name = NULL;
+  token_t *la = token_lookahead(cxt->token_cxt, 1);
+  // Prefix: '*' with qualifiers, and '(' of parenthesized declarators
+  while(la != NULL) {
+    if(la->type == T_STAR) {
+      token_t *token = token_get_next(cxt->token_cxt);
+      token->type = EXP_DEREF;
+      parse_exp_shift(cxt, OP_STACK, token);
+      while((la = token_lookahead(cxt->token_cxt, 1)) != NULL && (la->decl_prop & DECL_QUAL_MASK)) {
+        if(!token_decl_apply(token, la))
+          error_row_col_exit(la->offset, "Qualifier \"%s\" not compatible with \"%s\"\n",
+                             token_symstr(la->type), token_decl_print(token->decl_prop));
+        token_free(token_get_next(cxt->token_cxt));
+      }
+      continue;
+    } else if(la->type == T_LPAREN && !parse_decl_isfunc(cxt)) {
+      token_t *token = token_get_next(cxt->token_cxt);
+      token->type = EXP_LPAREN;
+      parse_exp_shift(cxt, OP_STACK, token);
+    } else if(la->decl_prop & DECL_QUAL_MASK) {
+      error_row_col_exit(la->offset, "Qualifier \"%s\" must follow pointer\n", token_symstr(la->type));
+    } else {
+      break;
+    }
+    la = token_lookahead(cxt->token_cxt, 1);
+  }
+  if(la != NULL && la->type == T_IDENT) decl_name = token_get_next(cxt->token_cxt);
   while(1) {
-    token_t *token = parse_decl_next_token(cxt);
-    if(token == NULL) {
-      ast_append_child(decl, parse_exp_reduce_all(cxt)); // This may directly put the placeholder node as a expression
-      ast_append_child(decl, decl_name ? decl_name : token_get_empty()); // Only appends the name if there is one, or empty node
-      parse_exp_decurse(cxt);
-      // Leaf operand always empty node as stop sign when traversing the type derivation chain
-      return decl;
+    // Suffix: Array and function declarators bind tighter than pointers of the same level
+    while((la = token_lookahead(cxt->token_cxt, 1)) != NULL) {
+      if(la->type == T_LSPAREN) {
+        token_t *token = token_get_next(cxt->token_cxt);
+        token->type = EXP_ARRAY_SUB;
+        parse_exp_shift(cxt, OP_STACK, token);
+        la = token_lookahead(cxt->token_cxt, 1);
+        token_t *index = (la != NULL && la->type == T_RSPAREN) ? token_get_empty() : parse_exp(cxt, PARSE_EXP_ALLOWALL);
+        ast_append_child(token, stack_pop(cxt->stacks[AST_STACK]));
+        ast_append_child(token, index);
+        stack_pop(cxt->stacks[OP_STACK]);
+        parse_exp_shift(cxt, AST_STACK, token);
+        if(!token_consume_type(cxt->token_cxt, T_RSPAREN)) 
+          error_row_col_exit(token->offset, "Array declaration expects \']\'\n");
+      } else if(la->type == T_LPAREN) {
+        token_t *token = token_get_next(cxt->token_cxt);
+        token->type = EXP_FUNC_CALL;
+        ast_append_child(token, stack_pop(cxt->stacks[AST_STACK]));
+        parse_exp_shift(cxt, AST_STACK, token);
+        parse_decl_param(cxt, token);
+      } else {
+        break;
+      }
     }
-    if(token->decl_prop & DECL_QUAL_MASK) { // Special case for type qualifiers
-      token_t *top = parse_exp_peek(cxt, OP_STACK);
-      if(top == NULL || top->type != EXP_DEREF || cxt->last_active_stack != OP_STACK) 
-        error_row_col_exit(token->offset, "Qualifier \"%s\" must follow pointer\n", token_symstr(token->type));
-      if(!token_decl_apply(top, token))
-        error_row_col_exit(token->offset, "Qualifier \"%s\" not compatible with \"%s\"\n",
-                           token_symstr(token->type), token_decl_print(top->decl_prop));
-      token_free(token);
-    } else {
-      switch(token->type) {
-        case EXP_DEREF: // To avoid int **a*; being legal, because identifiers are not pushed to AST stack
-          if(decl_name) error_row_col_exit(token->offset, "Pointers can only occur before declared name\n") 
-          parse_exp_shift(cxt, OP_STACK, token); break;
-        case T_IDENT:  // Trick: Do not push it onto the stack
-          if(decl_name) error_row_col_exit(token->offset, "Type declaration can have at most one identifier\n");
-          decl_name = token; break;
-          /* Is the above sufficient? - As long as parenthesis is not parsed recursively it is fine
-          token_t *ast_top = parse_exp_peek(cxt, AST_STACK);
-          if(ast_top != NULL && ast_top->type == T_) token_free(stack_pop(cxt->stacks[AST_STACK]));
-          else if(ast_top != NULL) error_row_col_exit(token->offset, "Type declaration can have at most one identifier\n");
-          parse_exp_shift(cxt, AST_STACK, token);
-          */
-        case EXP_ARRAY_SUB: {
-          parse_exp_shift(cxt, OP_STACK, token);
-          token_t *la = token_lookahead(cxt->token_cxt, 1);
-          token_t *index;
-          if(la != NULL && la->type == T_RSPAREN) { index = token_get_empty(); }
-          else { index = parse_exp(cxt, PARSE_EXP_ALLOWALL); }
-          parse_exp_shift(cxt, AST_STACK, index);
-          parse_exp_reduce(cxt, -1, 1); // This reduces array sub
-          if(!token_consume_type(cxt->token_cxt, T_RSPAREN)) 
-            error_row_col_exit(token->offset, "Array declaration expects \']\'\n");
-          break;
-        }
-        case EXP_FUNC_CALL: {
-          parse_exp_shift(cxt, OP_STACK, token);
-          token_t *la = token_lookahead(cxt->token_cxt, 1);
-          if(la != NULL && la->type == T_RPAREN) {
-            ast_push_child(token, token_get_empty());
-            token_consume_type(cxt->token_cxt, T_RPAREN);
-          } else {
-            while(1) {
-              ast_append_child(token, parse_decl(cxt, PARSE_DECL_HASBASETYPE));
-              if(token_consume_type(cxt->token_cxt, T_COMMA)) { // Special: check "..." after ","
-                if(token_lookahead_notnull(cxt->token_cxt, 1)->type == T_ELLIPSIS) { // after '...' there can only be ')'
-                  ast_append_child(token, token_get_next(cxt->token_cxt));
-                  if(!token_consume_type(cxt->token_cxt, T_RPAREN))
-                    error_row_col_exit(cxt->token_cxt->s, "\"...\" could only be the last function argument\n");
-                  break;
-                }
-              }
-              else if(token_consume_type(cxt->token_cxt, T_RPAREN)) { break; }
-              else error_row_col_exit(token->offset, "Function declaration expects \')\' or \',\' or \"...\"\n");
-            }
-          }
-          parse_exp_reduce(cxt, 1, 1); // This reduces EXP_FUNC_CALL
-          break;
-        }
-        case EXP_LPAREN: parse_exp_shift(cxt, OP_STACK, token); break;
-        case EXP_RPAREN: {
-          token_t *op_top = parse_exp_peek(cxt, OP_STACK);
-          while(op_top != NULL && op_top->type != EXP_LPAREN) op_top = parse_exp_reduce(cxt, -1, 0);
-          if(op_top == NULL) error_row_col_exit(token->offset, "Did not find matching \'(\' in declaration\n");
-          token_free(stack_pop(cxt->stacks[OP_STACK]));
-          token_free(token);
-          break;
-        } // Note that unrelated tokens are filtered
-        default: printf("%s %s\n", token_typestr(token->type), token->offset); assert(0);
-      } // switch(token->type)
-    } // if(token is qualifier)
-  } // while(1)
+    // Pointers of the current level apply to the result of suffixes
+    token_t *op_top = parse_exp_peek(cxt, OP_STACK);
+    while(op_top != NULL && op_top->type == EXP_DEREF) {
+      ast_append_child(op_top, stack_pop(cxt->stacks[AST_STACK]));
+      stack_pop(cxt->stacks[OP_STACK]);
+      parse_exp_shift(cxt, AST_STACK, op_top);
+      op_top = parse_exp_peek(cxt, OP_STACK);
+    }
+    if(op_top == NULL) break;
+    assert(op_top->type == EXP_LPAREN);
+    if(!token_consume_type(cxt->token_cxt, T_RPAREN)) 
+      error_row_col_exit(op_top->offset, "Did not find matching \')\' in declaration\n");
+    token_free(stack_pop(cxt->stacks[OP_STACK]));
+  }
+  // Tokens that could continue a declarator are errors; A name after the suffixes, as in "int (*)[4] a", 
+  // is rejected, since C only allows it in front of them
+  la = token_lookahead(cxt->token_cxt, 1);
+  if(la != NULL) {
+    if(la->type == T_STAR) {
+      error_row_col_exit(la->offset, "Pointers can only occur before declared name\n");
+    } else if(la->type == T_IDENT && decl_name == NULL) {
+      error_row_col_exit(la->offset, "Declared name must precede array and function suffixes\n");
+    } else if(la->type == T_IDENT) {
+      error_row_col_exit(la->offset, "Type declaration can have at most one identifier\n");
+    } else if(la->decl_prop & DECL_QUAL_MASK) {
+      error_row_col_exit(la->offset, "Qualifier \"%s\" must follow pointer\n", token_symstr(la->type));
+    }
+  }
+  ast_append_child(decl, stack_pop(cxt->stacks[AST_STACK]));
+  ast_append_child(decl, decl_name ? decl_name : token_get_empty());
+  stack_pop(cxt->stacks[AST_STACK]);
+  parse_exp_decurse(cxt);
+  return decl;
 }
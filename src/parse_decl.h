@@ -15,6 +15,8 @@ int parse_decl_isbasetype(parse_decl_cxt_t *cxt, token_t *token);
 token_t *parse_decl_next_token(parse_decl_cxt_t *cxt);
 void parse_typespec(parse_decl_cxt_t *cxt, token_t *basetype);
 token_t *parse_decl_basetype(parse_decl_cxt_t *cxt);
+int parse_decl_isfunc(parse_decl_cxt_t *cxt);
+void parse_decl_param(parse_decl_cxt_t *cxt, token_t *func);
 token_t *parse_decl(parse_decl_cxt_t *cxt, int hasbasetype);
 
 #endif
\ No newline at end of file
@@ -14,6 +14,8 @@ parse_exp_cxt_t *parse_exp_init(char *input) {
   // If the first token is an operator then it must be prefix operator
   cxt->last_active_stack = OP_STACK;
   cxt->token_cxt = token_cxt_init(input);
+  cxt->lazy_body = 0;
+  cxt->root = NULL;
   // Enable error reporting
   error_init(input);
   return cxt;
@@ -93,7 +95,7 @@ int parse_exp_la_isdecl(parse_exp_cxt_t *cxt) {
 
 // Virtual size of the stack, which is the difference between the previous top and the current top
 int parse_exp_size(parse_exp_cxt_t *cxt, int stack_id) {
-  return stack_topaddr(cxt->stacks[stack_id]) - (void **)stack_peek(cxt->tops[stack_id]);
+  return stack_size(cxt->stacks[stack_id]) - (int)(long)stack_peek(cxt->tops[stack_id]);
 }
 
 // Returns NULL if stack empty, or stack top
@@ -110,17 +112,17 @@ int parse_exp_isempty(parse_exp_cxt_t *cxt, int stack_id) {
   return parse_exp_size(cxt, stack_id) == 0;
 }
 
-// Creates a new level of virtual stack
+// Creates a new level of virtual stack; Tops are saved as sizes because stacks may move when they grow
 void parse_exp_recurse(parse_exp_cxt_t *cxt) {
-  stack_push(cxt->tops[0], stack_topaddr(cxt->stacks[0]));
-  stack_push(cxt->tops[1], stack_topaddr(cxt->stacks[1]));
+  stack_push(cxt->tops[0], (void *)(long)stack_size(cxt->stacks[0]));
+  stack_push(cxt->tops[1], (void *)(long)stack_size(cxt->stacks[1]));
   stack_push(cxt->prev_active, (void *)(long)cxt->last_active_stack);
   return;
 }
 
 void parse_exp_decurse(parse_exp_cxt_t *cxt) {
-  assert((void **)stack_peek(cxt->tops[0]) == stack_topaddr(cxt->stacks[0]));
-  assert((void **)stack_peek(cxt->tops[1]) == stack_topaddr(cxt->stacks[1]));
+  assert((int)(long)stack_peek(cxt->tops[0]) == stack_size(cxt->stacks[0]));
+  assert((int)(long)stack_peek(cxt->tops[1]) == stack_size(cxt->stacks[1]));
   stack_pop(cxt->tops[0]); stack_pop(cxt->tops[1]);
   cxt->last_active_stack = (int)(long)stack_pop(cxt->prev_active);
 }
@@ -235,7 +237,8 @@ void parse_exp_shift(parse_exp_cxt_t *cxt, int stack_id, token_t *token) {
 token_t *parse_exp_reduce(parse_exp_cxt_t *cxt, int op_num_override, int allow_paren) {
   stack_t *ast = cxt->stacks[AST_STACK], *op = cxt->stacks[OP_STACK];
   if(parse_exp_isempty(cxt, OP_STACK)) return NULL;
-  token_t *top_op = stack_pop(op);
+  // The operator stays on the stack until reduced, such that operands are still reachable on error
+  token_t *top_op = stack_peek(op);
   // Note that '[' and '(' are reduced manually, and this function could not reduce them
   // Otherwise ( and [ may not be balanced, e.g. (a[0) would be allowed
   if(!allow_paren && 
@@ -255,6 +258,7 @@ token_t *parse_exp_reduce(parse_exp_cxt_t *cxt, int op_num_override, int allow_p
       error_row_col_exit(operand->offset, "Operator \':\' must be used with operator \'?\'\n");
   }
 
+  stack_pop(op);
   parse_exp_shift(cxt, AST_STACK, top_op);
   return parse_exp_isempty(cxt, OP_STACK) ? NULL : stack_peek(op);
 }
@@ -19,9 +19,11 @@ typedef struct {
   // Either AST_STACK or OP_STACK; do not need save because a shift will happen
   int last_active_stack;
   stack_t *stacks[2];
-  stack_t *tops[2];
+  stack_t *tops[2];        // Sizes of stacks when the current level began
   stack_t *prev_active;
   token_cxt_t *token_cxt;
+  int lazy_body;             // Whether parse() skims function bodies instead of parsing them
+  token_t *root;             // Translation unit being built by parse(); Used to release a partial tree on error
 } parse_exp_cxt_t;
 
 parse_exp_cxt_t *parse_exp_init(char *input);
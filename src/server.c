@@ -0,0 +1,153 @@
+
+#include "server.h"
+
+// Compile server. Requests run one after another in the same process under their own error 
+// context in recover mode, such that an error abandons the request instead of the process. 
+// Tokens of a request are recorded by a token pool, such that nodes lost by the error path are 
+// still released. Caches that are expensive to build are kept in the server object across requests
+
+server_t *server_init() {
+  server_t *server = (server_t *)malloc(sizeof(server_t));
+  SYSEXPECT(server != NULL);
+  memset(server, 0x00, sizeof(server_t));
+  server->env = env_init();
+  env_init_include_path(server->env);
+  server->ast_cache = ht_str_init();
+  return server;
+}
+
+void server_free(server_t *server) {
+  hashtable_t *cache = server->ast_cache;
+  for(int i = 0;i < cache->capacity;i++) {
+    if(cache->keys[i] == NULL || cache->keys[i] == HT_REMOVED) continue;
+    server_cache_t *entry = (server_cache_t *)cache->values[i];
+    ast_serial_free(entry->ser);
+    free(entry->name);
+    free(entry);
+  }
+  ht_free(cache);
+  env_free(server->env);
+  free(server);
+  return;
+}
+
+// Releases all objects of the request. If the request failed, the partial tree is also released; 
+// Nodes that are not reachable from it, e.g. on parser stacks, are released with the token pool
+void server_request_free(server_request_t *req, int status) {
+  if(req->parse_cxt) {
+    if(status != SERVER_OK && req->root == NULL) req->root = req->parse_cxt->root;
+    parse_free(req->parse_cxt);
+  }
+  if(req->cgen_cxt) cgen_free(req->cgen_cxt);
+  if(req->root) ast_free(req->root);
+  memset(req, 0x00, sizeof(server_request_t));
+  return;
+}
+
+// Body of a request; Objects are recorded in the request as soon as they are created
+void server_compile_(server_t *server, server_request_t *req, const char *name, char *input) {
+  server_cache_t *entry = NULL;
+  if(name != NULL) {
+    entry = (server_cache_t *)ht_find(server->ast_cache, (void *)name);
+    if(entry == HT_NOTFOUND) entry = NULL;
+  }
+  if(entry != NULL && ast_serial_isvalid(entry->ser, input)) {
+    error_init(input);
+    req->root = ast_serial_unpack(entry->ser, input);
+    server->cache_hit_count++;
+  } else {
+    req->parse_cxt = parse_init(input);
+    req->root = parse(req->parse_cxt);
+    if(name != NULL) {
+      uint32_t size;
+      char *image = ast_serial_pack(req->root, input, &size);
+      ast_serial_t *ser = ast_serial_init(image, size, 0);
+      assert(ser != NULL);
+      if(entry == NULL) {
+        entry = (server_cache_t *)malloc(sizeof(server_cache_t));
+        SYSEXPECT(entry != NULL);
+        entry->name = (char *)malloc(strlen(name) + 1);
+        SYSEXPECT(entry->name != NULL);
+        strcpy(entry->name, name);
+        ht_insert(server->ast_cache, entry->name, entry);
+      } else {
+        ast_serial_free(entry->ser);
+      }
+      entry->ser = ser;
+    }
+  }
+  req->cgen_cxt = cgen_init();
+  cgen(req->cgen_cxt, req->root);
+  return;
+}
+
+// Compiles a translation unit; Name is the key of the AST cache, and NULL disables caching
+// Returns SERVER_OK or SERVER_ERROR. The server can take further requests in both cases
+int server_compile(server_t *server, const char *name, char *input, server_cb_t cb, void *arg) {
+  server_request_t req;
+  memset(&req, 0x00, sizeof(server_request_t));
+  error_cxt_t error_cxt;
+  memset(&error_cxt, 0x00, sizeof(error_cxt_t));
+  error_cxt.recover = 1;
+  error_cxt.max_errors = server->max_errors;
+  error_cxt_t *prev = error_bind(&error_cxt);
+  token_pool_t *pool = token_pool_init(); // Every token of the request is recorded
+  token_pool_t *prev_pool = token_pool_bind(pool);
+  int status = SERVER_OK;
+  server->request_count++;
+  // req lives in memory and is only modified through a pointer, so it is valid after longjmp
+  if(setjmp(error_cxt.env) == ERROR_FIRSTTIME) {
+    server_compile_(server, &req, name, input);
+    if(error_cxt.error_count != 0) status = SERVER_ERROR; // All errors were recovered from
+    else if(cb != NULL) cb(req.cgen_cxt, req.root, arg);
+  } else {
+    status = SERVER_ERROR;
+  }
+  if(status != SERVER_OK) server->error_count++;
+  server_request_free(&req, status);
+  token_pool_bind(prev_pool);
+  token_pool_free(pool);
+  error_diag_clear();
+  error_bind(prev);
+  return status;
+}
+
+// Returns the content of the file in a malloc'ed buffer, or NULL if it cannot be read
+char *server_read_file(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  if(fp == NULL) return NULL;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  char *buffer = (char *)malloc(size + 1);
+  SYSEXPECT(buffer != NULL);
+  if(size != 0 && fread(buffer, size, 1, fp) != 1) {
+    free(buffer);
+    fclose(fp);
+    return NULL;
+  }
+  buffer[size] = '\0';
+  fclose(fp);
+  return buffer;
+}
+
+// Serves requests until EOF. Each line of input is the path of a file to compile, and one line is 
+// written for each request: "OK <path>", "ERROR <path>" or "NOFILE <path>"
+void server_run(server_t *server, FILE *in, FILE *out) {
+  char line[SERVER_MAX_LINE];
+  while(fgets(line, sizeof(line), in) != NULL) {
+    size_t len = strlen(line);
+    while(len != 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+    if(len == 0) continue;
+    char *input = server_read_file(line);
+    if(input == NULL) {
+      fprintf(out, "NOFILE %s\n", line);
+    } else {
+      int status = server_compile(server, line, input, NULL, NULL);
+      fprintf(out, "%s %s\n", status == SERVER_OK ? "OK" : "ERROR", line);
+      free(input);
+    }
+    fflush(out);
+  }
+  return;
+}
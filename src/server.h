@@ -0,0 +1,48 @@
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include "env.h"
+#include "parse.h"
+#include "cgen.h"
+#include "ast_serial.h"
+
+#define SERVER_OK    0
+#define SERVER_ERROR 1
+
+#define SERVER_MAX_LINE 4096 // Maximum length of a request line in server_run()
+
+// Called after a request compiles successfully, before its contexts are released
+typedef void (*server_cb_t)(cgen_cxt_t *cgen_cxt, token_t *root, void *arg);
+
+// State that outlives requests. The AST cache is updated after a successful parse
+typedef struct {
+  env_t *env;                // Include paths are resolved once when the server starts
+  hashtable_t *ast_cache;    // Name -> server_cache_t *; Owns values
+  int request_count;
+  int error_count;
+  int cache_hit_count;
+  int max_errors;            // Errors collected per request before it is abandoned; 0 means fail-fast
+} server_t;
+
+typedef struct {
+  char *name;                // Owned; Also the key in the cache
+  ast_serial_t *ser;         // Serialized AST of the last successful parse; Owned
+} server_cache_t;
+
+// Everything allocated for a single request; Released whether or not the request succeeds
+typedef struct {
+  parse_cxt_t *parse_cxt;
+  cgen_cxt_t *cgen_cxt;
+  token_t *root;
+} server_request_t;
+
+server_t *server_init();
+void server_free(server_t *server);
+void server_request_free(server_request_t *req, int status);
+void server_compile_(server_t *server, server_request_t *req, const char *name, char *input);
+int server_compile(server_t *server, const char *name, char *input, server_cb_t cb, void *arg);
+char *server_read_file(const char *path);
+void server_run(server_t *server, FILE *in, FILE *out);
+
+#endif
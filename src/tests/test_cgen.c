@@ -122,14 +122,309 @@ void test_cgen_init() {
   ast_free(token);
   test_free(cxt);
   printf("=====================================\n");
+  // Test typedef'ed base types, including typedef of a typedef
+  cxt = test_init("typedef long T0; typedef T0 T1; T1 x = (T1)3; T0 y[] = {1, 2, 3}; \n");
+  token = parse(cxt->parse_cxt);
+  cgen(cxt->cgen_cxt, token);
+  value_t *x = (value_t *)scope_search(cxt->cgen_cxt->type_cxt, SCOPE_VALUE, "x");
+  value_t *y = (value_t *)scope_search(cxt->cgen_cxt->type_cxt, SCOPE_VALUE, "y");
+  assert(x->type->size == TYPE_LONG_SIZE && y->type->size == TYPE_LONG_SIZE * 3);
+  cgen_print_cxt(cxt->cgen_cxt);
+  ast_free(token);
+  test_free(cxt);
+  printf("=====================================\n");
 
   printf("Pass!\n");
 }
 
+// Nested initializer lists are processed with an explicit stack, so depth is only limited by memory
+void test_cgen_init_deep() {
+  printf("=== Test cgen_init_ deep ===\n");
+  const int depth = 1000;
+  str_t *s = str_init();
+  char buffer[128];
+  // struct s0 { int a; } v0; struct sk { struct sk-1 x; int b; } vk; 
+  str_concat(s, "struct s0 { int a; } v0; \n");
+  for(int i = 1;i < depth;i++) {
+    sprintf(buffer, "struct s%d { struct s%d x; int b; } v%d; \n", i, i - 1, i);
+    str_concat(s, buffer);
+  }
+  // Field b of level k is initialized to k, and the innermost a is 0
+  sprintf(buffer, "struct s%d var = ", depth - 1);
+  str_concat(s, buffer);
+  for(int i = 0;i < depth;i++) str_append(s, '{');
+  str_append(s, '0');
+  for(int i = 1;i < depth;i++) {
+    sprintf(buffer, "}, %d", i);
+    str_concat(s, buffer);
+  }
+  str_concat(s, "};\n");
+  test_cxt_t *cxt = test_init(str_cstr(s));
+  token_t *token = parse(cxt->parse_cxt);
+  cgen(cxt->cgen_cxt, token);
+  cgen_gdata_t *gdata = (cgen_gdata_t *)list_value(list_tail(cxt->cgen_cxt->gdata_list));
+  assert(gdata->type->size == (size_t)depth * 4);
+  for(int i = 0;i < depth;i++) assert(((int32_t *)gdata->data)[i] == i);
+  ast_free(token);
+  test_free(cxt);
+  str_free(s);
+  printf("Pass!\n");
+  return;
+}
+
+// Recoverable errors are collected, and declarations after them are still processed
+void test_cgen_multi_error() {
+  printf("=== Test cgen multiple errors ===\n");
+  char *input = 
+    "int a = b + 1; \n"           // Name does not exist, in constant evaluation
+    "char *p = 1; \n"             // Implicit cast from integer to pointer
+    "int arr[2] = {1, 2, 3}; \n"  // Initializer list too long
+    "int c = 5; int c = 6; \n"    // Duplicated definition
+    "register int r; \n"          // Storage class
+    "unsigned long s = sizeof(x.y) + sizeof(int [2]); \n" // Name does not exist, in type derivation
+    "int good = 7; \n";
+  test_cxt_t *cxt = test_init(input);
+  token_t *token = parse(cxt->parse_cxt);
+  error_collect(10);
+  cgen(cxt->cgen_cxt, token);
+  assert(error_get_cxt()->error_count == 6);
+  assert(error_diag_count() == 6);
+  for(int i = 0;i < error_diag_count();i++) {
+    error_diag_t *diag = error_diag_at(i);
+    printf("Row %d col %d: %s", diag->row, diag->col, diag->msg);
+    assert(diag->kind == ERROR_KIND_ERROR && diag->row == i + 1);
+  }
+  value_t *good = (value_t *)scope_search(cxt->type_cxt, SCOPE_VALUE, "good");
+  assert(good != NULL && good->pending == 0);
+  cgen_gdata_t *gdata = (cgen_gdata_t *)list_value(list_tail(cxt->cgen_cxt->gdata_list));
+  assert(*(int32_t *)gdata->data == 7);
+  error_diag_clear();
+  ast_free(token);
+  test_free(cxt);
+  // Stops at the limit
+  cxt = test_init(input);
+  token = parse(cxt->parse_cxt);
+  error_collect(2);
+  error_testmode(1);
+  int err = 0;
+  if(error_trycatch()) {
+    cgen(cxt->cgen_cxt, token);
+  } else {
+    err = 1;
+  }
+  assert(err == 1 && error_diag_count() == 2);
+  error_testmode(0);
+  error_collect(0);
+  error_diag_clear();
+  ast_free(token);
+  test_free(cxt);
+  printf("Pass!\n");
+  return;
+}
+
+// Bodies checked on several threads report the same diagnostics in source order as cgen(), including
+// those of the global pass, and do not see globals declared after them
+void test_cgen_parallel() {
+  printf("=== Test cgen_parallel ===\n");
+  char *input = 
+    "int g; struct s { int a; long b; } gs; \n"
+    "int f0(int a) { int b = a; { int c = b + g; return c; } } \n"
+    "int f1(int a) { return a + missing1; } \n"              // Name does not exist
+    "int *gp = 1; \n"                                       // Reported by the global pass
+    "int f2(struct s *p) { return p->a + f0(g); } \n"
+    "int f3(int a) { int d = a; { int d = 1; } return d + missing2; } \n"
+    "int f4(int a) { int e; int e; return a; } \n"           // Duplicated local
+    "int f5(int a) { return f4(a) + missing3; } \n"
+    "int f6(int a) { return f2(&gs) + a + later; } \n"       // Declared after the body
+    "int later; \n";
+  int rows[] = {3, 4, 6, 7, 8, 9};
+  for(int threads = 1;threads <= 8;threads *= 2) {
+    test_cxt_t *cxt = test_init(input);
+    token_t *token = parse(cxt->parse_cxt);
+    error_collect(10);
+    cgen_parallel(cxt->cgen_cxt, token, threads);
+    assert(error_get_cxt()->error_count == 6 && error_diag_count() == 6);
+    for(int i = 0;i < error_diag_count();i++) assert(error_diag_at(i)->row == rows[i]);
+    assert(list_size(cxt->cgen_cxt->export_list) == 11);
+    error_collect(0);
+    error_diag_clear();
+    ast_free(token);
+    test_free(cxt);
+  }
+  // Stops at the limit with the earliest errors
+  test_cxt_t *cxt = test_init(input);
+  token_t *token = parse(cxt->parse_cxt);
+  error_collect(2);
+  error_testmode(1);
+  int err = 0;
+  if(error_trycatch()) {
+    cgen_parallel(cxt->cgen_cxt, token, 4);
+  } else {
+    err = 1;
+  }
+  assert(err == 1 && error_diag_count() == 2);
+  assert(error_diag_at(0)->row == 3 && error_diag_at(1)->row == 4);
+  error_testmode(0);
+  error_collect(0);
+  error_diag_clear();
+  ast_free(token);
+  test_free(cxt);
+  printf("Pass!\n");
+  return;
+}
+
+// Counts nodes with a memoized type, and gives every expression node the poison type if it is not NULL
+int test_cgen_typed_nodes(token_t *token, type_t *poison) {
+  int count = token->exp_type != NULL;
+  if(poison != NULL && token->type >= EXP_BEGIN && token->type < EXP_END) token->exp_type = poison;
+  for(token_t *child = token->child;child != NULL;child = child->sibling) count += test_cgen_typed_nodes(child, poison);
+  return count;
+}
+
+// Types memoized by one context must not be used when the same tree is checked by another context,
+// and those of function bodies must not outlive the scopes they were derived in
+void test_cgen_recheck() {
+  printf("=== Test cgen on the same tree twice ===\n");
+  char input[] = "int g; int *f(void) { int *p; p = &g; return &g; } int h(int a) { { int b = a; a = b + g; } return a; }";
+  parse_exp_cxt_t *parse_cxt = parse_exp_init(input);
+  token_t *root = parse(parse_cxt);
+  type_t poison; // Stands for types released with the previous context
+  memset(&poison, 0xFF, sizeof(type_t));
+  for(int i = 0;i < 3;i++) {
+    assert(test_cgen_typed_nodes(root, &poison) == 0);
+    cgen_cxt_t *cgen_cxt = cgen_init();
+    if(i < 2) cgen(cgen_cxt, root);
+    else cgen_parallel(cgen_cxt, root, 2);
+    assert(list_size(cgen_cxt->export_list) == 3);
+    assert(test_cgen_typed_nodes(root, NULL) == 0); // Cleared with the scopes of bodies
+    cgen_free(cgen_cxt);
+  }
+  ast_free(root);
+  parse_exp_free(parse_cxt);
+  // Also for a body abandoned at an error, whose worker context is released after the join
+  char input2[] = "int f(void) { int x; x = 1; x = missing; return x; } int g(void) { return 1 + 2; }";
+  parse_cxt = parse_exp_init(input2);
+  root = parse(parse_cxt);
+  cgen_cxt_t *cgen_cxt = cgen_init();
+  error_testmode(1);
+  int err = 0;
+  if(error_trycatch()) cgen_parallel(cgen_cxt, root, 2);
+  else err = 1;
+  assert(err == 1);
+  error_testmode(0);
+  error_diag_clear();
+  assert(test_cgen_typed_nodes(root, NULL) == 0);
+  cgen_free(cgen_cxt);
+  ast_free(root);
+  parse_exp_free(parse_cxt);
+  printf("Pass!\n");
+  return;
+}
+
+// Every accounted object is released with its context, so all live counters return to zero
+void test_cgen_fold() {
+  printf("=== Test cgen fold ===\n");
+  char *input = 
+    "long long f(int a, char c) {\n"
+    "  int x = (2 + 3) * 4 - -1;\n"
+    "  x = a * 1 + 0;\n"                           // Identities
+    "  x = c + 0;\n"                               // Kept, since char is promoted
+    "  x = a / 0;\n"                               // Kept for run time
+    "  x = (int)sizeof(long) << 2;\n"
+    "  x = 1 ? a : 2;\n"
+    "  x = 0 && a;\n"
+    "  if(1 + 1 == 2) x = 1; else { x = 2; }\n"    // Then branch only
+    "  while(0) x++;\n"                            // Removed
+    "  if(0) { lbl: x = 3; }\n"                    // Kept, since it may be entered by goto
+    "  goto lbl;\n"
+    "  return (long long)-1 >> 1;\n"
+    "}\n";
+  test_cxt_t *cxt = test_init(input);
+  token_t *token = parse(cxt->parse_cxt);
+  cgen(cxt->cgen_cxt, token);
+  token_t *body = ast_getchild(ast_getchild(token, 0), 1);
+  token_t *init = ast_getchild(ast_getchild(ast_getchild(ast_getchild(ast_getchild(body, 0), 0), 1), 1), 0);
+  assert(init->type == T_DEC_INT_CONST && strcmp(init->str, "21") == 0);
+  token_t *stmts[12];
+  int count = 0;
+  for(token_t *stmt = ast_getchild(body, 1)->child;stmt != NULL;stmt = stmt->sibling) stmts[count++] = stmt;
+  assert(count == 11);
+  for(int i = 0;i < count;i++) ast_print(stmts[i]);
+  token_t *rhs[6];
+  for(int i = 0;i < 6;i++) rhs[i] = ast_getchild(ast_getchild(stmts[i], 0), 1); // Right hand side of assignments
+  assert(rhs[0]->type == T_IDENT && strcmp(rhs[0]->str, "a") == 0);
+  assert(rhs[1]->type == EXP_ADD && rhs[2]->type == EXP_DIV);
+  assert(rhs[3]->type == T_DEC_INT_CONST && strcmp(rhs[3]->str, "32") == 0);
+  assert(rhs[4]->type == T_IDENT && strcmp(rhs[4]->str, "a") == 0);
+  assert(rhs[5]->type == T_DEC_INT_CONST && strcmp(rhs[5]->str, "0") == 0);
+  assert(stmts[6]->type == T_EXP_STMT && strcmp(ast_getchild(ast_getchild(stmts[6], 0), 1)->str, "1") == 0);
+  assert(stmts[7]->type == T_);
+  assert(stmts[8]->type == T_IF && strcmp(ast_getchild(stmts[8], 0)->str, "0") == 0);
+  assert(stmts[10]->type == T_RETURN && strcmp(ast_getchild(stmts[10], 0)->str, "-1") == 0);
+  assert(ast_getchild(stmts[10], 0)->decl_prop == BASETYPE_LLONG);
+  ast_free(token);
+  test_free(cxt);
+  // Branches are checked before they are removed, such that errors in dead code are reported
+  char *dead[] = {
+    "int f(int x) { if(0) { return nosuch + 1; } return x; }",
+    "int f(int x) { if(1) x = 2; else { int y; int y; } return x; }",
+    "int f(int x) { while(0) { x = &x; } return x; }",
+    "int f(int x) { if(0) if(1) return x; else return &x; return x; }",
+  };
+  for(int i = 0;i < (int)(sizeof(dead) / sizeof(dead[0]));i++) {
+    cxt = test_init(dead[i]);
+    token = parse(cxt->parse_cxt);
+    error_collect(10);
+    cgen(cxt->cgen_cxt, token);
+    assert(error_get_cxt()->error_count == 1);
+    token_t *stmt = ast_getchild(ast_getchild(ast_getchild(token, 0), 1), 1)->child;
+    assert(stmt->type != T_IF && stmt->type != T_WHILE); // Still folded
+    error_collect(0);
+    error_diag_clear();
+    ast_free(token);
+    test_free(cxt);
+  }
+  printf("Pass!\n");
+  return;
+}
+
+void test_cgen_mem_stat() {
+  printf("=== Test memory accounting ===\n");
+  mem_stat_enable(1);
+  test_cxt_t *cxt = test_init(
+    "typedef struct s { int a; long b; } S; enum e { E0, E1 = 5 } w; \n"
+    "S x = {1, 2}; int y[] = {1, 2, 3}; extern int z; int f(int a); \n");
+  token_t *token = parse(cxt->parse_cxt);
+  cgen(cxt->cgen_cxt, token);
+  assert(mem_stats[MEM_GDATA].count == 2 && mem_stats[MEM_COMP].count == 1 && mem_stats[MEM_ENUM].count == 1);
+  assert(mem_stats[MEM_FIELD].count == 2 && mem_stats[MEM_VALUE].count >= 4);
+  assert(mem_stats[MEM_TOKEN].count >= ast_child_count(token) && mem_stats[MEM_TOKEN_STR].count > 0);
+  value_t *x = (value_t *)scope_search(cxt->cgen_cxt->type_cxt, SCOPE_VALUE, "x");
+  value_t *y = (value_t *)scope_search(cxt->cgen_cxt->type_cxt, SCOPE_VALUE, "y");
+  long gdata_bytes = 2 * (sizeof(cgen_gdata_t) + CGEN_GDATA_PADDING) + x->type->size + y->type->size;
+  assert(mem_stats[MEM_GDATA].bytes == gdata_bytes);
+  cgen_print_cxt(cxt->cgen_cxt);
+  ast_print_census(token, stdout);
+  ast_free(token);
+  test_free(cxt);
+  for(int i = 0;i < MEM_KIND_COUNT;i++) {
+    assert(mem_stats[i].count == 0 && mem_stats[i].bytes == 0);
+    assert(mem_stats[i].peak_count > 0 || i == MEM_BINTREE);
+  }
+  mem_stat_enable(0);
+  printf("Pass!\n");
+  return;
+}
 
 int main() {
   printf("Hello World!\n");
   test_cgen_global_decl();
   test_cgen_init();
+  test_cgen_init_deep();
+  test_cgen_multi_error();
+  test_cgen_parallel();
+  test_cgen_recheck();
+  test_cgen_fold();
+  test_cgen_mem_stat();
   return 0;
 }
\ No newline at end of file
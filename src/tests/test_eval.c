@@ -26,7 +26,7 @@ void test_const_eval_int() {
   token = token_get_next(parse_cxt->token_cxt);
   assert(token);
   value = eval_const_get_int_value(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
   printf("=====================================\n");
@@ -35,7 +35,7 @@ void test_const_eval_int() {
   token = token_get_next(parse_cxt->token_cxt);
   assert(token);
   value = eval_const_get_int_value(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
   printf("=====================================\n");
@@ -44,7 +44,7 @@ void test_const_eval_int() {
   token = token_get_next(parse_cxt->token_cxt);
   assert(token);
   value = eval_const_get_int_value(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
   printf("=====================================\n");
@@ -53,7 +53,7 @@ void test_const_eval_int() {
   token = token_get_next(parse_cxt->token_cxt);
   assert(token);
   value = eval_const_get_int_value(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
   printf("=====================================\n");
@@ -62,7 +62,7 @@ void test_const_eval_int() {
   token = token_get_next(parse_cxt->token_cxt);
   assert(token);
   value = eval_const_get_int_value(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
   printf("=====================================\n");
@@ -71,7 +71,7 @@ void test_const_eval_int() {
   token = token_get_next(parse_cxt->token_cxt);
   assert(token);
   value = eval_const_get_int_value(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
   printf("=====================================\n");
@@ -93,7 +93,7 @@ void test_eval_const_exp() {
   token = parse_exp(parse_cxt, PARSE_EXP_ALLOWALL);
   ast_print_(token, 0);
   value = eval_const_exp(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   assert(value->int32 == 16096);
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
@@ -103,7 +103,7 @@ void test_eval_const_exp() {
   token = parse_exp(parse_cxt, PARSE_EXP_ALLOWALL);
   ast_print_(token, 0);
   value = eval_const_exp(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   assert(value->int64 == -288); // Because of the sign extension of char type
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
@@ -113,7 +113,7 @@ void test_eval_const_exp() {
   token = parse_exp(parse_cxt, PARSE_EXP_ALLOWALL);
   ast_print_(token, 0);
   value = eval_const_exp(type_cxt, token);
-  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(0, value->type, NULL, 0), value->uint64, value->int64);
+  printf("Type: %s Value: 0x%016lX (%ld)\n", type_print_str(type_cxt, 0, value->type, NULL, 0), value->uint64, value->int64);
   assert(value->int64 == 102); // Because of the sign extension of char type
   parse_exp_free(parse_cxt);
   type_sys_free(type_cxt);
@@ -123,8 +123,145 @@ void test_eval_const_exp() {
   return;
 }
 
+// Expressions generated by tools may be nested deeper than the C stack could handle recursively
+void test_eval_const_exp_deep() {
+  printf("=== Test eval_const_exp deep ===\n");
+  const int count = 200000;
+  char *s = (char *)malloc(count * 4 + 16);
+  parse_exp_cxt_t *parse_cxt;
+  type_cxt_t *type_cxt;
+  token_t *token;
+  type_t *type;
+  value_t *value;
+  // Left-deep: 1 + 1 + ... + 1
+  char *p = s;
+  for(int i = 0;i < count;i++) p += sprintf(p, i ? "+1" : "1");
+  type_cxt = type_sys_init();
+  parse_cxt = parse_exp_init(s); 
+  token = parse_exp(parse_cxt, PARSE_EXP_ALLOWALL);
+  type = type_typeof(type_cxt, token, 0);
+  assert(type_is_int(type) && type->size == 4);
+  value = eval_const_exp(type_cxt, token);
+  printf("Left-deep: %d\n", value->int32);
+  assert(value->int32 == count);
+  ast_free(token);
+  parse_exp_free(parse_cxt);
+  type_sys_free(type_cxt);
+  // Right-deep with mixed operators: 2 - (1 + (2 - (1 + ...)))
+  p = s;
+  for(int i = 0;i < count;i++) p += sprintf(p, i % 2 ? "1+(" : "2-(");
+  p += sprintf(p, "0");
+  for(int i = 0;i < count;i++) p += sprintf(p, ")");
+  type_cxt = type_sys_init();
+  parse_cxt = parse_exp_init(s); 
+  token = parse_exp(parse_cxt, PARSE_EXP_ALLOWALL);
+  type = type_typeof(type_cxt, token, 0);
+  assert(type_is_int(type));
+  value = eval_const_exp(type_cxt, token);
+  printf("Right-deep: %d\n", value->int32);
+  assert(value->int32 == 0); // Each 2 - (1 + (x)) is 1 - x, and there are an even number of them
+  ast_free(token);
+  parse_exp_free(parse_cxt);
+  type_sys_free(type_cxt);
+  free(s);
+  printf("Pass!\n");
+  return;
+}
+
+// Types are memoized on expression nodes, but only when derived with all checks
+// long long is 16 bytes; Its constants are evaluated natively on 128-bit integers
+void test_eval_const_exp_128() {
+  printf("=== Test eval_const_exp 128-bit ===\n");
+  char *tests[] = {
+    "(1ull << 100) >> 98",
+    "18446744073709551615ull + 1",
+    "(4294967296ll * 4294967296ll * 4294967296ll) / -18446744073709551616ll",
+    "-1ll < 0ll",
+    "(unsigned long long)-1ll > 0ull",
+    "(-170141183460469231731687303715884105727ll - 1) >> 127",
+    "(long long)(unsigned)-1 % 1000",
+    "-1 < 0u",
+    "(int)(340282366920938463463374607431768211455ull >> 64)",
+  };
+  __uint128_t expected[] = {4, (__uint128_t)1 << 64, -((__uint128_t)1 << 32), 1, 1, ~(__uint128_t)0, 4294967295 % 1000, 0, 0xFFFFFFFF};
+  for(int i = 0;i < (int)(sizeof(tests) / sizeof(tests[0]));i++) {
+    type_cxt_t *type_cxt = type_sys_init();
+    parse_exp_cxt_t *parse_cxt = parse_exp_init(tests[i]);
+    token_t *token = parse_exp(parse_cxt, PARSE_EXP_ALLOWALL);
+    value_t *value = eval_const_exp(type_cxt, token);
+    printf("%s = 0x%016lX%016lX (%s)\n", tests[i], (uint64_t)(value->uint128 >> 64), (uint64_t)value->uint128, 
+      type_print_str(type_cxt, 0, value->type, NULL, 0));
+    assert((value->uint128 & eval_const_get_mask((int)value->type->size)) == expected[i]);
+    ast_free(token);
+    parse_exp_free(parse_cxt);
+    type_sys_free(type_cxt);
+  }
+  // Overflow is detected at 16 bytes by the builtins, and within smaller sizes by range checks
+  value_t op1, op2;
+  int overflow;
+  op1.uint128 = ~(__uint128_t)0 >> 1; // Maximum of signed 128-bit
+  op2.uint128 = 1;
+  eval_const_add(&op1, &op2, 16, 1, &overflow); assert(overflow == 1);
+  eval_const_add(&op1, &op2, 16, 0, &overflow); assert(overflow == 0);
+  eval_const_mul(&op1, &op1, 16, 0, &overflow); assert(overflow == 1);
+  op1.uint128 = 0x7F;
+  eval_const_add(&op1, &op2, 1, 1, &overflow); assert(overflow == 1);
+  eval_const_add(&op1, &op2, 1, 0, &overflow); assert(overflow == 0);
+  op1.uint128 = 0;
+  eval_const_sub(&op1, &op2, 4, 0, &overflow); assert(overflow == 1);
+  assert(eval_const_sub(&op1, &op2, 4, 1, &overflow) == 0xFFFFFFFF && overflow == 0);
+  printf("Pass!\n");
+  return;
+}
+
+// Temporaries of an evaluation are released by the next one, such that memory stays constant
+void test_eval_const_exp_temp() {
+  printf("=== Test eval_const_exp temporaries ===\n");
+  type_cxt_t *type_cxt = type_sys_init();
+  parse_exp_cxt_t *parse_cxt = parse_exp_init("((long)sizeof(int (*)[2 + 3]) + (char)1000) * 3 - 1");
+  token_t *token = parse_exp(parse_cxt, PARSE_EXP_ALLOWALL);
+  value_t *value = eval_const_exp(type_cxt, token);
+  assert(value->int64 == -49); // (8 + (-24)) * 3 - 1, where the array size is evaluated in a nested evaluation
+  assert(type_cxt->eval_depth == 0);
+  arena_chunk_t *chunk = type_cxt->eval_arena.last;
+  for(int i = 0;i < 10000;i++) {
+    value = eval_const_exp(type_cxt, token);
+    assert(value->int64 == -49);
+  }
+  assert(type_cxt->eval_arena.first == chunk && type_cxt->eval_arena.last == chunk);
+  ast_free(token);
+  parse_exp_free(parse_cxt);
+  type_sys_free(type_cxt);
+  printf("Pass!\n");
+  return;
+}
+
+void test_type_annotate() {
+  printf("=== Test type_annotate ===\n");
+  type_cxt_t *type_cxt = type_sys_init();
+  parse_exp_cxt_t *parse_cxt = parse_exp_init("(long)1 + 2 * sizeof(int) - 'a'");
+  token_t *token = parse_exp(parse_cxt, PARSE_EXP_ALLOWALL);
+  type_t *type = type_typeof(type_cxt, token, TYPEOF_IGNORE_FUNC_ARG);
+  assert(token->exp_type == NULL);
+  assert(type_annotate(type_cxt, token) == 1 && token->exp_type != NULL);
+  token_t *cast = ast_getchild(ast_getchild(token, 0), 0);
+  assert(cast->type == EXP_CAST && cast->exp_type != NULL && cast->exp_type->size == TYPE_LONG_SIZE);
+  type = cast->exp_type;
+  assert(type_typeof(type_cxt, token, 0) == token->exp_type && cast->exp_type == type); // Not derived again
+  assert(type_is_int(token->exp_type) && token->exp_type->size == TYPE_LONG_SIZE);
+  ast_free(token);
+  parse_exp_free(parse_cxt);
+  type_sys_free(type_cxt);
+  printf("Pass!\n");
+  return;
+}
+
 int main() {
   test_const_eval_int();
   test_eval_const_exp();
+  test_eval_const_exp_deep();
+  test_eval_const_exp_128();
+  test_eval_const_exp_temp();
+  test_type_annotate();
   return 0;
 }
\ No newline at end of file
@@ -1,12 +1,15 @@
 
 #include <stdio.h>
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
 #include "stack.h"
 #include "token.h"
 #include "error.h"
 #include "ast.h"
 #include "parse.h"
 #include "hashtable.h"
+#include "ast_serial.h"
 
 void test_stack() {
   printf("=== Test Stack ===\n");
@@ -688,9 +691,278 @@ void test_udef() {
   parse_exp_free(cxt);
   ast_free(token);
   printf("=====================================\n");
+  // B is a cast only inside the inner block; Outer blocks have no typedef table
+  char test3[] = "int B; int f() { { { typedef long B; B y = (B)*&y; } } return (B)*2; }"; 
+  cxt = parse_exp_init(test3);
+  token = parse(cxt);
+  assert(token_get_next(cxt->token_cxt) == NULL);
+  assert(stack_size(cxt->token_cxt->udef_types) == 1);
+  puts(test3);
+  ast_print_(token, 0);
+  parse_exp_free(cxt);
+  ast_free(token);
+  printf("=====================================\n");
   printf("Pass!\n");
 }
 
+// Returns 1 if two ASTs have the same shape, types, properties and literals
+int test_ast_same(token_t *a, token_t *b) {
+  if(a == NULL || b == NULL) return a == b;
+  if(a->type != b->type || a->decl_prop != b->decl_prop) return 0;
+  if(a->type >= T_LITERALS_BEGIN && a->type < T_LITERALS_END && strcmp(a->str, b->str) != 0) return 0;
+  for(a = a->child, b = b->child;a != NULL && b != NULL;a = a->sibling, b = b->sibling) {
+    if(!test_ast_same(a, b)) return 0;
+  }
+  return a == b;
+}
+
+void test_lazy_body() {
+  printf("=== Test lazy body ===\n");
+  parse_exp_cxt_t *cxt;
+  token_t *eager, *lazy;
+  char test1[] = "typedef int A; int f(A a) { A b = '}'; /* } */ { A c; } return \"{\" [0]; } "
+                 "int g() { // }\n return 1; } long x = 2;";
+  cxt = parse_exp_init(test1);
+  eager = parse(cxt);
+  assert(token_get_next(cxt->token_cxt) == NULL);
+  parse_exp_free(cxt);
+  cxt = parse_exp_init(test1);
+  cxt->lazy_body = 1;
+  lazy = parse(cxt);
+  assert(token_get_next(cxt->token_cxt) == NULL);
+  assert(ast_getchild(ast_getchild(lazy, 1), 1)->type == T_LAZY_BODY);
+  assert(ast_getchild(ast_getchild(lazy, 2), 1)->type == T_LAZY_BODY);
+  ast_print_(lazy, 0);
+  assert(!test_ast_same(eager, lazy));
+  // Parse one body first, and then the rest
+  token_t *body = parse_func_body(cxt, ast_getchild(lazy, 2));
+  assert(body->type == T_COMP_STMT && ast_getchild(ast_getchild(lazy, 2), 1) == body);
+  assert(parse_func_body(cxt, ast_getchild(lazy, 2)) == body);
+  parse_expand_all(cxt, lazy);
+  assert(test_ast_same(eager, lazy));
+  parse_exp_free(cxt);
+  ast_free(eager);
+  ast_free(lazy);
+  printf("Pass!\n");
+  return;
+}
+
+void test_parse_parallel() {
+  printf("=== Test parse_parallel ===\n");
+  parse_exp_cxt_t *cxt;
+  token_t *serial, *parallel;
+  // Generate functions that use global typedefs as well as local ones
+  int count = 500;
+  char *s = (char *)malloc(count * 128 + 64);
+  SYSEXPECT(s != NULL);
+  char *p = s + sprintf(s, "typedef int A; ");
+  for(int i = 0;i < count;i++) {
+    p += sprintf(p, "A f%d(A x) { typedef long B%d; B%d y = x * %d; if(y) { A z; return z; } return y; } ", i, i, i, i);
+    if(i % 100 == 0) p += sprintf(p, "typedef char C%d; C%d g%d;", i, i, i);
+  }
+  cxt = parse_exp_init(s);
+  serial = parse(cxt);
+  parse_exp_free(cxt);
+  for(int threads = 1;threads <= 8;threads *= 2) {
+    cxt = parse_exp_init(s);
+    parallel = parse_parallel(cxt, threads);
+    assert(token_get_next(cxt->token_cxt) == NULL);
+    assert(test_ast_same(serial, parallel));
+    printf("Threads %d: %d top-level items\n", threads, ast_child_count(parallel));
+    parse_exp_free(cxt);
+    ast_free(parallel);
+  }
+  ast_free(serial);
+  free(s);
+  // A typedef declared after a body is not visible to it, whether or not bodies are parsed in order
+  char s2[] = "int f(void) { int T = 3; return T * 2; } int g(void) { return 1; } typedef int T; T h(void) { return (T)1; }";
+  cxt = parse_exp_init(s2);
+  serial = parse(cxt);
+  parse_exp_free(cxt);
+  cxt = parse_exp_init(s2);
+  cxt->lazy_body = 1;
+  parallel = parse(cxt);
+  parse_expand_all(cxt, parallel);
+  assert(test_ast_same(serial, parallel));
+  parse_exp_free(cxt);
+  ast_free(parallel);
+  cxt = parse_exp_init(s2);
+  parallel = parse_parallel(cxt, 2);
+  assert(test_ast_same(serial, parallel));
+  parse_exp_free(cxt);
+  ast_free(parallel);
+  ast_free(serial);
+  // A syntax error in a body is rethrown to the caller in recover mode, after other bodies finish
+  char s3[] = "int f(void) { return 1; } int g(void) { return (1 + ; } int h(void) { return 2; }";
+  error_cxt_t error_cxt;
+  memset(&error_cxt, 0x00, sizeof(error_cxt_t));
+  error_cxt.recover = 1;
+  error_cxt_t *prev = error_bind(&error_cxt);
+  cxt = parse_exp_init(s3);
+  int caught = 0;
+  if(setjmp(error_cxt.env) == ERROR_FIRSTTIME) {
+    parse_parallel(cxt, 2);
+  } else {
+    caught = 1;
+  }
+  assert(caught == 1 && error_cxt.error_count == 1);
+  ast_free(cxt->root);
+  parse_exp_free(cxt);
+  error_bind(prev);
+  printf("Pass!\n");
+  return;
+}
+
+// Same as test_ast_same(), and also checks that source offsets are the same relative to the text
+int test_ast_same_offset(token_t *a, char *base_a, token_t *b, char *base_b) {
+  if(!test_ast_same(a, b)) return 0;
+  if((a->offset ? a->offset - base_a : -1) != (b->offset ? b->offset - base_b : -1)) return 0;
+  for(a = a->child, b = b->child;a != NULL;a = a->sibling, b = b->sibling) {
+    if(!test_ast_same_offset(a, base_a, b, base_b)) return 0;
+  }
+  return 1;
+}
+
+// Applies a single edit to the old text, and checks incremental parsing against a full parse
+// Returns the number of top-level items reused from the previous tree
+int test_incremental_one(const char *old_text, int begin, int end, const char *repl, int lazy) {
+  char *old_input = strdup(old_text);
+  char *new_input = (char *)malloc(strlen(old_text) + strlen(repl) + 1);
+  sprintf(new_input, "%.*s%s%s", begin, old_text, repl, old_text + end);
+  parse_edit_t edit = {begin, end, (int)strlen(repl)};
+  parse_exp_cxt_t *cxt = parse_exp_init(old_input);
+  cxt->lazy_body = lazy;
+  token_t *prev = parse(cxt);
+  parse_exp_free(cxt);
+  token_t *prev_items[64];
+  int prev_count = 0;
+  for(token_t *item = prev->child;item != NULL;item = item->sibling) prev_items[prev_count++] = item;
+  cxt = parse_exp_init(new_input);
+  token_t *full = parse(cxt);
+  parse_exp_free(cxt);
+  cxt = parse_exp_init(new_input);
+  cxt->lazy_body = lazy;
+  token_t *incr = parse_incremental(cxt, prev, old_input, &edit, 1);
+  if(lazy) parse_expand_all(cxt, incr);
+  assert(token_get_next(cxt->token_cxt) == NULL);
+  parse_exp_free(cxt);
+  assert(test_ast_same_offset(full, new_input, incr, new_input));
+  int reused = 0;
+  for(token_t *item = incr->child;item != NULL;item = item->sibling) {
+    for(int i = 0;i < prev_count;i++) if(prev_items[i] == item) reused++;
+  }
+  printf("\"%s\" -> \"%s\": reused %d of %d\n", old_text, new_input, reused, ast_child_count(incr));
+  ast_free(full);
+  ast_free(incr);
+  free(old_input);
+  free(new_input);
+  return reused;
+}
+
+void test_parse_incremental() {
+  printf("=== Test parse_incremental ===\n");
+  char test1[] = "int a; int f() { return 1; } long b; int g(int x) { return x; } char c;";
+  assert(test_incremental_one(test1, 24, 25, "123", 0) == 4);          // Inside the body of f
+  assert(test_incremental_one(test1, 24, 25, "123", 1) == 4);          // Same with lazy bodies
+  assert(test_incremental_one(test1, 7, 7, "short d = 2; ", 0) == 3);  // New item between two
+  assert(test_incremental_one(test1, 0, 6, "", 0) == 4);               // Removing the first item
+  assert(test_incremental_one(test1, 71, 71, " int e;", 1) == 4);      // Appending at the end
+  assert(test_incremental_one(test1, 29, 33, "unsigned", 0) == 3);     // Changing a type 
+  assert(test_incremental_one(test1, 0, 0, "", 0) == 4);               // Empty edit at the beginning
+  char test2[] = "typedef int A; int f() { A * y; } long b; int g() { A * y; } char c;";
+  assert(test_incremental_one(test2, 0, 8, "", 0) == 0);               // Typedef removed; Widened to EOF
+  assert(test_incremental_one(test2, 8, 11, "long", 0) == 4);          // Typedef kept but changed
+  assert(test_incremental_one(test2, 12, 13, "B", 1) == 0);            // Typedef renamed
+  printf("Pass!\n");
+  return;
+}
+
+void test_ast_serial() {
+  printf("=== Test ast_serial ===\n");
+  parse_exp_cxt_t *cxt;
+  token_t *root, *unpacked;
+  char test1[] = "typedef struct {int bb;} aa, *cc; int main() { return 0; } int a = 0, c, b = {1,2,3,{4},{}}; "
+                 "char *s = \"abc\", *t = \"abc\"; long f(int x) { return x + 'a'; }";
+  cxt = parse_exp_init(test1);
+  cxt->lazy_body = 1;
+  root = parse(cxt);
+  parse_func_body(cxt, ast_getchild(root, 1)); // The other body is kept lazy
+  ast_serial_write("ast_serial_test.bin", root, test1);
+  ast_serial_t *ser = ast_serial_open("ast_serial_test.bin");
+  assert(ser != NULL);
+  assert(ast_serial_isvalid(ser, test1));
+  test1[0] = 'T';
+  assert(!ast_serial_isvalid(ser, test1));
+  test1[0] = 't';
+  // Navigate the mapped nodes directly
+  ast_serial_node_t *node = ast_serial_root(ser);
+  int count = 0;
+  assert(node->type == T_ROOT);
+  for(node = ast_serial_child(node);node != NULL;node = ast_serial_sibling(node)) count++;
+  assert(count == ast_child_count(root));
+  node = ast_serial_child(ast_serial_root(ser));
+  assert(node->type == T_GLOBAL_DECL_ENTRY && ast_serial_loc(ser, node) == 0);
+  printf("Nodes %u strings %u bytes file %u bytes\n", ser->header->node_count, ser->header->str_size, ser->header->size);
+  unpacked = ast_serial_unpack(ser, test1);
+  assert(test_ast_same_offset(root, test1, unpacked, test1));
+  assert(ast_getchild(ast_getchild(unpacked, 4), 1)->type == T_LAZY_BODY);
+  parse_expand_all(cxt, root);
+  parse_expand_all(cxt, unpacked);
+  assert(test_ast_same_offset(root, test1, unpacked, test1));
+  ast_serial_free(ser);
+  remove("ast_serial_test.bin");
+  assert(ast_serial_open("ast_serial_test.bin") == NULL);
+  // Corrupted or truncated images are rejected before any node is used
+  uint32_t size;
+  char *image = ast_serial_pack(root, test1, &size);
+  ast_serial_header_t *header = (ast_serial_header_t *)image;
+  ast_serial_node_t *nodes = (ast_serial_node_t *)(image + header->node_offset);
+  ast_serial_node_t saved = nodes[1], saved_child = nodes[2];
+  assert(ast_serial_check(image, size));
+  assert(!ast_serial_check(image, size - 1));
+  nodes[2].child = 100000;
+  assert(!ast_serial_check(image, size));
+  nodes[2].child = -2;                  // Cycle
+  assert(!ast_serial_check(image, size));
+  nodes[2] = saved_child;
+  nodes[1].sibling = 1;                 // Two links to the same node
+  assert(!ast_serial_check(image, size));
+  nodes[1] = saved;
+  for(uint32_t i = 0;i < header->node_count;i++) {
+    if(nodes[i].type < T_LITERALS_BEGIN || nodes[i].type >= T_LITERALS_END) continue;
+    uint32_t str = nodes[i].str;
+    nodes[i].str = 0x7FFFFF;
+    assert(!ast_serial_check(image, size));
+    nodes[i].str = str;
+    break;
+  }
+  image[header->str_offset + header->str_size - 1] = 'x';
+  assert(!ast_serial_check(image, size));
+  image[header->str_offset + header->str_size - 1] = '\0';
+  uint32_t loc_offset = header->loc_offset;
+  header->loc_offset = size - 4;
+  assert(!ast_serial_check(image, size));
+  header->loc_offset = loc_offset;
+  FILE *fp = fopen("ast_serial_test.bin", "wb");
+  assert(fp != NULL && fwrite(image, size - 8, 1, fp) == 1); // Truncated
+  fclose(fp);
+  assert(ast_serial_open("ast_serial_test.bin") == NULL);
+  nodes[2].child = 100000;
+  fp = fopen("ast_serial_test.bin", "wb");
+  assert(fp != NULL && fwrite(image, size, 1, fp) == 1);
+  fclose(fp);
+  assert(ast_serial_open("ast_serial_test.bin") == NULL);
+  nodes[2] = saved_child;
+  assert(ast_serial_check(image, size));
+  remove("ast_serial_test.bin");
+  free(image);
+  parse_exp_free(cxt);
+  ast_free(root);
+  ast_free(unpacked);
+  printf("Pass!\n");
+  return;
+}
+
 void final_test() {
   FILE *fp = fopen("parse_test_src.txt", "r");
   SYSEXPECT(fp != NULL);
@@ -720,7 +992,144 @@ void final_test() {
 }
 
 
+// Prints the tree as "TYPE@offset:decl_prop(children)" with offsets relative to the text; "_" is an empty node
+void test_ast_sexp(token_t *token, char *base, str_t *s) {
+  const char *type = token_typestr(token->type) + 2; // Skip "T_"
+  str_concat(s, *type ? type : "_");
+  if(token->offset) { str_append(s, '@'); str_print_int(s, (int)(token->offset - base)); }
+  if(token->decl_prop) { str_append(s, ':'); str_concat(s, token_decl_print(token->decl_prop)); }
+  if(token->child == NULL) return;
+  str_append(s, '(');
+  for(token_t *child = token->child;child != NULL;child = child->sibling) {
+    test_ast_sexp(child, base, s);
+    if(child->sibling != NULL) str_append(s, ' ');
+  }
+  str_append(s, ')');
+}
+
 // This test may introduce memory leak
+// The expected trees are the output of the expression-based declarator parser that parse_decl() replaced
+void test_parse_decl_direct() {
+  printf("=== Test parse_decl direct ===\n");
+  const char *tests[][2] = {
+    {"int a",
+     "DECL@0(BASETYPE@0:int _ IDENT@4)"},
+    {"int *a",
+     "DECL@0(BASETYPE@0:int P_DEREF@4(_) IDENT@5)"},
+    {"int **const *volatile a",
+     "DECL@0(BASETYPE@0:int P_DEREF@4(P_DEREF@5:const(P_DEREF@12:volatile(_))) IDENT@22)"},
+    {"int a[10]",
+     "DECL@0(BASETYPE@0:int P_ARRAY_SUB@5(_ DEC_INT_CONST@6:int) IDENT@4)"},
+    {"int a[2][3 + 4]",
+     "DECL@0(BASETYPE@0:int P_ARRAY_SUB@8(P_ARRAY_SUB@5(_ DEC_INT_CONST@6:int) P_ADD@11(DEC_INT_CONST@9:int DEC_INT_CONST@13:int)) IDENT@4)"},
+    {"int *a[10]",
+     "DECL@0(BASETYPE@0:int P_DEREF@4(P_ARRAY_SUB@6(_ DEC_INT_CONST@7:int)) IDENT@5)"},
+    {"int (*a)[10]",
+     "DECL@0(BASETYPE@0:int P_ARRAY_SUB@8(P_DEREF@5(_) DEC_INT_CONST@9:int) IDENT@6)"},
+    {"int a()",
+     "DECL@0(BASETYPE@0:int P_FUNC_CALL@5(_ _) IDENT@4)"},
+    {"int a(void)",
+     "DECL@0(BASETYPE@0:int P_FUNC_CALL@5(_ DECL@6(BASETYPE@6:void _ _)) IDENT@4)"},
+    {"int *a(int, char *)",
+     "DECL@0(BASETYPE@0:int P_DEREF@4(P_FUNC_CALL@6(_ DECL@7(BASETYPE@7:int _ _) DECL@12(BASETYPE@12:char P_DEREF@17(_) _))) IDENT@5)"},
+    {"int (*a)(int x, ...)",
+     "DECL@0(BASETYPE@0:int P_FUNC_CALL@8(P_DEREF@5(_) DECL@9(BASETYPE@9:int _ IDENT@13) ELLIPSIS@16) IDENT@6)"},
+    {"int (*a[4])(long (*)(int))",
+     "DECL@0(BASETYPE@0:int P_FUNC_CALL@11(P_DEREF@5(P_ARRAY_SUB@7(_ DEC_INT_CONST@8:int)) DECL@12(BASETYPE@12:long P_FUNC_CALL@20(P_DEREF@18(_) DECL@21(BASETYPE@21:int _ _)) _)) IDENT@6)"},
+    {"void (*signal(int sig, void (*func)(int)))(int)",
+     "DECL@0(BASETYPE@0:void P_FUNC_CALL@42(P_DEREF@6(P_FUNC_CALL@13(_ DECL@14(BASETYPE@14:int _ IDENT@18) DECL@23(BASETYPE@23:void P_FUNC_CALL@35(P_DEREF@29(_) DECL@36(BASETYPE@36:int _ _)) IDENT@30))) DECL@43(BASETYPE@43:int _ _)) IDENT@7)"},
+    {"char *(*(*a)(void))[3]",
+     "DECL@0(BASETYPE@0:char P_DEREF@5(P_ARRAY_SUB@19(P_DEREF@7(P_FUNC_CALL@12(P_DEREF@9(_) DECL@13(BASETYPE@13:void _ _))) DEC_INT_CONST@20:int)) IDENT@10)"},
+    {"int ((a))",
+     "DECL@0(BASETYPE@0:int _ IDENT@6)"},
+    {"int (*)[]",
+     "DECL@0(BASETYPE@0:int P_ARRAY_SUB@7(P_DEREF@5(_) _) _)"},
+    {"int *",
+     "DECL@0(BASETYPE@0:int P_DEREF@4(_) _)"},
+    {"int (*)(void)",
+     "DECL@0(BASETYPE@0:int P_FUNC_CALL@7(P_DEREF@5(_) DECL@8(BASETYPE@8:void _ _)) _)"},
+    {"int *(int)",
+     "DECL@0(BASETYPE@0:int P_DEREF@4(P_FUNC_CALL@5(_ DECL@6(BASETYPE@6:int _ _))) _)"},
+    {"const struct s { int x : 3; int y[2]; } *a[4]",
+     "DECL@6(BASETYPE@6:const struct(STRUCT@6:(IDENT@13 COMP_DECL@17(BASETYPE@17:int COMP_FIELD@21(DECL@21(_ _ IDENT@21) BITFIELD@25(DEC_INT_CONST@25:int))) COMP_DECL@28(BASETYPE@28:int COMP_FIELD@33(DECL@33(_ P_ARRAY_SUB@33(_ DEC_INT_CONST@34:int) IDENT@32))))) P_DEREF@40(P_ARRAY_SUB@42(_ DEC_INT_CONST@43:int)) IDENT@41)"},
+    {"void const * const ( *const named_decl[16][32]) (void a, int *[])",
+     "DECL@0(BASETYPE@0:const void P_DEREF@11:const(P_FUNC_CALL@48(P_DEREF@21:const(P_ARRAY_SUB@42(P_ARRAY_SUB@38(_ DEC_INT_CONST@39:int) DEC_INT_CONST@43:int)) DECL@49(BASETYPE@49:void _ IDENT@54) DECL@57(BASETYPE@57:int P_DEREF@61(P_ARRAY_SUB@62(_ _)) _))) IDENT@28)"},
+    {"unsigned long (*(*a)[5])(char [8])",
+     "DECL@0(BASETYPE@0:unsigned long P_FUNC_CALL@24(P_DEREF@15(P_ARRAY_SUB@20(P_DEREF@17(_) DEC_INT_CONST@21:int)) DECL@25(BASETYPE@25:char P_ARRAY_SUB@30(_ DEC_INT_CONST@31:int) _)) IDENT@18)"},
+  };
+  for(int i = 0;i < (int)(sizeof(tests) / sizeof(tests[0]));i++) {
+    char *input = strdup(tests[i][0]);
+    parse_exp_cxt_t *cxt = parse_exp_init(input);
+    token_t *decl = parse_decl(cxt, PARSE_DECL_HASBASETYPE);
+    assert(token_get_next(cxt->token_cxt) == NULL);
+    parse_exp_free(cxt);
+    str_t *s = str_init();
+    test_ast_sexp(decl, input, s);
+    if(strcmp(s->s, tests[i][1]) != 0) printf("%s\n  got      %s\n  expected %s\n", tests[i][0], s->s, tests[i][1]);
+    assert(strcmp(s->s, tests[i][1]) == 0);
+    str_free(s);
+    ast_free(decl);
+    free(input);
+  }
+  // The old parser also accepted a name after the suffixes, as in the last one; parse_decl() does not
+  const char *errors[] = {
+    "int a*", "int a b", "int a const", "int (a", "int a[3", "int a(int", "int (*a) const", "int * const const a",
+    "int (*)(void)[10] a",
+  };
+  error_testmode(1);
+  for(int i = 0;i < (int)(sizeof(errors) / sizeof(errors[0]));i++) {
+    char *input = strdup(errors[i]);
+    parse_exp_cxt_t *cxt = parse_exp_init(input);
+    int err = 0;
+    if(error_trycatch()) {
+      token_t *token = parse_decl(cxt, PARSE_DECL_HASBASETYPE);
+      if(token_lookahead(cxt->token_cxt, 1) != NULL) err = 1; // Stopped before the end
+      ast_free(token);
+    } else { err = 1; }
+    assert(err == 1);
+    parse_exp_free(cxt);
+    free(input);
+  }
+  error_testmode(0);
+  printf("Pass!\n");
+  return;
+}
+
+double test_time_diff(struct timespec *begin, struct timespec *end) {
+  return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+// Prototype-heavy input, as found in system headers
+void test_parse_decl_bench() {
+  printf("=== Test parse_decl benchmark ===\n");
+  int count = 20000;
+  char *s = (char *)malloc(count * 160 + 1);
+  SYSEXPECT(s != NULL);
+  char *p = s;
+  for(int i = 0;i < count;i++) {
+    p += sprintf(p, "extern int f%d(const char *s, unsigned long n, void (*cb)(int, void *), struct st *p[4]);\n", i);
+    p += sprintf(p, "char *(*g%d(int fd))[16];\n", i);
+  }
+  token_t **trees = (token_t **)malloc(sizeof(token_t *) * count * 2);
+  SYSEXPECT(trees != NULL);
+  parse_exp_cxt_t *cxt = parse_exp_init(s);
+  struct timespec begin, end;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for(int i = 0;i < count * 2;i++) {
+    trees[i] = parse_decl(cxt, PARSE_DECL_HASBASETYPE);
+    assert(token_consume_type(cxt->token_cxt, T_SEMICOLON));
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  assert(token_get_next(cxt->token_cxt) == NULL);
+  parse_exp_free(cxt);
+  for(int i = 0;i < count * 2;i++) ast_free(trees[i]);
+  printf("%d declarations: %.3lf s\n", count * 2, test_time_diff(&begin, &end));
+  free(trees);
+  free(s);
+  printf("Pass!\n");
+  return;
+}
+
 void test_anomaly() {
   printf("=== Test anomalies ===\n");
   error_testmode(1);
@@ -779,6 +1188,38 @@ void test_anomaly() {
   return;
 }
 
+// Each thread reports errors against its own text and redirects them to its own jump buffer
+void *test_error_thread_func(void *arg) {
+  long id = (long)arg;
+  char input[64], decl[TOKEN_DECL_PRINT_SIZE];
+  error_testmode(1);
+  for(int i = 0;i < 200;i++) {
+    int err = 0;
+    sprintf(input, "a%ld + (b%d : c)", id, i); // Colon without question mark
+    parse_exp_cxt_t *cxt = parse_exp_init(input);
+    assert(error_get_cxt()->begin == input);
+    if(error_trycatch()) parse_exp(cxt, PARSE_EXP_ALLOWALL);
+    else err = 1;
+    assert(err == 1);
+    assert(error_get_offset(input + 3) == 4);
+    parse_exp_free(cxt);
+    assert(strcmp(token_decl_print_buf(DECL_CONST_MASK | BASETYPE_ULONG, decl), "const unsigned long") == 0);
+  }
+  error_testmode(0);
+  return NULL;
+}
+
+void test_error_thread() {
+  printf("=== Test error_thread ===\n");
+  pthread_t threads[4];
+  int testmode = error_get_cxt()->testmode;
+  for(long i = 0;i < 4;i++) assert(pthread_create(&threads[i], NULL, test_error_thread_func, (void *)i) == 0);
+  for(int i = 0;i < 4;i++) assert(pthread_join(threads[i], NULL) == 0);
+  assert(error_get_cxt()->testmode == testmode); // The main thread is not affected
+  printf("Pass!\n");
+  return;
+}
+
 int main() {
   printf("=== Hello World! ===\n");
   test_stack();
@@ -795,9 +1236,16 @@ int main() {
   test_vararg_func();
   test_parse();
   test_udef();
+  test_lazy_body();
+  test_parse_parallel();
+  test_parse_incremental();
+  test_ast_serial();
   test_parse_decl();
+  test_parse_decl_direct();
+  test_parse_decl_bench();
   test_parse_struct_union();
   test_parse_enum();
   test_anomaly();
+  test_error_thread();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include "server.h"
+
+void test_server_cb(cgen_cxt_t *cgen_cxt, token_t *root, void *arg) {
+  *(int *)arg = list_size(cgen_cxt->export_list);
+  return;
+}
+
+void test_server_compile() {
+  printf("=== Test server_compile ===\n");
+  server_t *server = server_init();
+  char good[] = "int x = 1; int y[] = {1, 2, 3}; struct s { int a; long b; } z = {1, 2L}; ";
+  char bad_syntax[] = "int x = 1; int y = (2 + ; int z; ";
+  char bad_type[] = "int x = 1; int x = 2; ";
+  char bad_init[] = "struct s { int a; long b; } z = {1, {2}, 3}; ";
+  int exports = 0, status;
+  status = server_compile(server, NULL, good, test_server_cb, &exports);
+  assert(status == SERVER_OK && exports == 3);
+  // Each failed request is abandoned, and the next one starts from a clean state
+  for(int i = 0;i < 3;i++) {
+    status = server_compile(server, NULL, bad_syntax, NULL, NULL);
+    assert(status == SERVER_ERROR);
+    status = server_compile(server, NULL, bad_type, NULL, NULL);
+    assert(status == SERVER_ERROR);
+    status = server_compile(server, NULL, bad_init, NULL, NULL);
+    assert(status == SERVER_ERROR);
+    exports = 0;
+    status = server_compile(server, NULL, good, test_server_cb, &exports);
+    assert(status == SERVER_OK && exports == 3);
+  }
+  assert(server->request_count == 13 && server->error_count == 9);
+  // Errors outside the server are not affected by its error contexts
+  assert(error_get_cxt()->recover == 0);
+  server_free(server);
+  printf("Pass!\n");
+  return;
+}
+
+void test_server_cache() {
+  printf("=== Test server AST cache ===\n");
+  server_t *server = server_init();
+  char a1[] = "int x = 1; int f(int a) { return a + x; } ";
+  char a2[] = "int x = 1; int f(int a) { return a + x; } ";  // Same text at a different address
+  char a3[] = "int x = 2; int f(int a) { return a - x; } ";  // Edited
+  int exports = 0;
+  assert(server_compile(server, "a.c", a1, test_server_cb, &exports) == SERVER_OK);
+  assert(server->cache_hit_count == 0 && exports == 2); // x and f
+  exports = 0;
+  assert(server_compile(server, "a.c", a2, test_server_cb, &exports) == SERVER_OK);
+  assert(server->cache_hit_count == 1 && exports == 2);
+  assert(server_compile(server, "a.c", a3, NULL, NULL) == SERVER_OK);
+  assert(server->cache_hit_count == 1);
+  assert(server_compile(server, "a.c", a3, NULL, NULL) == SERVER_OK);
+  assert(server->cache_hit_count == 2);
+  assert(server_compile(server, "b.c", a1, NULL, NULL) == SERVER_OK); // Different name
+  assert(server->cache_hit_count == 2 && ht_size(server->ast_cache) == 2);
+  server_free(server);
+  printf("Pass!\n");
+  return;
+}
+
+void test_server_run() {
+  printf("=== Test server_run ===\n");
+  char good_path[] = "/tmp/cfront_server_good_XXXXXX", bad_path[] = "/tmp/cfront_server_bad_XXXXXX";
+  int fd = mkstemp(good_path);
+  assert(fd != -1);
+  assert(write(fd, "int x = 1; ", 11) == 11);
+  close(fd);
+  fd = mkstemp(bad_path);
+  assert(fd != -1);
+  assert(write(fd, "int x = ; ", 10) == 10);
+  close(fd);
+  char in_buffer[256], out_buffer[512], expected[512];
+  sprintf(in_buffer, "%s\n%s\n\n/nonexistent/cfront.c\n%s\n", good_path, bad_path, good_path);
+  sprintf(expected, "OK %s\nERROR %s\nNOFILE /nonexistent/cfront.c\nOK %s\n", good_path, bad_path, good_path);
+  FILE *in = fmemopen(in_buffer, strlen(in_buffer), "r");
+  FILE *out = fmemopen(out_buffer, sizeof(out_buffer), "w");
+  assert(in != NULL && out != NULL);
+  server_t *server = server_init();
+  server_run(server, in, out);
+  fclose(in);
+  fclose(out);
+  printf("%s", out_buffer);
+  assert(strcmp(out_buffer, expected) == 0);
+  assert(server->request_count == 3 && server->cache_hit_count == 1);
+  server_free(server);
+  unlink(good_path);
+  unlink(bad_path);
+  printf("Pass!\n");
+  return;
+}
+
+// Nodes held by locals of the parser when an error abandons the request are released as well
+void test_server_mem() {
+  printf("=== Test server memory on errors ===\n");
+  server_t *server = server_init();
+  char bad[] = "int f(int a) { int b = (a + (a * (3 + ; return b; }";
+  char bad_body[] = "int x; int f(int a) { if(a) { return a + ; } return 0; } int g;";
+  char bad_type[] = "int f(int a) { return a + nosuch; }";
+  long counts[MEM_KIND_COUNT], bytes[MEM_KIND_COUNT];
+  mem_stat_enable(1);
+  mem_stat_reset();
+  assert(server_compile(server, NULL, bad, NULL, NULL) == SERVER_ERROR);
+  for(int i = 0;i < MEM_KIND_COUNT;i++) {
+    counts[i] = mem_stats[i].count;
+    bytes[i] = mem_stats[i].bytes;
+  }
+  for(int i = 0;i < 100;i++) {
+    assert(server_compile(server, NULL, bad, NULL, NULL) == SERVER_ERROR);
+    assert(server_compile(server, NULL, bad_body, NULL, NULL) == SERVER_ERROR);
+    assert(server_compile(server, NULL, bad_type, NULL, NULL) == SERVER_ERROR);
+  }
+  for(int i = 0;i < MEM_KIND_COUNT;i++) {
+    assert(mem_stats[i].count == counts[i] && mem_stats[i].bytes == bytes[i]);
+  }
+  assert(mem_stats[MEM_TOKEN].count == 0 && mem_stats[MEM_TOKEN_STR].count == 0);
+  mem_stat_enable(0);
+  server_free(server);
+  printf("Pass!\n");
+  return;
+}
+
+int main() {
+  test_server_compile();
+  test_server_cache();
+  test_server_run();
+  test_server_mem();
+  return 0;
+}
@@ -42,6 +42,23 @@ void test_scope_init() {
   assert(scope_search(cxt, SCOPE_STRUCT, "wangziqi2013") == (void *)0x56789UL);
   assert(scope_search(cxt, SCOPE_UNION, "wangziqi2016") == (void *)0x23456UL);
   assert(scope_search(cxt, SCOPE_STRUCT, "wangziqi2018") == (void *)0x45678UL);
+  // Bindings of a scope are undone on decurse, and shadowed bindings become visible again
+  assert(!scope_top_find(cxt, SCOPE_VALUE, "wangziqi2013") && !scope_top_remove(cxt, SCOPE_VALUE, "wangziqi2013"));
+  char names[100][8];
+  for(int i = 0;i < 100;i++) {
+    sprintf(names[i], "v%d", i);
+    scope_top_insert(cxt, SCOPE_VALUE, names[i], (void *)(long)(i + 1));
+  }
+  for(int i = 0;i < 100;i++) assert(scope_search(cxt, SCOPE_VALUE, names[i]) == (void *)(long)(i + 1));
+  assert(scope_top_remove(cxt, SCOPE_STRUCT, "wangziqi2013") == (void *)0x56789UL);
+  assert(scope_search(cxt, SCOPE_STRUCT, "wangziqi2013") == (void *)0x34567UL);
+  scope_top_insert(cxt, SCOPE_STRUCT, "wangziqi2013", (void *)0x6789aUL);
+  scope_decurse(cxt); // 3 levels
+  assert(scope_search(cxt, SCOPE_VALUE, "v0") == NULL && scope_symbol(cxt, SCOPE_VALUE, "v0", 0)->head == NULL);
+  assert(scope_search(cxt, SCOPE_STRUCT, "wangziqi2013") == (void *)0x34567UL);
+  scope_decurse(cxt); // 2 levels
+  assert(scope_search(cxt, SCOPE_STRUCT, "wangziqi2013") == (void *)0x12345UL);
+  assert(scope_search(cxt, SCOPE_STRUCT, "wangziqi2018") == NULL);
   type_sys_free(cxt);
   printf("Pass!\n");
   return;
@@ -97,6 +114,21 @@ void test_bintree() {
     free(results);
     bt_free(bt);
   }
+  // Sorted keys, e.g. fields of generated structs, keep the tree balanced
+  const int sorted_size = 2000;
+  char (*keys)[8] = malloc(sizeof(*keys) * sorted_size);
+  bintree_t *bt = bt_str_init();
+  for(int i = 0;i < sorted_size;i++) {
+    sprintf(keys[i], "f%04d", i);
+    assert(bt_insert(bt, keys[i], keys[i]) == keys[i]);
+  }
+  assert(btnode_height(bt->root) <= 16); // AVL height is less than 1.45 * log2(n + 2)
+  for(int i = 0;i < sorted_size;i++) assert(bt_find(bt, keys[i]) == keys[i]);
+  for(int i = 0;i < sorted_size / 2;i++) assert(bt_remove(bt, keys[i]) == keys[i]);
+  assert(btnode_height(bt->root) <= 15 && bt_size(bt) == sorted_size / 2);
+  for(int i = sorted_size / 2;i < sorted_size;i++) assert(bt_find(bt, keys[i]) == keys[i]);
+  bt_free(bt);
+  free(keys);
   printf("\nPass!\n");
   return;
 }
@@ -285,6 +317,7 @@ void test_eval_const_token_errors() {
   else err = 1;
   assert(err == 1);
   parse_exp_free(cxt);
+  error_testmode(0);
 
   printf("Pass!\n");
   return;
@@ -298,10 +331,7 @@ void test_type_int_convert() {
     for(int2 = BASETYPE_CHAR;int2 <= BASETYPE_ULLONG;int2 += 0x00010000) {
       ret = type_int_convert(type_getint(int1), type_getint(int2));
       //printf("%X %X %X\n", int1, int2, ret);
-      // Note: token_decl_print cannot occur multiple times in printf
-      printf("%s + ", token_decl_print(int1));
-      printf("%s -> ", token_decl_print(int2));
-      printf("%s\n", token_decl_print(ret->decl_prop));
+      printf("%s + %s -> %s\n", token_decl_print(int1), token_decl_print(int2), token_decl_print(ret->decl_prop));
     }
   }
   printf("Pass!\n");
@@ -460,7 +490,7 @@ void test_type_getcomp() {
   parse_exp_free(parse_cxt);
   ast_free(token);
   printf("=====================================\n"); // Tests composite type as base type
-  char test8[] = "struct name { struct name *ptr; struct name (*)(void)[10] ptr2; }";
+  char test8[] = "struct name { struct name *ptr; struct name (*ptr2)(void)[10]; }";
   parse_cxt = parse_exp_init(test8);
   type_cxt = type_sys_init(); 
   token = parse_decl(parse_cxt, PARSE_DECL_HASBASETYPE);
@@ -785,6 +815,111 @@ void test_type_cmp() {
   return;
 }
 
+// Structurally identical derived types share one object, while declared and composite types are not shared
+void test_type_canon() {
+  printf("=== Test type_canon ===\n");
+  type_cxt_t *cxt = type_sys_init();
+  type_t *str1 = type_get_strliteral(cxt, 4);
+  type_t *str2 = type_get_strliteral(cxt, 4);
+  assert(str1 == str2 && str1 != type_get_strliteral(cxt, 5) && str1->next == &type_builtin_const_char);
+  type_t key;
+  memset(&key, 0x00, sizeof(type_t));
+  key.decl_prop = TYPE_OP_DEREF;
+  key.size = TYPE_PTR_SIZE;
+  key.next = type_init_from(cxt, type_getint(BASETYPE_INT), NULL); // Copy of a declared int
+  type_t *ptr = type_canon(cxt, &key);
+  key.next = type_getint(BASETYPE_INT);
+  assert(ptr != NULL && ptr == type_canon(cxt, &key) && ptr->next == type_getint(BASETYPE_INT));
+  assert(type_cmp(ptr, type_canon(cxt, &key)) == TYPE_CMP_EQ);
+  key.decl_prop |= DECL_CONST_MASK;
+  assert(type_canon(cxt, &key) != ptr && type_cmp(type_canon(cxt, &key), ptr) == TYPE_CMP_LOSELESS);
+  key.next = type_init(cxt);
+  key.next->decl_prop = BASETYPE_STRUCT;
+  assert(type_canon(cxt, &key) == NULL && type_canon(cxt, &type_builtin_error) == NULL);
+  type_sys_free(cxt);
+  printf("Pass!\n");
+  return;
+}
+
+// Offsets are the same as gcc on x86-64, except that long long is 16 bytes in this compiler
+void test_type_func_sig() {
+  printf("=== Test function signature ===\n");
+  char *tests[] = {
+    "int f(int a, const char *b, ...)",
+    "int g(int, const char *, ...)",
+    "int h(int a, char *b, ...)",
+    "int k(int a, const char *b)",
+    "int m(void (*cb)(int x), long y[4])",
+    "int n(void (*)(int), long [4])",
+    "int p(void (*)(long), long [4])",
+  };
+  int expected[] = {TYPE_CMP_EQ, TYPE_CMP_NEQ, TYPE_CMP_NEQ, -1, TYPE_CMP_EQ, TYPE_CMP_NEQ}; // Against the previous one
+  type_cxt_t *type_cxt = type_sys_init();
+  type_t *types[7];
+  for(int i = 0;i < 7;i++) {
+    parse_exp_cxt_t *parse_cxt = parse_exp_init(tests[i]);
+    token_t *token = parse_decl(parse_cxt, PARSE_DECL_HASBASETYPE);
+    types[i] = type_gettype(type_cxt, token, ast_getchild(token, 0), 0);
+    str_t *s = type_print(types[i], NULL, NULL, 0, 0);
+    printf("%s: %d args, hash 0x%lX\n", s->s, types[i]->arg_count, types[i]->arg_hash);
+    str_free(s);
+    if(i > 0 && expected[i - 1] != -1) {
+      int ret = type_cmp(types[i], types[i - 1]);
+      assert(ret == expected[i - 1]);
+      assert(ret != TYPE_CMP_EQ || types[i]->arg_hash == types[i - 1]->arg_hash);
+    }
+    if(i < 2) assert(i == 0 ? strcmp(types[i]->arg_names[1], "b") == 0 : types[i]->arg_names[1] == NULL); // Names are owned by AST
+    parse_exp_free(parse_cxt);
+    ast_free(token);
+  }
+  assert(types[0]->arg_count == 2 && types[0]->vararg && !types[3]->vararg);
+  assert(types[0]->arg_hash != types[2]->arg_hash); // Qualifiers of pointed-to types are part of the signature
+  type_sys_free(type_cxt);
+  printf("Pass!\n");
+  return;
+}
+
+void test_type_layout() {
+  printf("=== Test type_print_layout ===\n");
+  char *tests[] = {
+    "struct { char a; long b; char c; }",
+    "struct { int a:3; int b:30; char c; }",
+    "struct { char a; int b:4; char c:4; long d:40; }",
+    "struct { char a; int :0; char b; }",
+    "union { char a; long b; int c:3; }",
+    "struct { char a; struct { char x; long y; } s; char z[3]; }",
+    "struct { char a; union { int x; long y; }; char b; }",
+    "struct { char a; long b[8]; }",
+  };
+  // Bit offset of each named field from the beginning; Size, padding, and size with suggested order
+  int offsets[][4] = {{0, 64, 128}, {0, 32, 64}, {0, 8, 12, 16}, {0, 32}, {0, 0, 0}, {0, 64, 192}, {0, 64, 64, 128}, {0, 64}};
+  size_t sizes[][3] = {{24, 14, 16}, {12, 6, 12}, {8, 1, 8}, {5, 3, 5}, {8, 0, 8}, {32, 12, 24}, {24, 14, 24}, {72, 7, 72}};
+  for(int i = 0;i < (int)(sizeof(tests) / sizeof(tests[0]));i++) {
+    parse_exp_cxt_t *parse_cxt = parse_exp_init(tests[i]);
+    type_cxt_t *type_cxt = type_sys_init();
+    token_t *token = parse_decl(parse_cxt, PARSE_DECL_HASBASETYPE);
+    type_t *type = type_gettype(type_cxt, token, ast_getchild(token, 0), 0);
+    int index = 0;
+    for(listnode_t *node = list_head(type->comp->field_list);node != NULL;node = list_next(node)) {
+      field_t *field = (field_t *)list_value(node);
+      if(field->name == NULL) continue;
+      int bit = field->offset * 8 + (field->bitfield_size == -1 ? 0 : field->bitfield_offset);
+      assert(bit == offsets[i][index++]);
+    }
+    type_layout_t layout;
+    str_t *s = type_print_layout(type, NULL, &layout);
+    printf("%s", s->s);
+    str_free(s);
+    assert(type->size == sizes[i][0] && layout.padding == sizes[i][1] && layout.min_size == sizes[i][2]);
+    assert(layout.straddle_count == (i == 7)); // The array spans bytes 8 to 72
+    type_sys_free(type_cxt);
+    parse_exp_free(parse_cxt);
+    ast_free(token);
+  }
+  printf("Pass!\n");
+  return;
+}
+
 int main() {
   printf("=== Hello World! ===\n");
   test_scope_init();
@@ -800,6 +935,9 @@ int main() {
   test_type_anomaly();
   test_eval_const_str_token();
   test_type_cmp();
+  test_type_canon();
+  test_type_func_sig();
+  test_type_layout();
   return 0;
 }
   
@@ -66,11 +66,16 @@ int precedences[51] = {
   15,         // EXP_COMMA,                               // binary ,
 };
 
+// Token pool bound to the calling thread, see token_pool_bind(); NULL if tokens are not recorded
+__thread token_pool_t *token_curr_pool = NULL;
+
 token_cxt_t *token_cxt_init(char *input) {
   token_cxt_t *cxt = (token_cxt_t *)malloc(sizeof(token_cxt_t));
   SYSEXPECT(cxt != NULL);
   cxt->udef_types = stack_init();
   stack_push(cxt->udef_types, ht_str_init());
+  cxt->frozen_udef = NULL;
+  cxt->udef_limit = NULL;
   cxt->pb_head = cxt->pb_tail = NULL;
   cxt->s = cxt->begin = input;
   cxt->pb_count = 0;
@@ -78,7 +83,14 @@ token_cxt_t *token_cxt_init(char *input) {
 }
 
 void token_cxt_reinit(token_cxt_t *cxt, char *input) {
-  cxt->s = cxt->begin = input;
+  cxt->begin = input;
+  token_cxt_seek(cxt, input);
+  return;
+}
+
+// Moves the read position within the current text; Tokens in the pushback queue are dropped
+void token_cxt_seek(token_cxt_t *cxt, char *s) {
+  cxt->s = s;
   token_t *curr = cxt->pb_head;
   while(curr != NULL) {
     token_t *next = curr->next;
@@ -92,7 +104,8 @@ void token_cxt_reinit(token_cxt_t *cxt, char *input) {
 
 void token_cxt_free(token_cxt_t *cxt) {
   while(stack_size(cxt->udef_types) != 0) {
-    ht_free(stack_pop(cxt->udef_types));
+    hashtable_t *ht = (hashtable_t *)stack_pop(cxt->udef_types);
+    if(ht != NULL) ht_free(ht);
   }
   stack_free(cxt->udef_types);
   token_t *curr = cxt->pb_head;
@@ -104,14 +117,16 @@ void token_cxt_free(token_cxt_t *cxt) {
   free(cxt);
 }
 
-// Called by parse_stmt when we see a statement block
+// Called by parse_stmt when we see a statement block. Few blocks declare a typedef, so the table 
+// is only allocated by the first one in the scope, and empty scopes are skipped on lookup
 void token_enter_scope(token_cxt_t *cxt) { 
-  stack_push(cxt->udef_types, ht_str_init()); 
+  stack_push(cxt->udef_types, NULL); 
   return;
 }
 
 void token_exit_scope(token_cxt_t *cxt) { 
-  ht_free((hashtable_t *)stack_pop(cxt->udef_types)); 
+  hashtable_t *ht = (hashtable_t *)stack_pop(cxt->udef_types);
+  if(ht != NULL) ht_free(ht); 
   return;
 }
 
@@ -119,26 +134,45 @@ void token_exit_scope(token_cxt_t *cxt) {
 // it sees a typedef'ed base type with a name
 void token_add_utype(token_cxt_t *cxt, token_t *token) {
   assert(token->type == T_IDENT && stack_size(cxt->udef_types));
-  token_t *prev = (token_t *)ht_find((hashtable_t *)stack_peek(cxt->udef_types), token->str);
+  hashtable_t *ht = (hashtable_t *)stack_peek(cxt->udef_types);
+  if(ht == NULL) {
+    ht = ht_str_init();
+    stack_pop(cxt->udef_types);
+    stack_push(cxt->udef_types, ht);
+  }
+  token_t *prev = (token_t *)ht_find(ht, token->str);
   if(prev != HT_NOTFOUND) {
     int row, col;
     error_get_row_col(cxt->begin, &row, &col);
     error_row_col_exit(token->offset, 
       "The type name \"%s\" for typedef has already been defined @ row %d col %d\n", token->str, row, col);
   }
-  ht_insert((hashtable_t *)stack_peek(cxt->udef_types), token->str, token);
+  ht_insert(ht, token->str, token);
 }
 
 // Search from stack top to stack bottom and see whether we defined that type
+// The frozen global set, if any, is searched last since it is below the bottom of the stack
+// Global names declared at or after udef_limit are skipped, such that a body parsed out of order
+// only sees typedefs declared before it, as if it were parsed in source order
+// This runs once per identifier when it is lexed, and the result is stored in the token as T_UDEF,
+// such that lookahead checks, e.g. cast vs. parenthesis, only test the token type
 int token_isutype(token_cxt_t *cxt, token_t *token) {
   if(token->type != T_IDENT) {
     return 0;
   }
-  for(int i = 0;i < stack_size(cxt->udef_types);i++) {
-    if(ht_find((hashtable_t *)stack_peek_at(cxt->udef_types, i), token->str) != HT_NOTFOUND) {
+  int bottom = stack_size(cxt->udef_types) - 1;
+  for(int i = 0;i <= bottom;i++) {
+    hashtable_t *ht = (hashtable_t *)stack_peek_at(cxt->udef_types, i);
+    if(ht == NULL || ht->size == 0) continue; // Avoids hashing the name for scopes without typedef
+    token_t *name = (token_t *)ht_find(ht, token->str);
+    if(name != HT_NOTFOUND && (i != bottom || cxt->udef_limit == NULL || name->offset < cxt->udef_limit)) {
       return 1;
     }
   }
+  if(cxt->frozen_udef != NULL) {
+    char *offset = (char *)ht_find(cxt->frozen_udef, token->str);
+    if(offset != HT_NOTFOUND && (cxt->udef_limit == NULL || offset < cxt->udef_limit)) return 1;
+  }
   return 0;
 }
 
@@ -167,9 +201,10 @@ int token_decl_apply(token_t *dest, token_t *src) {
   return 1;
 }
 
-// Returns a buffer that contains string representation of the property bit mask
-char *token_decl_print(decl_prop_t decl_prop) {
-  static char buffer[512]; buffer[0] = '\0';  // Should be sufficient?
+// Writes string representation of the property bit mask into the buffer, which should have at least
+// TOKEN_DECL_PRINT_SIZE bytes, and returns the buffer. Use token_decl_print() for a temporary buffer
+char *token_decl_print_buf(decl_prop_t decl_prop, char *buffer) {
+  buffer[0] = '\0';
   if(decl_prop & DECL_STGCLS_MASK) {
     switch(decl_prop & DECL_STGCLS_MASK) {
       case DECL_TYPEDEF: strcat(buffer, "typedef "); break;
@@ -206,9 +241,10 @@ char *token_decl_print(decl_prop_t decl_prop) {
       case BASETYPE_UDEF:       strcat(buffer, "<typedef'ed> "); break;
       case BASETYPE_VOID:       strcat(buffer, "void "); break;
       case BASETYPE_BITFIELD:   strcat(buffer, "bitfield "); break;
+      case BASETYPE_ERROR:      strcat(buffer, "<error> "); break;
     }
   }
-  buffer[strlen(buffer) - 1] = '\0';
+  if(buffer[0] != '\0') buffer[strlen(buffer) - 1] = '\0'; // Remove the trailing space
   return buffer;
 }
 
@@ -432,6 +468,7 @@ const char *token_typestr(token_type_t type) {
     case T_GLOBAL_DECL_VAR: return "T_GLOBAL_DECL_VAR";
     case T_BITFIELD: return "T_BITFIELD";
     case T_INIT: return "T_INIT";
+    case T_LAZY_BODY: return "T_LAZY_BODY";
     case T_ILLEGAL: return "T_ILLEGAL";
     default: return "(unknown)";
   }
@@ -671,13 +708,22 @@ void token_copy_literal(token_t *token, const char *begin, const char *end) {
   SYSEXPECT(token->str != NULL);
   memcpy(token->str, begin, end - begin);
   token->str[end - begin] = '\0';
+  mem_stat_add(MEM_TOKEN_STR, 1, end - begin + 1);
   return;
 }
 
 void token_free(token_t *token) {
+  assert(token->pool != TOKEN_POOL_DEAD);
   if(token->type >= T_LITERALS_BEGIN && token->type < T_LITERALS_END) {
+    if(mem_stat_enabled) mem_stat_add(MEM_TOKEN_STR, -1, -(long)(strlen(token->str) + 1));
     free(token->str);
   }
+  mem_stat_add(MEM_TOKEN, -1, -(long)sizeof(token_t));
+  if(token->pool == TOKEN_POOL_LIVE) {
+    token->pool = TOKEN_POOL_DEAD;
+    token->str = NULL;
+    return;
+  }
   free(token);
   return;
 }
@@ -690,6 +736,19 @@ token_t *token_alloc() {
   token->type = T_ILLEGAL;
   token->offset = NULL;
   token->decl_prop = DECL_NULL;
+  token->pool = TOKEN_POOL_NONE;
+  token->exp_type = NULL;
+  mem_stat_add(MEM_TOKEN, 1, sizeof(token_t));
+  token_pool_t *pool = token_curr_pool;
+  if(pool != NULL) {
+    if(pool->count == pool->capacity) {
+      pool->capacity = pool->capacity ? pool->capacity * 2 : TOKEN_POOL_INIT_SIZE;
+      pool->tokens = (token_t **)realloc(pool->tokens, sizeof(token_t *) * pool->capacity);
+      SYSEXPECT(pool->tokens != NULL);
+    }
+    pool->tokens[pool->count++] = token;
+    token->pool = TOKEN_POOL_LIVE;
+  }
   return token;
 }
 
@@ -703,12 +762,53 @@ token_t *token_get_empty() {
   return token_alloc_type(T_); 
 }
 
+token_pool_t *token_pool_init() {
+  token_pool_t *pool = (token_pool_t *)malloc(sizeof(token_pool_t));
+  SYSEXPECT(pool != NULL);
+  pool->tokens = NULL;
+  pool->count = pool->capacity = 0;
+  return pool;
+}
+
+// Releases all tokens recorded since the last commit, whether or not they have been freed, and the 
+// pool itself. The pool must not be bound to any thread
+void token_pool_free(token_pool_t *pool) {
+  assert(pool != token_curr_pool);
+  for(int i = 0;i < pool->count;i++) {
+    token_t *token = pool->tokens[i];
+    if(token->pool == TOKEN_POOL_LIVE) token_free(token);
+    free(token);
+  }
+  free(pool->tokens);
+  free(pool);
+  return;
+}
+
+// Binds a pool to the calling thread and returns the previous one; NULL stops recording
+token_pool_t *token_pool_bind(token_pool_t *pool) {
+  token_pool_t *prev = token_curr_pool;
+  token_curr_pool = pool;
+  return prev;
+}
+
+// Called when the work succeeds; Tokens that are still live are handed over to their trees, which 
+// free them with token_free() as usual, and the memory of freed ones is released
+void token_pool_commit(token_pool_t *pool) {
+  for(int i = 0;i < pool->count;i++) {
+    token_t *token = pool->tokens[i];
+    if(token->pool == TOKEN_POOL_DEAD) free(token);
+    else token->pool = TOKEN_POOL_NONE;
+  }
+  pool->count = 0;
+  return;
+}
+
 // Returns an identifier, including both keywords and user defined identifier
 // Same rule as the get_op call
 // Note:
 //   1. If keywords are detected then the literal is not copied to the token
 char *token_get_ident(token_cxt_t *cxt, char *s, token_t *token) {
-  static char buffer[TOKEN_MAX_KWD_SIZE + 1];  // One additional for terminating zero
+  char buffer[TOKEN_MAX_KWD_SIZE + 1];  // One additional for terminating zero
   token->offset = s;
   if(s == NULL || *s == '\0') return NULL;
   else if(isalpha(*s) || *s == '_') {
@@ -933,6 +1033,49 @@ token_t *token_get_next(token_cxt_t *cxt) {
   return ret;
 }
 
+// Skips the rest of a "{ ... }" block whose opening '{' has just been consumed, and returns the
+// position after the matching '}'. Tokens already in the pushback queue are consumed first; After 
+// that the text is scanned character by character without allocating tokens. Comments and 
+// string/char literals are skipped such that braces inside them are not counted
+char *token_skip_block(token_cxt_t *cxt) {
+  int level = 1;
+  while(cxt->pb_count != 0) {
+    token_t *token = token_get_next(cxt);
+    char *end = token->offset + 1;
+    if(token->type == T_LCPAREN) level++;
+    else if(token->type == T_RCPAREN) level--;
+    token_free(token);
+    if(level == 0) return end;
+  }
+  char *s = cxt->s;
+  while(level != 0) {
+    const char *before = s;
+    if(*s == '\0') {
+      error_row_col_exit(before, "Block not closed at the end of file\n");
+    } else if(s[0] == '/' && s[1] == '/') {
+      while(*s != '\n' && *s != '\0') s++;
+    } else if(s[0] == '/' && s[1] == '*') {
+      s += 2;
+      while(s[0] != '\0' && (s[0] != '*' || s[1] != '/')) s++;
+      if(s[0] == '\0') error_row_col_exit(before, "Block comment not closed at the end of file\n");
+      s += 2;
+    } else if(*s == '\'' || *s == '\"') {
+      char closing = *s++;
+      while(*s != closing) {
+        if(*s == '\0') error_row_col_exit(before, "%s literal not closed\n", closing == '\"' ? "String" : "Char");
+        s += (*s == '\\' && s[1] != '\0') ? 2 : 1; // Escaped characters are skipped as a whole
+      }
+      s++;
+    } else {
+      if(*s == '{') level++;
+      else if(*s == '}') level--;
+      s++;
+    }
+  }
+  cxt->s = s;
+  return s;
+}
+
 // Consume the next token if it is of the given type. 
 // Return 0 if there is no next token or type mismatch, and the token is not consumed
 int token_consume_type(token_cxt_t *cxt, token_type_t type) {
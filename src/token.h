@@ -13,6 +13,12 @@
 #include "hashtable.h"
 
 #define TOKEN_MAX_KWD_SIZE 31 // Keywords cannot be 32 chars long (enough for C keywords)
+#define TOKEN_DECL_PRINT_SIZE 64 // Buffer size for token_decl_print_buf(); The longest is 43 bytes
+#define TOKEN_POOL_INIT_SIZE 256 // Initial capacity of the token array of a token pool
+
+// The temporary buffer lives until the end of the enclosing block, so this can be used several times
+// in the same function call
+#define token_decl_print(decl_prop) token_decl_print_buf(decl_prop, (char [TOKEN_DECL_PRINT_SIZE]){0})
 
 // Types of raw tokens. 
 // This enum type does not distinguish between different expression operators, i.e. both
@@ -116,6 +122,7 @@ typedef enum {
   T_GLOBAL_DECL_VAR,              // Single entry that contains name and initializer
   T_BITFIELD,                     // Bit field in struct/union; Contains an expression
   T_INIT,                         // Single value init, only has one child
+  T_LAZY_BODY,                    // Unparsed function body; offset is '{' and str is the char after '}'
 
   T_ILLEGAL = 10000,    // Mark a return value
 } token_type_t;
@@ -123,6 +130,8 @@ typedef enum {
 // Declaration properties, see below
 typedef uint32_t decl_prop_t;
 
+struct type_t_struct;
+
 typedef struct token_t {
   token_type_t type;         // This will be written during parsing to AST type
   char *str;                 // Only valid for literals and identifiers; Owned by the token object
@@ -134,8 +143,24 @@ typedef struct token_t {
   struct token_t *parent;    // Empty for root node
   char *offset;              // The offset in source file, for error reporting purposes; AST node may also have this field
   decl_prop_t decl_prop;     // Property if the kwd is part of declaration; Set when a kwd is found
+  int pool;                  // TOKEN_POOL_ series; Whether the token is recorded by a token pool
+  struct type_t_struct *exp_type; // Memoized by type_typeof(); Valid only during checking. Cleared when the
+                                  // scopes of a function body are released, and by ast_clear_types()
 } token_t;
 
+#define TOKEN_POOL_NONE 0    // Owned by the tree or the caller, and freed by token_free()
+#define TOKEN_POOL_LIVE 1    // Recorded by the pool bound when it was allocated
+#define TOKEN_POOL_DEAD 2    // Already freed by token_free(); The memory is released with the pool
+
+// Records tokens allocated by a thread while the pool is bound to it, see token_pool_bind(), such 
+// that work abandoned by an error can release tokens that are not reachable from any tree, e.g. 
+// nodes held by locals of the recursive descent parser. Freeing a recorded token only marks it
+typedef struct {
+  token_t **tokens;
+  int count;
+  int capacity;
+} token_pool_t;
+
 #define DECL_NULL          0x00000000
 #define DECL_INVALID       0xFFFFFFFF // Naturally incompatible with all
 // Type specifier bit mask (bit 4, 5, 6, 7), at the token level
@@ -196,6 +221,7 @@ typedef struct token_t {
 #define BASETYPE_UDEF       0x00110000
 #define BASETYPE_VOID       0x00120000
 #define BASETYPE_BITFIELD   0x00130000
+#define BASETYPE_ERROR      0x00140000 // Placeholder type of an expression with a reported error
 #define BASETYPE_GET(decl_prop) (decl_prop & BASETYPE_MASK)
 // Better write setters as functions, not macros to avoid evaluating arguments multiple times
 inline static void BASETYPE_SET(token_t *token, decl_prop_t basetype) {
@@ -218,6 +244,8 @@ inline static void BASETYPE_SET(token_t *token, decl_prop_t basetype) {
 
 typedef struct {
   stack_t *udef_types;       // Auto detected when lexing T_IDENT
+  hashtable_t *frozen_udef;  // Read-only global typedef names -> declaration offset shared with other contexts; Not owned
+  char *udef_limit;          // If not NULL, global typedef names declared at or after it are not visible
   token_t *pb_head;          // Pushback token head (removing end)
   token_t *pb_tail;          // Pushback token tail (inserting end)
   int pb_count;              // Number of pushbacks
@@ -240,6 +268,7 @@ inline static int token_is_assign(token_t *token) {
 
 token_cxt_t *token_cxt_init(char *input);
 void token_cxt_reinit(token_cxt_t *cxt, char *input); // Change input stream
+void token_cxt_seek(token_cxt_t *cxt, char *s);
 void token_cxt_free(token_cxt_t *cxt);
 void token_enter_scope(token_cxt_t *cxt);
 void token_exit_scope(token_cxt_t *cxt);
@@ -247,7 +276,7 @@ void token_add_utype(token_cxt_t *cxt, token_t *token);
 int token_isutype(token_cxt_t *cxt, token_t *token);
 int token_decl_compatible(token_t *dest, token_t *src);
 int token_decl_apply(token_t *dest, token_t *src);
-char *token_decl_print(decl_prop_t decl_prop);
+char *token_decl_print_buf(decl_prop_t decl_prop, char *buffer);
 void token_get_property(token_type_t type, int *preced, assoc_t *assoc);
 int token_get_num_operand(token_type_t type);
 token_type_t token_get_keyword_type(const char *s);
@@ -259,11 +288,16 @@ void token_free(token_t *token);
 token_t *token_alloc();
 token_t *token_alloc_type(token_type_t type);
 token_t *token_get_empty();
+token_pool_t *token_pool_init();
+void token_pool_free(token_pool_t *pool);
+token_pool_t *token_pool_bind(token_pool_t *pool);
+void token_pool_commit(token_pool_t *pool);
 char *token_get_ident(token_cxt_t *cxt, char *s, token_t *token);
 char *token_get_int(char *s, token_t *token);
 char *token_get_str(char *s, token_t *token, char closing);
 token_t *token_get_next_ignore_lookahead(token_cxt_t *cxt);
 token_t *token_get_next(token_cxt_t *cxt);
+char *token_skip_block(token_cxt_t *cxt);
 int token_consume_type(token_cxt_t *cxt, token_type_t type);
 void token_pushback(token_cxt_t *cxt, token_t *token);
 token_t *token_lookahead(token_cxt_t *cxt, int count);
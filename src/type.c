@@ -4,6 +4,7 @@
 #include "eval.h"
 #include "ast.h"
 #include "str.h"
+#include <limits.h>
 
 int_prop_t ints[11] = { // Integer sign and size, using index of base type
   {-1, -1}, // BASETYPE_NONE, 0x00
@@ -37,6 +38,9 @@ type_t type_builtin_ints[11] = {
 type_t type_builtin_void = {
   BASETYPE_VOID, NULL, {NULL}, {0}, NULL, NULL, TYPE_VOID_SIZE
 };
+type_t type_builtin_error = { // Shared by all expressions with errors; Must not be modified
+  BASETYPE_ERROR, NULL, {NULL}, {0}, NULL, NULL, TYPE_UNKNOWN_SIZE
+};
 type_t type_builtin_const_char = { // const char type
   BASETYPE_CHAR | DECL_CONST_MASK, NULL, {NULL}, {0}, NULL, NULL, TYPE_CHAR_SIZE
 }; 
@@ -51,28 +55,29 @@ obj_free_func_t obj_free_func_list[OBJ_TYPE_COUNT + 1] = {  // Object free funct
   field_free,
   enum_free,
   value_free,
+  NULL,       // Binding
+  NULL,       // Argument arrays
   NULL,       // Sentinel - will segment fault
 };
 
-// Argument full_size includes the trailing '\0'
-type_t *type_get_strliteral(type_cxt_t *cxt, size_t full_size, char *offset) {
-  type_t *const_char_type = type_init_from(cxt, &type_builtin_const_char, offset);
-  type_t *ret = type_init_from(cxt, &type_builtin_string_template, offset);
-  ret->array_size = full_size;
-  ret->size = full_size * TYPE_CHAR_SIZE;
-  ret->next = const_char_type; 
-  return ret;
+// Argument full_size includes the trailing '\0'; Returns a canonical type
+type_t *type_get_strliteral(type_cxt_t *cxt, size_t full_size) {
+  type_t type = type_builtin_string_template;
+  type.array_size = full_size;
+  type.size = full_size * TYPE_CHAR_SIZE;
+  return type_canon(cxt, &type);
 }
 
 // We provide 4 channels such that they can be used in the same printf function call
 // (C semsntics require that arguments be fully evaluated before function call)
-char *type_print_str(int channel, type_t *type, const char *name, int print_comp_body) {
-  static str_t *channels[TYPE_PRINT_CHANNEL_MAX] = {NULL, }; // All NULL
+// The returned string is valid until the channel is reused or the context is freed
+char *type_print_str(type_cxt_t *cxt, int channel, type_t *type, const char *name, int print_comp_body) {
   assert(channel >= 0 && channel < TYPE_PRINT_CHANNEL_MAX);
-  if(channels[channel]) str_free(channels[channel]);
-  channels[channel] = str_init();
-  type_print(type, name, channels[channel], print_comp_body, 0);
-  return str_cstr(channels[channel]);
+  str_t **s = &cxt->print_channels[channel];
+  if(*s) str_free(*s);
+  *s = str_init();
+  type_print(type, name, *s, print_comp_body, 0);
+  return str_cstr(*s);
 }
 
 // Prints a type in string on stdout
@@ -181,12 +186,11 @@ str_t *type_print(type_t *type, const char *name, str_t *s, int print_comp_body,
         str_append(decl_s, ')');
       }
       str_append(decl_s, '(');
-      listnode_t *arg = list_head(type->arg_list);
-      while(arg) {
-        str_t *arg_s = type_print(list_value(arg), list_key(arg), NULL, 0, 0); // Always do not print body
+      for(int i = 0;i < type->arg_count;i++) {
+        str_t *arg_s = type_print(type->arg_types[i], type->arg_names[i], NULL, 0, 0); // Always do not print body
         str_concat(decl_s, arg_s->s);
         str_free(arg_s);
-        if((arg = list_next(arg)) != NULL) str_concat(decl_s, ", "); // If there is more arguments
+        if(i + 1 < type->arg_count) str_concat(decl_s, ", "); // If there is more arguments
         else if(type->vararg) str_concat(decl_s, ", ...");
       }
       str_append(decl_s, ')');
@@ -200,24 +204,131 @@ str_t *type_print(type_t *type, const char *name, str_t *s, int print_comp_body,
   return s;
 }
 
+// Storage bytes [*begin, *end) of a field; Empty for zero sized bit fields
+void type_field_range(field_t *field, size_t *begin, size_t *end) {
+  if(field->bitfield_size == -1) {
+    *begin = field->offset;
+    *end = field->offset + field->size;
+  } else {
+    *begin = field->offset + field->bitfield_offset / 8;
+    *end = field->bitfield_size ? (size_t)(field->offset + (field->bitfield_offset + field->bitfield_size + 7) / 8) : *begin;
+  }
+}
+
+// Prints the layout of a struct or union: Fields with their storage, holes and tail padding, fields
+// that straddle a cache line, and a field order that minimizes the size. Sorting fields by decreasing 
+// alignment is optimal since alignments are powers of two and sizes are multiples of alignments. 
+// Bit fields and promoted fields are not reordered. The summary is also written to layout if not NULL
+str_t *type_print_layout(type_t *type, str_t *s, type_layout_t *layout) {
+  assert(type_is_comp(type) && type->comp->has_definition);
+  comp_t *comp = type->comp;
+  type_layout_t stat;
+  memset(&stat, 0x00, sizeof(type_layout_t));
+  if(!s) s = str_init();
+  type_print(type, NULL, s, 0, 0);
+  str_concat(s, "(size ");
+  str_print_int(s, (int)comp->size);
+  str_concat(s, ", align ");
+  str_print_int(s, (int)comp->align);
+  str_concat(s, ")\n");
+  int count = list_size(comp->field_list);
+  uint8_t *used = (uint8_t *)malloc(comp->size + 1);
+  field_t **fields = (field_t **)malloc(sizeof(field_t *) * (count + 1));
+  SYSEXPECT(used != NULL && fields != NULL);
+  memset(used, 0x00, comp->size);
+  int reorder = type_is_struct(type) && !comp->has_anon;
+  count = 0;
+  for(listnode_t *node = list_head(comp->field_list);node != NULL;node = list_next(node)) {
+    field_t *field = (field_t *)list_value(node);
+    size_t begin, end;
+    type_field_range(field, &begin, &end);
+    memset(used + begin, 0x01, end - begin);
+    str_t *field_s = type_print(field->type, field->name, NULL, 0, 1);
+    str_concat(s, field_s->s);
+    str_free(field_s);
+    if(field->bitfield_size != -1) {
+      str_concat(s, " : ");
+      str_print_int(s, field->bitfield_size);
+      reorder = 0;
+    }
+    str_concat(s, "; @ ");
+    str_print_int(s, (int)begin);
+    str_concat(s, " size ");
+    str_print_int(s, (int)(end - begin));
+    if(end > begin && begin / TYPE_CACHE_LINE_SIZE != (end - 1) / TYPE_CACHE_LINE_SIZE) {
+      str_concat(s, " (straddles cache line)");
+      stat.straddle_count++;
+    }
+    str_append(s, '\n');
+    fields[count++] = field;
+  }
+  for(size_t begin = 0;begin < comp->size;) {
+    if(used[begin]) { begin++; continue; }
+    size_t end = begin;
+    while(end < comp->size && !used[end]) end++;
+    str_concat(s, end == comp->size ? "  tail padding @ " : "  hole @ ");
+    str_print_int(s, (int)begin);
+    str_concat(s, " size ");
+    str_print_int(s, (int)(end - begin));
+    str_append(s, '\n');
+    stat.padding += end - begin;
+    stat.hole_count++;
+    begin = end;
+  }
+  str_concat(s, "padding ");
+  str_print_int(s, (int)stat.padding);
+  str_concat(s, " bytes in ");
+  str_print_int(s, stat.hole_count);
+  str_concat(s, " holes; ");
+  str_print_int(s, stat.straddle_count);
+  str_concat(s, " fields straddle cache lines\n");
+  stat.min_size = comp->size;
+  if(reorder) {
+    for(int i = 1;i < count;i++) { // Stable insertion sort by decreasing alignment
+      field_t *field = fields[i];
+      int j = i;
+      for(;j > 0 && type_alignof(fields[j - 1]->type) < type_alignof(field->type);j--) fields[j] = fields[j - 1];
+      fields[j] = field;
+    }
+    size_t offset = 0;
+    for(int i = 0;i < count;i++) offset = type_align_up(offset, type_alignof(fields[i]->type)) + fields[i]->size;
+    stat.min_size = type_align_up(offset, comp->align);
+  }
+  if(stat.min_size < comp->size) {
+    str_concat(s, "suggested order (size ");
+    str_print_int(s, (int)stat.min_size);
+    str_concat(s, "):");
+    for(int i = 0;i < count;i++) {
+      str_append(s, ' ');
+      str_concat(s, type_printable_name(fields[i]->name));
+    }
+    str_append(s, '\n');
+  }
+  free(used);
+  free(fields);
+  if(layout) *layout = stat;
+  return s;
+}
+
 scope_t *scope_init(int level) {
   scope_t *scope = (scope_t *)malloc(sizeof(scope_t));
   SYSEXPECT(scope != NULL);
   scope->level = level;
-  for(int i = 0;i < SCOPE_TYPE_COUNT;i++) scope->names[i] = ht_str_init();
-  for(int i = 0;i < OBJ_TYPE_COUNT;i++) scope->objs[i] = list_init();
+  scope->log = NULL;
+  arena_init(&scope->arena);
   return scope;
 }
 
 void scope_free(scope_t *scope) {
-  // Free objects first, then free the list
-  for(int i = 0;i < OBJ_TYPE_COUNT;i++) {
-    obj_free_func_t func = obj_free_func_list[i];
-    listnode_t *curr = list_head(scope->objs[i]);
-    while(curr) { func(curr->value); curr = list_next(curr); }
-    list_free(scope->objs[i]);
+  // Release memory owned by objects first, then all objects at once
+  for(arena_chunk_t *chunk = scope->arena.first;chunk != NULL;chunk = chunk->next) {
+    for(size_t offset = 0;offset < chunk->used;) {
+      obj_header_t *header = (obj_header_t *)(chunk->data + offset);
+      if(obj_free_func_list[header->kind] != NULL) obj_free_func_list[header->kind](header + 1);
+      offset += header->size;
+    }
   }
-  for(int i = 0;i < SCOPE_TYPE_COUNT;i++) ht_free(scope->names[i]);
+  arena_free(&scope->arena);
   free(scope);
   return;
 }
@@ -232,6 +343,21 @@ type_cxt_t *type_sys_init() {
   type_cxt_t *cxt = (type_cxt_t *)malloc(sizeof(type_cxt_t));
   SYSEXPECT(cxt != NULL);
   cxt->scopes = stack_init();
+  for(int i = 0;i < SCOPE_TYPE_COUNT;i++) cxt->symbols[i] = ht_str_init();
+  arena_init(&cxt->arena);
+  arena_init(&cxt->eval_arena);
+  cxt->eval_depth = 0;
+  ast_walk_init(&cxt->walk);
+  // Built-in types are canonical, such that types derived from them can be compared by pointer
+  cxt->canon_types = ht_init(type_eq_cb, type_hash_cb);
+  for(int i = BASETYPE_INDEX(BASETYPE_CHAR);i <= BASETYPE_INDEX(BASETYPE_ULLONG);i++) 
+    ht_insert(cxt->canon_types, &type_builtin_ints[i], &type_builtin_ints[i]);
+  ht_insert(cxt->canon_types, &type_builtin_void, &type_builtin_void);
+  ht_insert(cxt->canon_types, &type_builtin_const_char, &type_builtin_const_char);
+  memset(cxt->print_channels, 0x00, sizeof(cxt->print_channels));
+  cxt->frozen_global = NULL;
+  cxt->frozen_limit = INT_MAX;
+  cxt->binding_count = 0;
   scope_recurse(cxt);
   return cxt;
 }
@@ -239,59 +365,135 @@ type_cxt_t *type_sys_init() {
 void type_sys_free(type_cxt_t *cxt) {
   while(scope_numlevel(cxt)) scope_decurse(cxt); // First pop all scopes
   stack_free(cxt->scopes);
+  for(int i = 0;i < SCOPE_TYPE_COUNT;i++) ht_free(cxt->symbols[i]);
+  ht_free(cxt->canon_types);
+  arena_free(&cxt->arena);
+  arena_free(&cxt->eval_arena);
+  ast_walk_free(&cxt->walk);
+  for(int i = 0;i < TYPE_PRINT_CHANNEL_MAX;i++) if(cxt->print_channels[i]) str_free(cxt->print_channels[i]);
   free(cxt);
 }
 
-hashtable_t *scope_atlevel(type_cxt_t *cxt, int level, int domain) {
-  return ((scope_t *)stack_peek_at(cxt->scopes, stack_size(cxt->scopes) - 1 - level))->names[domain];
+// Names are interned on creation, since keys must outlive the bindings that introduced them
+symbol_t *scope_symbol(type_cxt_t *cxt, int domain, char *name, int create) {
+  assert(domain >= 0 && domain < SCOPE_TYPE_COUNT);
+  symbol_t *symbol = (symbol_t *)ht_find(cxt->symbols[domain], name);
+  if(symbol != HT_NOTFOUND) return symbol;
+  if(!create) return NULL;
+  size_t len = strlen(name);
+  symbol = (symbol_t *)arena_alloc(&cxt->arena, sizeof(symbol_t) + len + 1);
+  symbol->name = (char *)(symbol + 1);
+  memcpy(symbol->name, name, len + 1);
+  symbol->head = NULL;
+  ht_insert(cxt->symbols[domain], symbol->name, symbol);
+  return symbol;
 }
-hashtable_t *scope_top_name(type_cxt_t *cxt, int domain) { return ((scope_t *)stack_peek_at(cxt->scopes, 0))->names[domain]; }
+
 int scope_numlevel(type_cxt_t *cxt) { return stack_size(cxt->scopes); }
 void scope_recurse(type_cxt_t *cxt) { stack_push(cxt->scopes, scope_init(scope_numlevel(cxt))); }
-void scope_decurse(type_cxt_t *cxt) { scope_free(stack_pop(cxt->scopes)); }
+
+// Bindings of the scope are unlinked in reverse order, which restores the shadowed ones
+void scope_decurse(type_cxt_t *cxt) { 
+  scope_t *scope = (scope_t *)stack_pop(cxt->scopes);
+  for(binding_t *binding = scope->log;binding != NULL;binding = binding->log_next) {
+    if(binding->symbol->head == binding) binding->symbol->head = binding->shadowed; // Not removed
+  }
+  scope_free(scope); 
+}
+
+// Does nothing if the name already exists in the topmost scope
 void scope_top_insert(type_cxt_t *cxt, int domain, void *key, void *value) { 
-  ht_insert(scope_top_name(cxt, domain), key, value); 
+  scope_t *scope = (scope_t *)stack_peek_at(cxt->scopes, 0);
+  symbol_t *symbol = scope_symbol(cxt, domain, (char *)key, 1);
+  if(symbol->head != NULL && symbol->head->level == scope->level) return;
+  binding_t *binding = (binding_t *)scope_top_obj_alloc(cxt, OBJ_BINDING, sizeof(binding_t));
+  binding->value = value;
+  binding->level = scope->level;
+  binding->shadowed = symbol->head;
+  binding->symbol = symbol;
+  binding->seq = cxt->binding_count++;
+  binding->log_next = scope->log;
+  scope->log = binding;
+  symbol->head = binding;
+  return;
 }
 
 void *scope_top_remove(type_cxt_t *cxt, int domain, void *key) {
-  void *ht_ret = ht_remove(scope_top_name(cxt, domain), key);
-  return ht_ret == HT_NOTFOUND ? NULL : ht_ret;
+  symbol_t *symbol = scope_symbol(cxt, domain, (char *)key, 0);
+  if(symbol == NULL || symbol->head == NULL || symbol->head->level != scope_numlevel(cxt) - 1) return NULL;
+  binding_t *binding = symbol->head;
+  symbol->head = binding->shadowed; // Stays in the log, and is skipped on decurse
+  return binding->value;
 }
 
 // Return NULL if the key does not exist in the domain
 void *scope_top_find(type_cxt_t *cxt, int domain, void *key) { 
-  void *ht_ret = ht_find(scope_top_name(cxt, domain), key); 
-  return ht_ret == HT_NOTFOUND ? NULL : ht_ret;
+  symbol_t *symbol = scope_symbol(cxt, domain, (char *)key, 0);
+  if(symbol == NULL || symbol->head == NULL || symbol->head->level != scope_numlevel(cxt) - 1) return NULL;
+  return symbol->head->value;
 }
 
-// Searches all levels of scopes and return the first one; return NULL if not found
+// Returns the innermost binding of the name with a single probe; If not found, the frozen global
+// context is searched, which is safe to share between threads since it is not modified; NULL if not found
+// Frozen bindings made at or after frozen_limit are skipped, such that a body checked out of order 
+// only sees globals declared before it, as if it were checked in source order
 void *scope_search(type_cxt_t *cxt, int domain, void *name) {
-  assert(domain >= 0 && domain < SCOPE_TYPE_COUNT && scope_numlevel(cxt) > 0);
-  for(int level = scope_numlevel(cxt) - 1;level >= 0;level--) {
-    void *value = ht_find(scope_atlevel(cxt, level, domain), name);
-    if(value != HT_NOTFOUND) return value;
+  assert(scope_numlevel(cxt) > 0);
+  symbol_t *symbol = scope_symbol(cxt, domain, (char *)name, 0);
+  if(symbol == NULL || symbol->head == NULL) {
+    if(cxt->frozen_global == NULL) return NULL;
+    symbol = scope_symbol(cxt->frozen_global, domain, (char *)name, 0);
+    if(symbol == NULL || symbol->head == NULL || symbol->head->seq >= cxt->frozen_limit) return NULL;
   }
-  return NULL;
+  return symbol->head->value;
 }
 
-void scope_top_obj_insert(type_cxt_t *cxt, int domain, void *obj) {
-  assert(domain >= 0 && domain < OBJ_TYPE_COUNT);
-  list_t *list = (list_t *)((scope_t *)stack_peek_at(cxt->scopes, 0))->objs[domain];
-  list_insert(list, NULL, obj);
+// Objects are not initialized
+void *scope_top_obj_alloc(type_cxt_t *cxt, int kind, size_t size) {
+  assert(kind >= 0 && kind < OBJ_TYPE_COUNT);
+  size = arena_round(sizeof(obj_header_t) + size);
+  obj_header_t *header = (obj_header_t *)arena_alloc(&((scope_t *)stack_peek_at(cxt->scopes, 0))->arena, size);
+  header->kind = kind;
+  header->size = (int)size;
+  return header + 1;
 }
 
-// NOTE: This function DOES NOT initialize arg_list and arg_index, because they may be used for other purposes
+// NOTE: Argument arrays are allocated by type_gettype() after the arguments are counted
 type_t *type_init(type_cxt_t *cxt) {
-  type_t *type = (type_t *)malloc(sizeof(type_t));
-  SYSEXPECT(type != NULL);
+  type_t *type = (type_t *)scope_top_obj_alloc(cxt, OBJ_TYPE, sizeof(type_t));
   memset(type, 0x00, sizeof(type_t));
   type->bitfield_size = -1;
-  scope_top_obj_insert(cxt, OBJ_TYPE, type);
+  mem_stat_add(MEM_TYPE, 1, sizeof(type_t));
   return type;
 }
 
+// Hashes the argument types of a function type, such that type_cmp() returns TYPE_CMP_EQ only if hashes are equal
+// Only covers properties that type_cmp() checks; Argument types must have been fully constructed
+hashval_t type_arg_hash(type_t *type) {
+  assert(TYPE_OP_GET(type->decl_prop) == TYPE_OP_FUNC_CALL);
+  hashval_t hashval = (hashval_t)type->arg_count * 31 + (hashval_t)type->vararg;
+  for(int i = 0;i < type->arg_count;i++) {
+    for(type_t *t = type->arg_types[i];t != NULL;t = t->next) {
+      decl_prop_t op = TYPE_OP_GET(t->decl_prop);
+      decl_prop_t base = BASETYPE_GET(t->decl_prop);
+      if(op == TYPE_OP_FUNC_CALL) { // Qualifiers of function types are ignored by type_cmp()
+        hashval = hashval * 31 + (hashval_t)op;
+        hashval = hashval * 31 + t->arg_hash;
+        continue;
+      }
+      hashval = hashval * 31 + (hashval_t)(t->decl_prop & (TYPE_OP_MASK | BASETYPE_MASK | DECL_QUAL_MASK));
+      if(op == TYPE_OP_ARRAY_SUB) hashval = hashval * 31 + (hashval_t)t->array_size;
+      else if(op == TYPE_OP_NONE && (base == BASETYPE_STRUCT || base == BASETYPE_UNION)) 
+        hashval = hashval * 31 + (hashval_t)(uintptr_t)t->comp;
+      else if(op == TYPE_OP_NONE && base == BASETYPE_ENUM) hashval = hashval * 31 + (hashval_t)(uintptr_t)t->enu;
+    }
+  }
+  return hashval;
+}
+
 // Init a type object from a given object (only shallow copy); Do not set offset field
-// Type objects must not be shared because we assign offsets for better error reporting
+// Declared types are not shared because we assign offsets for better error reporting, and array sizes 
+// may be completed later. Derived types are shared through type_canon()
 type_t *type_init_from(type_cxt_t *cxt, type_t *from, char *offset) {
   type_t *ret = type_init(cxt);
   memcpy(ret, from, sizeof(type_t));
@@ -301,27 +503,67 @@ type_t *type_init_from(type_cxt_t *cxt, type_t *from, char *offset) {
   return ret;
 }
 
-void type_free(void *ptr) {
-  type_t *type = (type_t *)ptr;
-  if(TYPE_OP_GET(type->decl_prop) == TYPE_OP_FUNC_CALL) {
-    list_free(type->arg_list);
-    bt_free(type->arg_index);
+// Only fields that are compared by type_eq_cb() are hashed. Types in the table are canonical, so the
+// next type is hashed by its address
+hashval_t type_hash_cb(void *a) {
+  type_t *type = (type_t *)a;
+  hashval_t hashval = (hashval_t)type->decl_prop * 31 + (hashval_t)(uintptr_t)type->next;
+  if(TYPE_OP_GET(type->decl_prop) == TYPE_OP_ARRAY_SUB) hashval = hashval * 31 + (hashval_t)type->array_size;
+  return hashval * 31 + (hashval_t)type->size;
+}
+
+int type_eq_cb(void *a, void *b) {
+  type_t *type1 = (type_t *)a, *type2 = (type_t *)b;
+  if(type1->decl_prop != type2->decl_prop || type1->next != type2->next || type1->size != type2->size) return 0;
+  return TYPE_OP_GET(type1->decl_prop) != TYPE_OP_ARRAY_SUB || type1->array_size == type2->array_size;
+}
+
+// Returns the canonical object of the type, which is structurally identical and shared by all users, 
+// such that identical types can be compared by pointer. Argument may be a temporary object
+// Returns NULL for types that cannot be shared: Composite, enum, bit field, function, typedef'ed types 
+// and types derived from them. Canonical types carry no source offset and must not be modified
+type_t *type_canon(type_cxt_t *cxt, type_t *type) {
+  decl_prop_t op = TYPE_OP_GET(type->decl_prop);
+  if(type->udef_name != NULL) return NULL;
+  type_t key;
+  memset(&key, 0x00, sizeof(type_t));
+  key.decl_prop = type->decl_prop;
+  key.size = type->size;
+  if(op == TYPE_OP_NONE) {
+    decl_prop_t base = BASETYPE_GET(type->decl_prop);
+    if(base != BASETYPE_VOID && (base < BASETYPE_CHAR || base > BASETYPE_ULLONG)) return NULL;
+  } else if(op == TYPE_OP_DEREF || op == TYPE_OP_ARRAY_SUB) {
+    key.next = type_canon(cxt, type->next);
+    if(key.next == NULL) return NULL;
+    if(op == TYPE_OP_ARRAY_SUB) key.array_size = type->array_size;
+  } else {
+    return NULL;
   }
-  free(type);
+  type_t *ret = (type_t *)ht_find(cxt->canon_types, &key);
+  if(ret != HT_NOTFOUND) return ret;
+  ret = (type_t *)arena_alloc(&cxt->arena, sizeof(type_t));
+  memcpy(ret, &key, sizeof(type_t));
+  ht_insert(cxt->canon_types, ret, ret);
+  return ret;
+}
+
+void type_free(void *ptr) {
+  (void)ptr; // Argument arrays are freed with the scope
+  mem_stat_add(MEM_TYPE, -1, -(long)sizeof(type_t));
 }
 
 comp_t *comp_init(type_cxt_t *cxt, char *name, char *source_offset, int has_definition) {
-  comp_t *comp = (comp_t *)malloc(sizeof(comp_t));
-  SYSEXPECT(comp != NULL);
+  comp_t *comp = (comp_t *)scope_top_obj_alloc(cxt, OBJ_COMP, sizeof(comp_t));
   memset(comp, 0x00, sizeof(comp_t));
   comp->source_offset = source_offset;
   comp->name = name;
   comp->has_definition = has_definition;
   comp->field_list = list_init();
   comp->field_index = bt_str_init();
+  comp->align = 1;
   if(!has_definition) comp->size = TYPE_UNKNOWN_SIZE; // Forward declaration
   else comp->size = 0;
-  scope_top_obj_insert(cxt, OBJ_COMP, comp);
+  mem_stat_add(MEM_COMP, 1, sizeof(comp_t));
   return comp;
 }
 
@@ -329,29 +571,27 @@ void comp_free(void *ptr) {
   comp_t *comp = (comp_t *)ptr;
   list_free(comp->field_list);
   bt_free(comp->field_index);
-  free(comp);
+  mem_stat_add(MEM_COMP, -1, -(long)sizeof(comp_t));
 }
 
 field_t *field_init(type_cxt_t *cxt) {
-  field_t *f = (field_t *)malloc(sizeof(field_t));
-  SYSEXPECT(f != NULL);
+  field_t *f = (field_t *)scope_top_obj_alloc(cxt, OBJ_FIELD, sizeof(field_t));
   memset(f, 0x00, sizeof(field_t));
-  scope_top_obj_insert(cxt, OBJ_FIELD, f);
+  mem_stat_add(MEM_FIELD, 1, sizeof(field_t));
   return f;
 }
 
 void field_free(void *ptr) {
-  free(ptr);
+  mem_stat_add(MEM_FIELD, -1, -(long)sizeof(field_t));
 }
 
 enum_t *enum_init(type_cxt_t *cxt) {
-  enum_t *e = (enum_t *)malloc(sizeof(enum_t));
-  SYSEXPECT(e != NULL);
+  enum_t *e = (enum_t *)scope_top_obj_alloc(cxt, OBJ_ENUM, sizeof(enum_t));
   memset(e, 0x00, sizeof(enum_t));
   e->field_list = list_init();
   e->field_index = bt_str_init();
   e->size = TYPE_INT_SIZE;   // Enum always has integer size
-  scope_top_obj_insert(cxt, OBJ_ENUM, e);
+  mem_stat_add(MEM_ENUM, 1, sizeof(enum_t));
   return e;
 }
 
@@ -359,21 +599,20 @@ void enum_free(void *ptr) {
   enum_t *e = (enum_t *)ptr;
   list_free(e->field_list);
   bt_free(e->field_index);
-  free(e);
+  mem_stat_add(MEM_ENUM, -1, -(long)sizeof(enum_t));
 }
 
 value_t *value_init(type_cxt_t *cxt) {
-  value_t *value = (value_t *)malloc(sizeof(value_t));
-  SYSEXPECT(value != NULL);
+  value_t *value = (value_t *)scope_top_obj_alloc(cxt, OBJ_VALUE, sizeof(value_t));
   memset(value, 0x00, sizeof(value_t));
-  scope_top_obj_insert(cxt, OBJ_VALUE, value);
+  mem_stat_add(MEM_VALUE, 1, sizeof(value_t));
   return value;
 }
 
 void value_free(void *ptr) {
   value_t *value = (value_t *)ptr;
   if(value->pending_list) list_free(value->pending_list);
-  free(ptr);
+  mem_stat_add(MEM_VALUE, -1, -(long)sizeof(value_t));
 }
 
 // If the decl node does not have a T_BASETYPE node as first child (i.e. first child T_)
@@ -419,7 +658,7 @@ type_t *type_gettype(type_cxt_t *cxt, token_t *decl, token_t *basetype, uint32_t
     curr_type->size = TYPE_INT_SIZE;
   } else if(basetype_type == BASETYPE_UDEF) { // Just directly use the udef'ed type
     token_t *udef_name = ast_getchild(basetype, 0);
-    assert(udef_name && udef_name->type == T_IDENT);
+    assert(udef_name && udef_name->type == T_UDEF);
     curr_type = (type_t *)scope_search(cxt, SCOPE_UDEF, udef_name->str); // May return a struct with or without def
     assert(curr_type); // Must exist because otherwise parser will not tag this as UDEF name
   } else { // This branch is for primitive base types
@@ -456,9 +695,9 @@ type_t *type_gettype(type_cxt_t *cxt, token_t *decl, token_t *basetype, uint32_t
       assert(index);
       if(index->type != T_) {
         value_t *array_size_value = eval_const_exp(cxt, index);
-        if(!type_is_int(array_size_value->type)) {
+        if(!type_is_int(array_size_value->type) && !type_is_error(array_size_value->type)) { // Error values are zero
           error_row_col_exit(index->offset, "Array size in declaration must be of integer type\n");
-        } else if(array_size_value->uint32 != array_size_value->uint64) {
+        } else if(array_size_value->uint32 != array_size_value->uint128) {
           error_row_col_exit(index->offset, "Array size too large to be represented by 32 bit int\n");
         } else if(array_size_value->int32 < 0) {
           error_row_col_exit(index->offset, "Array size in declaration must be non-negative\n");
@@ -475,10 +714,14 @@ type_t *type_gettype(type_cxt_t *cxt, token_t *decl, token_t *basetype, uint32_t
         error_row_col_exit(curr_type->offset, "Function call return value cannot be const or volatile\n");
       parent_type->decl_prop |= TYPE_OP_FUNC_CALL;
       parent_type->size = TYPE_FUNC_SIZE; // Function object is different from function pointer
-      parent_type->arg_list = list_init();
-      parent_type->arg_index = bt_str_init();
       type_t *arg_type;
       token_t *arg_decl = ast_getchild(op, 1);
+      int arg_max = 0;
+      for(token_t *t = arg_decl;t != NULL;t = t->sibling) arg_max++;
+      if(arg_max) { // Upper bound, may include "..." or void
+        parent_type->arg_types = (type_t **)scope_top_obj_alloc(cxt, OBJ_ARGS, sizeof(type_t *) * (size_t)arg_max);
+        parent_type->arg_names = (char **)scope_top_obj_alloc(cxt, OBJ_ARGS, sizeof(char *) * (size_t)arg_max);
+      }
       int arg_num = 0;
       while(arg_decl) {
         assert(arg_decl->type == T_DECL || arg_decl->type == T_ELLIPSIS);
@@ -500,13 +743,16 @@ type_t *type_gettype(type_cxt_t *cxt, token_t *decl, token_t *basetype, uint32_t
           else if(arg_name->type != T_) { error_row_col_exit(op->offset, "\"void\" argument must be anonymous\n"); }
           else break;
         }
-        if(arg_name->type != T_) { // Insert into the index if the arg has a name
-          void *bt_ret = bt_insert(parent_type->arg_index, arg_name->str, arg_type);
-          if(bt_ret != arg_type) error_row_col_exit(op->offset, "Duplicated argument name \"%s\"\n", arg_name->str);
+        if(arg_name->type != T_) { // Argument lists are short, so a linear scan is cheaper than an index
+          for(int i = 0;i < parent_type->arg_count;i++) 
+            if(parent_type->arg_names[i] && strcmp(parent_type->arg_names[i], arg_name->str) == 0) 
+              error_row_col_exit(op->offset, "Duplicated argument name \"%s\"\n", arg_name->str);
         }
-        list_insert(parent_type->arg_list, arg_name->str, arg_type); // May insert NULL as key
+        parent_type->arg_names[parent_type->arg_count] = arg_name->type != T_ ? arg_name->str : NULL;
+        parent_type->arg_types[parent_type->arg_count++] = arg_type;
         arg_decl = arg_decl->sibling;
       }
+      parent_type->arg_hash = type_arg_hash(parent_type);
     } // if(current op is function call)
     curr_type = parent_type;
     op = ast_getchild(op, 0); // To the next op (i.e. the op that should be eval'ed before current one)
@@ -564,9 +810,8 @@ comp_t *type_getcomp(type_cxt_t *cxt, token_t *token, int is_forward) {
     return comp;
   }
 
-  int curr_offset = 0; // Current entry offset (always 0 for unions)
-  size_t max_size = 0;    // Maximum member, only used for unions
-  field_t *prev_field = NULL; // Used to coalesce bitfield; Declare outermost because it can take effect across declarations
+  size_t bit_offset = 0; // Next free bit (always 0 for unions)
+  size_t end = 0;        // End of the storage of all fields, before tail padding
   while(entry) { 
     assert(entry->type == T_COMP_DECL);
     token_t *basetype = ast_getchild(entry, 0); // This will be repeatedly used
@@ -592,9 +837,9 @@ comp_t *type_getcomp(type_cxt_t *cxt, token_t *token, int is_forward) {
         if(!type_is_int(f->type))  // Check whether base type is integer
           error_row_col_exit(bf->offset, "Bit field can only be defined with integers\n");
         value_t *bf_size_value = eval_const_exp(cxt, ast_getchild(bf, 0));
-        if(!type_is_int(bf_size_value->type)) {
+        if(!type_is_int(bf_size_value->type) && !type_is_error(bf_size_value->type)) { // Error values are zero
           error_row_col_exit(bf->offset, "Bit field size in declaration must be of integer type\n");
-        } else if(bf_size_value->uint32 != bf_size_value->uint64) {
+        } else if(bf_size_value->uint32 != bf_size_value->uint128) {
           error_row_col_exit(bf->offset, "Bit field size too large to be represented by 32 bit int\n");
         } else if(bf_size_value->int32 < 0) {
           error_row_col_exit(bf->offset, "Bit field size in declaration must be non-negative\n");
@@ -613,11 +858,36 @@ comp_t *type_getcomp(type_cxt_t *cxt, token_t *token, int is_forward) {
         f->bitfield_size = f->bitfield_offset = -1; 
       }
       
-      f->offset = curr_offset; // Set size and offset (currently no alignment)
       f->size = f->type->size;
       if(f->size == TYPE_UNKNOWN_SIZE) // If there is no name then the T_COMP_FIELD has no offset
         error_row_col_exit(f->name ? f->source_offset : basetype->offset, 
           "Struct or union member \"%s\" is incomplete type\n", type_printable_name(f->name));
+
+      // System V x86-64 layout:
+      // (1) Fields start at the next offset aligned to their type; Union fields all start at offset 0
+      // (2) Bit fields start at the next free bit, unless they would straddle a unit of their integer 
+      //     type, in which case they start at the next unit. Adjacent bit fields are packed in this way
+      //     even if their types differ. Zero sized bit fields also start a new unit
+      // (3) Bit fields are stored in the unit of their integer type that contains them, from lower bits
+      //     to higher bits; The offset of the field is that of the unit
+      // (4) The struct is aligned to its most aligned field, except unnamed bit fields, and its size is
+      //     padded to the alignment
+      size_t align = type_alignof(f->type);
+      if(f->bitfield_size == -1) {
+        f->offset = (int)type_align_up((bit_offset + 7) / 8, align);
+        bit_offset = (f->offset + f->size) * 8;
+      } else {
+        size_t unit_bits = f->size * 8;
+        if(f->bitfield_size == 0 || bit_offset / unit_bits != (bit_offset + f->bitfield_size - 1) / unit_bits)
+          bit_offset = type_align_up(bit_offset, unit_bits);
+        f->offset = (int)(bit_offset / unit_bits * f->size);
+        f->type->bitfield_offset = f->bitfield_offset = (int)(bit_offset - f->offset * 8);
+        bit_offset += f->bitfield_size;
+        if(f->name == NULL) align = 1;
+      }
+      if(comp->align < align) comp->align = align;
+      if(end < (bit_offset + 7) / 8) end = (bit_offset + 7) / 8;
+      if(token->type != T_STRUCT) bit_offset = 0;
       
       if(f->name) { // Only insert if there is a name; 
         if(bt_insert(comp->field_index, f->name, f) != f) {
@@ -630,6 +900,7 @@ comp_t *type_getcomp(type_cxt_t *cxt, token_t *token, int is_forward) {
           if(f->type->comp->name)   // Could not declare struct { struct named_struct { ... } ; } which is confusing
             error_row_col_exit(f->type->comp->source_offset, "Please do not declare named struct with anonymous variables\n");
           decl_prop_t qual = f->type->decl_prop & DECL_QUAL_MASK; // OR'ed onto every field's decl prop
+          comp->has_anon = 1;
           listnode_t *promote_head = list_head(f->type->comp->field_list);
           while(promote_head) {
             char *promote_name = list_key(promote_head);
@@ -641,62 +912,31 @@ comp_t *type_getcomp(type_cxt_t *cxt, token_t *token, int is_forward) {
               }
             }
             promote_field->type->decl_prop |= qual; // Inherit from including comp type's qualifiers
-            promote_field->offset += curr_offset;   // Offset by the current position
+            promote_field->offset += f->offset;     // Offset by the position of the anonymous field
             list_insert(comp->field_list, promote_name, promote_field);
             promote_head = list_next(promote_head);
           }
         } else { list_insert(comp->field_list, NULL, f); } // Anonymous non-comp field, insert
       }
       
-      if(token->type == T_STRUCT) {
-        //printf("%s %d\n", f->name, f->bitfield_size);
-        // Non-Bit field always increments the offset; This works also for promoted types
-        // Bit field coalesce rules:
-        // (1) Adjacent entries of the same integer type will be coalesced; If they cannot be packed into the 
-        //     declared base type, we leave a gap and start a new field;
-        // (2) Different types (incl. sign difference) are never coalesced;
-        // (3) Packed fields are arranged from lower bits to higher bits; Unused bits will be ignored
-        // (4) Coalesced bit fields take the storage identical to the base type
-        if(!prev_field) { // First entry in struct
-          if(f->bitfield_size != -1) f->type->bitfield_offset = f->bitfield_offset = 0;
-          curr_offset += f->type->size;
-        } else if(f->bitfield_size == -1 && prev_field->bitfield_size == -1) {
-          curr_offset += f->type->size; // Both normal fields; size has been set above
-        } else if(f->bitfield_size == -1 && prev_field->bitfield_size != -1) {
-          curr_offset += f->type->size;
-        } else if(f->bitfield_size != -1 && prev_field->bitfield_size == -1) {
-          f->type->bitfield_offset = f->bitfield_offset = 0; // Starting a bit field (may potentially have more later)
-          curr_offset += f->type->size;
-        } else { // Both are valid bitfields - try to coalesce!
-          assert(f->bitfield_size != -1 && prev_field->bitfield_size != -1);
-          //printf("%s %s %d %d\n", prev_field->name, f->name, prev_field->bitfield_size, f->bitfield_size);
-          // If types differ, start a new bit field
-          if(BASETYPE_GET(prev_field->type->decl_prop) != BASETYPE_GET(f->type->decl_prop)) {
-            f->type->bitfield_offset = f->bitfield_offset = 0;
-            curr_offset += prev_field->type->size;
-          } else if(prev_field->bitfield_offset + prev_field->bitfield_size + f->bitfield_size <= (int)prev_field->size * 8) {
-            f->offset = prev_field->offset; 
-            f->type->bitfield_offset = f->bitfield_offset = prev_field->bitfield_offset + prev_field->bitfield_size;
-          } else {
-            f->offset = prev_field->offset + prev_field->type->size; 
-            f->type->bitfield_offset = f->bitfield_offset = 0;
-            curr_offset += f->type->size;
-          }
-        }
-      } else if(max_size < f->type->size) {
-        max_size = f->type->size;
-      }
-      
       field = field->sibling;
-      prev_field = f;
     } // while(field)
     entry = entry->sibling;
   }
-  if(token->type == T_STRUCT) comp->size = (size_t)curr_offset;
-  else comp->size = max_size;                            // Size of union is the maximum of all types
+  comp->size = type_align_up(end, comp->align); // Tail padding
   return comp;
 }
 
+// Returns the alignment of a type under System V x86-64; Integers, enums and bit fields are aligned
+// to their size, arrays to their elements and composites to their most aligned field
+size_t type_alignof(type_t *type) {
+  while(type_is_array(type)) type = type->next;
+  if(type_is_comp(type)) return type->comp->align;
+  else if(type_is_ptr(type)) return TYPE_PTR_SIZE;
+  else if(type_is_func(type) || type->size == TYPE_UNKNOWN_SIZE || type->size == 0) return 1;
+  return type->size;
+}
+
 // TODO: FORWARD DECL OF ENUM / ENUM TYPED VARIABLES
 enum_t *type_getenum(type_cxt_t *cxt, token_t *token) {
   assert(token->type == T_ENUM);
@@ -715,9 +955,9 @@ enum_t *type_getenum(type_cxt_t *cxt, token_t *token) {
     token_t *enum_exp = ast_getchild(field, 1);
     if(enum_exp) {
       value_t *enum_value = eval_const_exp(cxt, enum_exp);
-      if(!type_is_int(enum_value->type)) {
+      if(!type_is_int(enum_value->type) && !type_is_error(enum_value->type)) { // Error values are zero
         error_row_col_exit(enum_exp->offset, "Enum constant must be of integer type\n");
-      } else if(enum_value->uint32 != enum_value->uint64) {
+      } else if(enum_value->uint32 != enum_value->uint128) {
         error_row_col_exit(enum_exp->offset, "Enum constant value too large to be represented by 32 bit int\n");
       } 
       curr_value = enum_value->int32;
@@ -781,6 +1021,7 @@ type_t *type_int_convert(type_t *lhs, type_t *rhs) {
 //   4. If two types differ in their derivation chain and/or base types, return TYPE_CMP_NEQ
 // This function does not treat array and deref as the same type; Caller should be aware
 int type_cmp(type_t *to, type_t *from) {
+  if(to == from) return TYPE_CMP_EQ; // Always the case for identical canonical types
   decl_prop_t base1, base2;
   int const_flag, volatile_flag, lossy_flag, eq_flag;
   decl_prop_t op1 = TYPE_OP_GET(to->decl_prop);
@@ -794,7 +1035,7 @@ int type_cmp(type_t *to, type_t *from) {
   volatile_flag = !(to->decl_prop & DECL_VOLATILE_MASK) && (from->decl_prop & DECL_VOLATILE_MASK);
   lossy_flag = const_flag || volatile_flag; // Set to 1 if RHS is more strict than LHS
   eq_flag = (to->decl_prop & DECL_QUAL_MASK) == (from->decl_prop & DECL_QUAL_MASK);
-  //printf("eq flag = %d from %s to %s\n", eq_flag, type_print_str(0, from, NULL, 0), type_print_str(1, to, NULL, 0));
+  //printf("eq flag = %d from %s to %s\n", eq_flag, type_print_str(cxt, 0, from, NULL, 0), type_print_str(cxt, 1, to, NULL, 0));
   assert(!eq_flag || !lossy_flag); // At most one can be 1
 
   // Base type, end of recursion
@@ -818,15 +1059,10 @@ int type_cmp(type_t *to, type_t *from) {
       if(to->array_size != from->array_size) return TYPE_CMP_NEQ;
     } else if(op1 == TYPE_OP_FUNC_CALL) { // Compare argument - must be strictly identical, not even compatible
       if(to->vararg != from->vararg) return TYPE_CMP_NEQ; // Vararg functions must match
-      if(list_size(to->arg_list) != list_size(from->arg_list)) return TYPE_CMP_NEQ; // Argument number
-      listnode_t *to_arg = list_head(to->arg_list);
-      listnode_t *from_arg = list_head(from->arg_list);
-      while(to_arg && from_arg) {
-        int ret = type_cmp((type_t *)list_value(to_arg), (type_t *)list_value(from_arg));
-        if(ret != TYPE_CMP_EQ) return TYPE_CMP_NEQ; // Args must be strictly equal
-        to_arg = list_next(to_arg);
-        from_arg = list_next(from_arg);
-      }
+      if(to->arg_count != from->arg_count) return TYPE_CMP_NEQ; // Argument number
+      if(to->arg_hash != from->arg_hash) return TYPE_CMP_NEQ; // Equal signatures always have equal hashes
+      for(int i = 0;i < to->arg_count;i++) 
+        if(type_cmp(to->arg_types[i], from->arg_types[i]) != TYPE_CMP_EQ) return TYPE_CMP_NEQ; // Args must be strictly equal
     }
     int ret = type_cmp(to->next, from->next); 
     if(op1 != TYPE_OP_FUNC_CALL) {
@@ -870,12 +1106,16 @@ int type_cmp(type_t *to, type_t *from) {
 //             to const; Same applies to volatile
 //   *.* Casting from const to non-const implicitly is prohibited for all types
 // See TYPE_CAST_ series for return values
-// This function will report error and exit if an error is detected
+// This function will report error and exit if an error is detected, unless errors are collected, in which 
+// case it returns TYPE_CAST_INVALID; Casting from or to the error type is silently a no-op
 int type_cast(type_t *to, type_t *from, int cast_type, char *offset) {
   assert(cast_type == TYPE_CAST_EXPLICIT || cast_type == TYPE_CAST_IMPLICIT);
   // Handle easy cases first:
-  if(type_is_void(from)) {  // Case 7: from void
-    error_row_col_exit(offset, "Casting void type is disallowed\n"); 
+  if(type_is_error(to) || type_is_error(from)) { // Already reported
+    return TYPE_CAST_NO_OP;
+  } else if(type_is_void(from)) {  // Case 7: from void
+    error_row_col_cont(offset, "Casting void type is disallowed\n"); 
+    return TYPE_CAST_INVALID;
   } else if(type_cmp(to, from) == TYPE_CMP_EQ) { // Case 0: self-cast
     return TYPE_CAST_NO_OP; 
   } else if(type_is_void(to)) { // Case 5: to void
@@ -891,8 +1131,10 @@ int type_cast(type_t *to, type_t *from, int cast_type, char *offset) {
     } else {
       int from_sign = type_is_signed(from);
       int to_sign = type_is_signed(to);
-      if(to->size < from->size)
-        error_row_col_exit(offset, "Cannot cast from longer integer type to shorter integer type implicitly\n"); 
+      if(to->size < from->size) {
+        error_row_col_cont(offset, "Cannot cast from longer integer type to shorter integer type implicitly\n");
+        return TYPE_CAST_INVALID;
+      }
       if(to->size == from->size) { // No bit change
         return TYPE_CAST_NO_OP;
       }
@@ -901,31 +1143,49 @@ int type_cast(type_t *to, type_t *from, int cast_type, char *offset) {
       else return TYPE_CAST_ZERO_EXT;
     }
   } else if(type_is_int(to) && type_is_ptr(from)) { // Case 2, one direction
-    if(cast_type != TYPE_CAST_EXPLICIT) 
-      error_row_col_exit(offset, "Could not cast pointer to integer implicitly\n");
-    if(type_get_int_size(to) != TYPE_PTR_SIZE) 
-      error_row_col_exit(offset, "Could not cast pointer to integer of different sizes\n");
+    if(cast_type != TYPE_CAST_EXPLICIT) {
+      error_row_col_cont(offset, "Could not cast pointer to integer implicitly\n");
+      return TYPE_CAST_INVALID;
+    }
+    if(type_get_int_size(to) != TYPE_PTR_SIZE) {
+      error_row_col_cont(offset, "Could not cast pointer to integer of different sizes\n");
+      return TYPE_CAST_INVALID;
+    }
     return TYPE_CAST_NO_OP;
   } else if(type_is_ptr(to) && type_is_int(from)) { // Case 2, the other direction
-    if(cast_type != TYPE_CAST_EXPLICIT) 
-      error_row_col_exit(offset, "Could not cast integer to pointer implicitly\n");
-    if(type_get_int_size(from) != TYPE_PTR_SIZE) 
-      error_row_col_exit(offset, "Could not cast integer to pointer of different sizes\n");
+    if(cast_type != TYPE_CAST_EXPLICIT) {
+      error_row_col_cont(offset, "Could not cast integer to pointer implicitly\n");
+      return TYPE_CAST_INVALID;
+    }
+    if(type_get_int_size(from) != TYPE_PTR_SIZE) {
+      error_row_col_cont(offset, "Could not cast integer to pointer of different sizes\n");
+      return TYPE_CAST_INVALID;
+    }
     return TYPE_CAST_NO_OP;
   } else if(type_is_ptr(to) && type_is_array(from)) { // Case 3
     if(type_is_void_ptr(to)) return TYPE_CAST_GEN_PTR; // Case 5
     if(cast_type == TYPE_CAST_IMPLICIT) { // Only check pointed type for compatibility if it is implicit
       int ret = type_cmp(to->next, from); // i.e. to->next should be an array type
-      if(ret == TYPE_CMP_NEQ) { error_row_col_exit(offset, "Cannot cast array to pointer type of different base types\n"); }
-      else if(ret == TYPE_CMP_LOSSY) { error_row_col_exit(offset, "Cannot cast array to incompatible pointer type\n"); }
+      if(ret == TYPE_CMP_NEQ) {
+        error_row_col_cont(offset, "Cannot cast array to pointer type of different base types\n");
+        return TYPE_CAST_INVALID;
+      } else if(ret == TYPE_CMP_LOSSY) {
+        error_row_col_cont(offset, "Cannot cast array to incompatible pointer type\n");
+        return TYPE_CAST_INVALID;
+      }
     }
     return TYPE_CAST_GEN_PTR;
   } else if(type_is_ptr(to) && type_is_ptr(from)) { // Case 4
     if(type_is_void_ptr(to) || type_is_void_ptr(from)) return TYPE_CAST_NO_OP; // Case 4.1
     if(cast_type == TYPE_CAST_IMPLICIT) { // Only check pointed type for compatibility if it is implicit
       int ret = type_cmp(to->next, from->next);
-      if(ret == TYPE_CMP_NEQ) { error_row_col_exit(offset, "Cannot cast between pointers of different base types\n"); }
-      else if(ret == TYPE_CMP_LOSSY) { error_row_col_exit(offset, "Cannot cast pointer to incompatible base types\n"); }
+      if(ret == TYPE_CMP_NEQ) {
+        error_row_col_cont(offset, "Cannot cast between pointers of different base types\n");
+        return TYPE_CAST_INVALID;
+      } else if(ret == TYPE_CMP_LOSSY) {
+        error_row_col_cont(offset, "Cannot cast pointer to incompatible base types\n");
+        return TYPE_CAST_INVALID;
+      }
     }
     return TYPE_CAST_NO_OP;
   } else if(type_is_ptr(to) && type_is_func(from)) { // Case 6
@@ -933,39 +1193,34 @@ int type_cast(type_t *to, type_t *from, int cast_type, char *offset) {
     if(cast_type == TYPE_CAST_IMPLICIT) { // Only check pointed type for compatibility if it is implicit
       int ret = type_cmp(to->next, from); // Note: We compare the function type with the pointer's target type
       assert(ret == TYPE_CMP_EQ || ret == TYPE_CMP_NEQ); // Function type can only return these two results
-      if(ret == TYPE_CMP_NEQ) error_row_col_exit(offset, "Cannot cast function to pointer type of a different prototype\n");
+      if(ret == TYPE_CMP_NEQ) {
+        error_row_col_cont(offset, "Cannot cast function to pointer type of a different prototype\n");
+        return TYPE_CAST_INVALID;
+      }
     }
     return TYPE_CAST_GEN_PTR;
   }
   // All other casts are invalid
-  error_row_col_exit(offset, "Invalid %s type cast\n", cast_type == TYPE_CAST_EXPLICIT ? "explicit" : "implicit");
-  assert(0);
+  error_row_col_cont(offset, "Invalid %s type cast\n", cast_type == TYPE_CAST_EXPLICIT ? "explicit" : "implicit");
   return TYPE_CAST_INVALID;
 }
 
 type_t *type_int_promo(type_cxt_t *cxt, type_t *type) {
   assert(type_is_general_int(type));
   if(type_is_enum(type)) { // enum type is promoted to integer type
-    return type_init_from(cxt, &type_builtin_ints[BASETYPE_INDEX(BASETYPE_INT)], type->offset);
+    return type_getint(BASETYPE_INT);
   } 
-  int need_copy = 0;
   if(type_is_bitfield(type)) { // Do not return in this branch - just convert to its original base type
-    type = &type_builtin_ints[BASETYPE_INDEX(type->bitfield_basetype)];
-    need_copy = 1;
+    type = type_getint(type->bitfield_basetype);
   }
   // Integer promotion: If a type shorter than int type appears in an expression, they are promoted to
   // integer type, regardless of signs
   decl_prop_t basetype = BASETYPE_GET(type->decl_prop);
   switch(basetype) {
     case BASETYPE_CHAR: case BASETYPE_UCHAR: case BASETYPE_SHORT: case BASETYPE_USHORT:
-      type = type_init_from(cxt, &type_builtin_ints[BASETYPE_INDEX(BASETYPE_INT)], type->offset);
+      type = type_getint(BASETYPE_INT);
       break; 
-    default: { // bit field type is longer, but we need to copy it
-      if(need_copy) {
-        type = type_init_from(cxt, type, type->offset); 
-      }
-      break;
-    }
+    default: break;
   }
   return type;
 }
@@ -1024,113 +1279,175 @@ type_t *type_typeof_op(type_cxt_t *cxt, token_type_t op, type_t *op1, type_t *op
   return NULL;
 }
 
+// Returns the number of leading children whose types are needed by type_typeof_node()
+int type_typeof_arity(token_t *exp, void *arg) {
+  uint32_t options = ((type_typeof_arg_t *)arg)->options;
+  if(exp->exp_type != NULL) return 0; // Memoized; Children are not visited
+  if(BASETYPE_GET(exp->decl_prop) || exp->type == T_STR_CONST || exp->type == T_IDENT) return 0;
+  switch(exp->type) {
+    case EXP_ARRAY_SUB: return (options & TYPEOF_IGNORE_ARRAY_INDEX) ? 1 : 2;
+    case EXP_FUNC_CALL: return (options & TYPEOF_IGNORE_FUNC_ARG) ? 1 : ast_child_count(exp);
+    case EXP_COND: return 3;
+    case EXP_DEREF: case EXP_POST_INC: case EXP_PRE_INC: case EXP_PRE_DEC: case EXP_POST_DEC:
+    case EXP_ARROW: case EXP_DOT: case EXP_PLUS: case EXP_MINUS: case EXP_LOGICAL_NOT: case EXP_BIT_NOT:
+    case EXP_SIZEOF: return exp->child->type == T_DECL ? 0 : 1; // Type name operand has no expression type
+    case EXP_CAST: case EXP_ADDR: return 1;
+    default: return 2;
+  }
+}
+
+// Types derived with all checks are memoized on the node; A result that skipped checks on arguments or
+// indices is not, such that a later full check still reports errors in them
+void *type_typeof_visit(token_t *exp, void **results, void *arg) {
+  type_typeof_arg_t *typeof_arg = (type_typeof_arg_t *)arg;
+  if(exp->exp_type != NULL) return exp->exp_type;
+  type_t *type = type_typeof_node(typeof_arg->cxt, exp, (type_t **)results, typeof_arg->options);
+  if(typeof_arg->options == 0) exp->exp_type = type;
+  return type;
+}
+
 // This function evaluates the type of an expression
 // Argument options: see TYPEOF_IGNORE_ series. For functions and arrays we do not need the type of 
 // arguments and index to determine the final type; Caller must not modify the returned type
+// Operands are evaluated in post-order with an explicit stack, such that deeply nested expressions
+// do not overflow the C stack; Leaf nodes are evaluated directly
+type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options) {
+  type_typeof_arg_t arg = {cxt, options};
+  if(type_typeof_arity(exp, &arg) == 0) return (type_t *)type_typeof_visit(exp, NULL, &arg);
+  return (type_t *)ast_postorder(&cxt->walk, exp, type_typeof_arity, type_typeof_visit, &arg);
+}
+
+// Types every outermost expression under the node, such that later phases read the type of any 
+// expression node from exp_type. All names must be visible in the current scope. Returns the number
+// of expressions typed
+int type_annotate(type_cxt_t *cxt, token_t *token) {
+  int count = 0;
+  stack_t *stack = stack_init();
+  stack_push(stack, token);
+  while(!stack_empty(stack)) {
+    token = (token_t *)stack_pop(stack);
+    if(token->type >= EXP_BEGIN && token->type < EXP_END) {
+      type_typeof(cxt, token, 0);
+      count++;
+      continue;
+    }
+    for(token_t *child = token->child;child != NULL;child = child->sibling) stack_push(stack, child);
+  }
+  stack_free(stack);
+  return count;
+}
+
+// Derives the type of a single node given types of its children in the array, the number of which
+// is determined by type_typeof_arity()
 //   1. For literal types, just return their type constant
 //   2. void can be the result of casting, and can be returned
 //   3. Bit fields within a struct returns the bit field type
-type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options) {
+//   4. If errors are collected, an invalid expression evaluates to the error type after reporting
+type_t *type_typeof_node(type_cxt_t *cxt, token_t *exp, type_t **types, uint32_t options) {
   // Leaf types: Integer literal, string literal and identifiers
   if(BASETYPE_GET(exp->decl_prop) >= BASETYPE_CHAR && BASETYPE_GET(exp->decl_prop) <= BASETYPE_ULLONG) {
-    return type_init_from(cxt, &type_builtin_ints[BASETYPE_INDEX(exp->decl_prop)], exp->offset);
+    return type_getint(exp->decl_prop);
   } else if(exp->type == T_STR_CONST) {
     str_t *s = eval_const_str_token(exp);
     size_t sz = str_size(s);
     str_free(s);                             // Do not use its content
-    return type_get_strliteral(cxt, sz + 1, exp->offset); // We reserve one byte for trailing '\0'
+    return type_get_strliteral(cxt, sz + 1); // We reserve one byte for trailing '\0'
   } else if(BASETYPE_GET(exp->decl_prop)) {  // Unsupported base type literal
     type_error_not_supported(exp->offset, exp->decl_prop);
   } else if(exp->type == T_IDENT) {
     value_t *value = scope_search(cxt, SCOPE_VALUE, exp->str);
-    if(!value) error_row_col_exit(exp->offset, "Name \"%s\" does not exist in current scope\n", exp->str);
+    if(!value) return type_error_cont(exp->offset, "Name \"%s\" does not exist in current scope\n", exp->str);
     return value->type;
   }
 
+  // An operand with an error has been reported; Do not report again for the enclosing expression
+  type_typeof_arg_t arg = {cxt, options};
+  int arity = type_typeof_arity(exp, &arg);
+  for(int i = 0;i < arity;i++) if(type_is_error(types[i])) return &type_builtin_error;
+
   token_type_t op_type = exp->type;
   type_t *lhs, *rhs;
   // Type derivation operators: * -> . () []
   if(op_type == EXP_DEREF) { // Dereference can be applied to both ptr and array type
-    lhs = type_typeof(cxt, ast_getchild(exp, 0), options);
+    lhs = types[0];
     if(TYPE_OP_GET(lhs->decl_prop) != TYPE_OP_DEREF && TYPE_OP_GET(lhs->decl_prop) != TYPE_OP_ARRAY_SUB) 
-      error_row_col_exit(exp->offset, "Operator \'*\' cannot be applied to non-pointer (or array) type\n");
+      return type_error_cont(exp->offset, "Operator \'*\' cannot be applied to non-pointer (or array) type\n");
     return lhs->next;
   } else if(op_type == EXP_ARRAY_SUB) {
-    lhs = type_typeof(cxt, ast_getchild(exp, 0), options);
+    lhs = types[0];
     if(TYPE_OP_GET(lhs->decl_prop) != TYPE_OP_DEREF && TYPE_OP_GET(lhs->decl_prop) != TYPE_OP_ARRAY_SUB) 
-      error_row_col_exit(exp->offset, "Operator \'[]\' cannot be applied to non-array (or pointer) type\n");
+      return type_error_cont(exp->offset, "Operator \'[]\' cannot be applied to non-array (or pointer) type\n");
     if(!(options & TYPEOF_IGNORE_ARRAY_INDEX)) {
       token_t *index_token = ast_getchild(exp, 1);
       assert(index_token);
-      type_t *index_type = type_typeof(cxt, index_token, options);
+      type_t *index_type = types[1];
       if(!type_is_general_int(index_type)) 
-        error_row_col_exit(index_token->offset, "Array index must be of one of the integral types\n");
+        return type_error_cont(index_token->offset, "Array index must be of one of the integral types\n");
     }
     return lhs->next;
   } else if(op_type == EXP_FUNC_CALL) { // Function call operator will dereference the ptr implicitly
     token_t *func_token = ast_getchild(exp, 0);
-    lhs = type_typeof(cxt, func_token, options);
+    lhs = types[0];
     if(!type_is_func(lhs) && !type_is_func_ptr(lhs)) 
-      error_row_col_exit(func_token->offset, "Function call must be applied to function of function pointer\n");
+      return type_error_cont(func_token->offset, "Function call must be applied to function of function pointer\n");
     if(type_is_func_ptr(lhs)) lhs = lhs->next;
     // Invariant: after this line, lhs is always function call type
     if(!(options & TYPEOF_IGNORE_FUNC_ARG)) {
-      listnode_t *arg = list_head(lhs->arg_list); // Expected type
-      token_t *arg_token;
-      int arg_index = 1; // Index of argument starts at 1 under exp node
-      while(arg) {
-        arg_token = ast_getchild(exp, arg_index); // Actual type
-        if(!arg_token) error_row_col_exit(exp->offset, "Missing argument %d in function call\n", arg_index);
-        type_t *arg_type = type_typeof(cxt, arg_token, options);
-        // This will report error if implicit cast is illegal
-        type_cast(list_value(arg), arg_type, TYPE_CAST_IMPLICIT, arg_token->offset); 
-        arg = list_next(arg);
-        arg_index++;
+      token_t *arg_token = func_token->sibling; // Actual arguments follow the function operand
+      token_t *last_token = func_token;
+      for(int i = 0;i < lhs->arg_count;i++) {
+        if(!arg_token) return type_error_cont(exp->offset, "Missing argument %d in function call\n", i + 1);
+        // This will report error if implicit cast is illegal; Index of argument starts at 1 under exp node
+        type_cast(lhs->arg_types[i], types[i + 1], TYPE_CAST_IMPLICIT, arg_token->offset); 
+        last_token = arg_token;
+        arg_token = arg_token->sibling;
       }
       // If after expected arg list is exhausted there is still argument expression, we have passed too many args
-      if(ast_getchild(exp, arg_index)) error_row_col_exit(arg_token->offset, "Too many arguments to function\n");
+      if(arg_token) return type_error_cont(last_token->offset, "Too many arguments to function\n");
     }
     return lhs->next;
   }
   
+  // Type name operand is checked when the size is evaluated, see eval_const_exp()
+  if(op_type == EXP_SIZEOF && arity == 0) return type_getint(TYPE_SIZEOF_TYPE);
   // Everything down below must have at least one operand whose type is the first child of exp
-  lhs = type_typeof(cxt, ast_getchild(exp, 0), options);
+  lhs = types[0];
   const char *op_str = token_symstr(exp->type);
   switch(op_type) {
     // If applied to integer then result is the same integer, if applied to pointers then result is pointer
     case EXP_POST_INC: case EXP_PRE_INC: case EXP_PRE_DEC: case EXP_POST_DEC: {
       if(type_is_general_int(lhs) || type_is_ptr(lhs)) return lhs;
-      error_row_col_exit(exp->offset, "Invalid operand for \"%s\" operator\n", op_str);
+      return type_error_cont(exp->offset, "Invalid operand for \"%s\" operator\n", op_str);
     } break;
     case EXP_ARROW:
-      if(!type_is_ptr(lhs)) error_row_col_exit(exp->offset, "Operator \"->\" must be applied to pointer types\n");
+      if(!type_is_ptr(lhs)) return type_error_cont(exp->offset, "Operator \"->\" must be applied to pointer types\n");
       lhs = lhs->next;
       /* fall through */
     case EXP_DOT: {
       if(!type_is_comp(lhs)) 
-        error_row_col_exit(exp->offset, "Operator \"%s\" must be applied to composite types\n", op_str);
+        return type_error_cont(exp->offset, "Operator \"%s\" must be applied to composite types\n", op_str);
       comp_t *comp = lhs->comp;
       token_t *field_name_token = ast_getchild(exp, 1);
       assert(field_name_token);
-      if(field_name_token->type != T_IDENT) error_row_col_exit(field_name_token->offset, "Invalid field specifier\n");
+      if(field_name_token->type != T_IDENT) return type_error_cont(field_name_token->offset, "Invalid field specifier\n");
       char *field_name = field_name_token->str;
       void *ret = bt_find(comp->field_index, field_name);
-      if(ret == BT_NOTFOUND) error_row_col_exit(exp->offset, "Composite type has no field \"%s\"\n", field_name);
+      if(ret == BT_NOTFOUND) return type_error_cont(exp->offset, "Composite type has no field \"%s\"\n", field_name);
       return ((field_t *)ret)->type; // If it is a bit field the type object has the field set to -1
     } break;
     case EXP_PLUS: case EXP_MINUS: {
       if(!type_is_general_int(lhs)) 
-        error_row_col_exit(exp->offset, "Operator \"%s\" must be applied to integer types\n", op_str);
+        return type_error_cont(exp->offset, "Operator \"%s\" must be applied to integer types\n", op_str);
       return lhs;
     } break;
     case EXP_LOGICAL_NOT: {
       if(!type_is_general_int(lhs) && !type_is_ptr(lhs)) 
-        error_row_col_exit(exp->offset, "Operator \'!\' must be applied to integer or pointer types\n");
+        return type_error_cont(exp->offset, "Operator \'!\' must be applied to integer or pointer types\n");
       return lhs;
     } break;
     case EXP_BIT_NOT: {
       if(!type_is_general_int(lhs)) 
-        error_row_col_exit(exp->offset, "Operator \'~\' must be applied to integer types\n");
+        return type_error_cont(exp->offset, "Operator \'~\' must be applied to integer types\n");
       return lhs;
     }
     case EXP_CAST: { // For EXP_CAST, lhs is the expression, while RHS is the T_DECL with first child being T_BASETYPE
@@ -1142,8 +1459,15 @@ type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options) {
       return target;
     } break;
     case EXP_ADDR: { // This works even for the two symbol types: ARRAY_SUB and FUNC_CALL
-      if(type_is_bitfield(lhs)) error_row_col_exit(exp->offset, "Cannot take address of bit fields\n");
-      type_t *deref = type_init(cxt);   // Create a new type node
+      if(type_is_bitfield(lhs)) return type_error_cont(exp->offset, "Cannot take address of bit fields\n");
+      type_t key;
+      memset(&key, 0x00, sizeof(type_t));
+      key.decl_prop = TYPE_OP_DEREF;
+      key.next = lhs;
+      key.size = TYPE_PTR_SIZE;
+      type_t *deref = type_canon(cxt, &key);
+      if(deref != NULL) return deref;
+      deref = type_init(cxt);   // Pointer to a type that cannot be shared, e.g. composite
       deref->decl_prop = TYPE_OP_DEREF;
       deref->next = lhs;
       deref->offset = exp->offset;
@@ -1151,8 +1475,8 @@ type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options) {
       return deref;
     } break;
     case EXP_SIZEOF: { // sizeof() operator returns size_t type, which is unsigned long
-      if(type_is_bitfield(lhs)) error_row_col_exit(exp->offset, "Cannot take size of bit fields\n");
-      return type_init_from(cxt, &type_builtin_ints[BASETYPE_INDEX(TYPE_SIZEOF_TYPE)], exp->offset);
+      if(type_is_bitfield(lhs)) return type_error_cont(exp->offset, "Cannot take size of bit fields\n");
+      return type_getint(TYPE_SIZEOF_TYPE);
     } break;
     // Group of operators that just perform an integer convert and check feasibility
     // Optionally cast back to the LHS type for assignment
@@ -1160,7 +1484,7 @@ type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options) {
     case EXP_BIT_AND: case EXP_BIT_OR: case EXP_BIT_XOR: 
     case EXP_MUL_ASSIGN: case EXP_DIV_ASSIGN: case EXP_MOD_ASSIGN: 
     case EXP_AND_ASSIGN: case EXP_OR_ASSIGN: case EXP_XOR_ASSIGN: {
-      rhs = type_typeof(cxt, ast_getchild(exp, 1), options); // Evaluate both left and right operands
+      rhs = types[1]; // Evaluate both left and right operands
       if(type_is_general_int(lhs) && type_is_general_int(rhs)) { // Integer type conversion
         type_t *after_convert = type_int_convert(lhs, rhs);
         // Test whether they could convert, e.g. (int * unsigned int) is invalid because int could not be casted to unsigned int
@@ -1173,13 +1497,13 @@ type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options) {
           return after_convert;
         }
       }
-      error_row_col_exit(exp->offset, "Operator \"%s\" must be applied to integer types", op_str);
+      return type_error_cont(exp->offset, "Operator \"%s\" must be applied to integer types", op_str);
     } break;
     // This group of operators can operate on both pointers and integers
     case EXP_ADD: case EXP_SUB: 
     case EXP_ADD_ASSIGN: case EXP_SUB_ASSIGN: {
       // Copied from above
-      rhs = type_typeof(cxt, ast_getchild(exp, 1), options); 
+      rhs = types[1]; 
       if(type_is_general_int(lhs) && type_is_general_int(rhs)) { 
         type_t *after_convert = type_int_convert(lhs, rhs);
         type_cast(after_convert, lhs, TYPE_CAST_IMPLICIT, ast_getchild(exp, 0)->offset);
@@ -1193,26 +1517,26 @@ type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options) {
       } else if(type_is_ptr(lhs) && type_is_general_int(rhs)) {
         return lhs;
       } else if(op_type == EXP_SUB && type_is_ptr(lhs) && type_is_ptr(rhs)) { // Pointer subtraction
-        if(type_is_void_ptr(lhs) || type_is_void_ptr(rhs)) error_row_col_exit(exp->offset,
+        if(type_is_void_ptr(lhs) || type_is_void_ptr(rhs)) return type_error_cont(exp->offset,
           "Could not subtract to or from void pointer\n");
         int ret = type_cmp(lhs->next, rhs->next); // Don't care about const/volatile bc they do not affect type size
-        if(ret == TYPE_CMP_NEQ) error_row_col_exit(exp->offset, 
+        if(ret == TYPE_CMP_NEQ) return type_error_cont(exp->offset, 
           "Pointer subtraction can only be applied to pointers of the same base type\n");
         return type_getint(TYPE_PTR_DIFF_TYPE);
       }
-      error_row_col_exit(exp->offset, "Operator \"%s\" cannot be applied here", op_str);
+      return type_error_cont(exp->offset, "Operator \"%s\" cannot be applied here", op_str);
     } break;
     // No extra check for assign because shift operator returns the lhs always
     case EXP_LSHIFT: case EXP_RSHIFT: 
     case EXP_LSHIFT_ASSIGN: case EXP_RSHIFT_ASSIGN: { // Shift operator preserves the type
-      rhs = type_typeof(cxt, ast_getchild(exp, 1), options); 
+      rhs = types[1]; 
       if(type_is_general_int(lhs) && type_is_general_int(rhs)) return lhs;
-      error_row_col_exit(exp->offset, 
+      return type_error_cont(exp->offset, 
         "Operator \"%s\" must be applied to integer types", op_str);
     } break;
     case EXP_LESS: case EXP_GREATER: case EXP_LEQ: case EXP_GEQ: 
     case EXP_EQ: case EXP_NEQ: { // Comparison requires the same as +/-
-      rhs = type_typeof(cxt, ast_getchild(exp, 1), options); 
+      rhs = types[1]; 
       if(type_is_general_int(lhs) && type_is_general_int(rhs)) { 
         type_t *after_convert = type_int_convert(lhs, rhs); // Must convert to same length and must not lose information
         type_cast(after_convert, lhs, TYPE_CAST_IMPLICIT, ast_getchild(exp, 0)->offset);
@@ -1220,44 +1544,45 @@ type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options) {
       } else if(type_is_ptr(lhs) && type_is_ptr(rhs)) {
         if(!type_is_void_ptr(lhs) && !type_is_void_ptr(rhs)) {
           int ret = type_cmp(lhs->next, rhs->next); // Compare target type of pointers
-          if(ret == TYPE_CMP_NEQ) error_row_col_exit(exp->offset, 
+          if(ret == TYPE_CMP_NEQ) return type_error_cont(exp->offset, 
             "Pointer comparison must have the same base type (except const/volatile)\n");
         }
       }
       return type_getint(BASETYPE_INT); // Comparison result is always signed int
     } break;
     case EXP_LOGICAL_AND: case EXP_LOGICAL_OR: { // && || accepts both pointer and integer as operands
-      rhs = type_typeof(cxt, ast_getchild(exp, 1), options); 
+      rhs = types[1]; 
       if(!type_is_general_int(lhs) && !type_is_ptr(lhs)) 
-        error_row_col_exit(ast_getchild(exp, 0)->offset, 
+        return type_error_cont(ast_getchild(exp, 0)->offset, 
           "Operatpr \"%s\" must be applied to integer or pointer type\n", op_str);
       if(!type_is_general_int(rhs) && !type_is_ptr(rhs)) 
-        error_row_col_exit(ast_getchild(exp, 1)->offset, 
+        return type_error_cont(ast_getchild(exp, 1)->offset, 
           "Operatpr \"%s\" must be applied to integer or pointer type\n", op_str);
+      return type_getint(BASETYPE_INT); // Logical result is always signed int
     } break;
     case EXP_COND: { // This operator has three operands. Note that op2 and op3 could have void type
       token_t *op2 = ast_getchild(exp, 1);
       token_t *op3 = ast_getchild(exp, 2);
       assert(op2 && op3);
       if(!type_is_general_int(lhs) && !type_is_ptr(lhs)) // First check condition
-        error_row_col_exit(ast_getchild(exp, 0)->offset, 
+        return type_error_cont(ast_getchild(exp, 0)->offset, 
           "The first operand of condition operator must be integer or pointer type\n");
-      type_t *type2 = type_typeof(cxt, op2, options);
-      type_t *type3 = type_typeof(cxt, op3, options);
+      type_t *type2 = types[1];
+      type_t *type3 = types[2];
       int ret = type_cmp(type2, type3);
       if(ret != TYPE_CMP_EQ) // Must be strictly identical, because at run time both could be used as the operand
-        error_row_col_exit(exp->offset, 
+        return type_error_cont(exp->offset, 
           "The type of two options in conditional expression must be identical (you may use cast)\n");
       return type2;
     }
     case EXP_ASSIGN: { // All assignments return the type of the left operand
-      rhs = type_typeof(cxt, ast_getchild(exp, 1), options); 
+      rhs = types[1]; 
       type_cast(lhs, rhs, TYPE_CAST_IMPLICIT, exp->offset); 
       return lhs;
     } break;
     case EXP_COMMA: { // Comma operator only returns the value of the second expression
-      // Note that here we also perform type check for LHS by recursively calling this function
-      rhs = type_typeof(cxt, ast_getchild(exp, 1), options); 
+      // Note that the type of LHS has also been checked when it was evaluated
+      rhs = types[1]; 
       return rhs;
     }
     default: assert(0);
@@ -6,7 +6,9 @@
 #include "list.h"
 #include "bintree.h"
 #include "token.h"
+#include "ast.h"
 #include "str.h"
+#include "arena.h"
 
 #define SCOPE_LEVEL_GLOBAL  0
 
@@ -22,6 +24,7 @@
 #define TYPE_LONG_SIZE      8
 #define TYPE_LLONG_SIZE     16
 #define TYPE_INT_SIZE_MAX   16 // This is the maximum size we support for constant evaluation
+#define TYPE_CACHE_LINE_SIZE 64 // Used by type_print_layout()
 
 #define TYPE_OPERAND_MAX    3  // Maximum number of operands for expressions except function call
 
@@ -54,7 +57,7 @@
 // Used with type_cast
 #define TYPE_CAST_EXPLICIT         0          // Explicit cast using cast operator
 #define TYPE_CAST_IMPLICIT         1          // Implicit cast with array indexing, func arg, and assignment
-#define TYPE_CAST_INVALID          0          // Return value: invalid cast (never used - the function reports error)
+#define TYPE_CAST_INVALID          0          // Return value: invalid cast (only when errors are collected)
 #define TYPE_CAST_SIGN_EXT         1          // Return value: should perform sign extension
 #define TYPE_CAST_ZERO_EXT         2          // Return value: should perform zero extension
 #define TYPE_CAST_TRUNCATE         3          // Return value: should truncate
@@ -73,7 +76,7 @@ enum {
   SCOPE_TYPE_COUNT,
 };
 
-// We track objects using a centralized list per scope to simplify memory management
+// Objects are allocated from an arena per scope to simplify memory management
 // All objects allocated within the scope will be freed when the scope gets poped
 // No ownership of memory is therefore enforced, i.e. objects do not own each other.
 enum {
@@ -82,21 +85,59 @@ enum {
   OBJ_FIELD = 2,
   OBJ_ENUM  = 3,
   OBJ_VALUE = 4,   // Note that not all values are named
+  OBJ_BINDING = 5, // Owns nothing; Has no free handler
+  OBJ_ARGS = 6,    // Argument arrays of function types; Has no free handler
   OBJ_TYPE_COUNT,
 };
 
+// Precedes each object in the scope arena, such that objects can be visited when the scope is freed
+typedef struct {
+  int kind;                  // OBJ_ series
+  int size;                  // Bytes from this header to the next one
+} obj_header_t;
+
+struct symbol_t;
+
+// Binds a name to a value in one scope. Allocated in the arena of the scope
+typedef struct binding_t {
+  void *value;
+  int level;                            // Level of the scope that declares the name
+  struct binding_t *shadowed;           // Binding of the same name in an enclosing scope; NULL if none
+  struct binding_t *log_next;           // Earlier binding of the same scope, i.e. undo log
+  struct symbol_t *symbol;
+  int seq;                              // Number of bindings made before it in the context
+} binding_t;
+
+// One per name and domain for the whole context; The head is the innermost visible binding
+typedef struct symbol_t {
+  char *name;                           // Interned copy
+  binding_t *head;                      // NULL if the name is not visible
+} symbol_t;
+
 // A statement block creates a new scope. The bottomost scope is the global scope
 typedef struct {
   int level;                            // 0 means global
-  hashtable_t *names[SCOPE_TYPE_COUNT]; // enum, var, struct, union, udef, i.e. symbol table. Does not own anything
-  list_t *objs[OBJ_TYPE_COUNT];      // Objects allocates while processing the scope; Freed on scope free; Owns everything
+  binding_t *log;                       // Bindings made in this scope, latest first; Undone on scope decurse
+  arena_t arena;                        // Objects allocated while processing the scope; Freed on scope free; Owns everything
 } scope_t;
 
-typedef void (*obj_free_func_t)(void *);   // Call back handlers for object free; Register one for each type
+// Call back handlers for object free; Register one for each type. They only release memory owned by
+// the object, since the object itself is released with the arena
+typedef void (*obj_free_func_t)(void *);
 extern obj_free_func_t obj_free_func_list[OBJ_TYPE_COUNT + 1]; // Registered call back functions for objects
 
-typedef struct {
+typedef struct type_cxt_struct_t {
   stack_t *scopes;
+  hashtable_t *symbols[SCOPE_TYPE_COUNT]; // enum, var, struct, union, udef, i.e. symbol table. Name -> symbol_t *
+  hashtable_t *canon_types;               // Canonical types, see type_canon(); Key and value are the same type_t *
+  arena_t arena;                          // Symbols, interned names and canonical types; Lives as long as the context
+  arena_t eval_arena;                     // Temporary values of constant evaluation, see eval_value_init()
+  int eval_depth;                         // Nesting level of eval_const_exp(); Temporaries are released at level 0
+  ast_walk_t walk;                        // Stacks of post-order traversals over expressions
+  str_t *print_channels[TYPE_PRINT_CHANNEL_MAX]; // Buffers of type_print_str(); Owns memory
+  struct type_cxt_struct_t *frozen_global;       // Searched for names not found in this context; Read-only; NULL if none
+  int frozen_limit;                       // Bindings of frozen_global with seq at or after it are not visible
+  int binding_count;                      // Bindings made so far; Gives the seq of the next one
 } type_cxt_t;
 
 typedef uint64_t typeid_t;
@@ -114,10 +155,12 @@ typedef struct type_t_struct {
   };
   union {
     int array_size;         // If decl_prop is array sub this stores the (optional) size of the array
-    struct {
-      list_t *arg_list;     // If decl_prop is function call this stores a list of type_t *; Owns the list
-      bintree_t *arg_index; // Binary tree using arg name as key; Owns the bin tree
+    struct {                // If decl_prop is function call these describe the arguments
+      struct type_t_struct **arg_types; // Argument types in order; Allocated with the type
+      char **arg_names;     // Argument names in order; NULL if unnamed; Do not own
+      int arg_count;
       int vararg;           // Set if varadic argument function
+      hashval_t arg_hash;   // Hash of argument types, see type_arg_hash(); Equal types have equal hashes
     };
     struct {                // This duplicates the two fields from field_t
       int bitfield_size;
@@ -139,6 +182,7 @@ extern int_prop_t ints[11];           // An array of integer properties for conv
 extern type_t type_builtin_ints[11];  // An array of built in integer types
 extern type_t type_builtin_const_char;
 extern type_t type_builtin_void;
+extern type_t type_builtin_error;
 extern type_t type_builtin_string_template;
 
 typedef enum {
@@ -153,6 +197,10 @@ typedef enum {
 
 struct cgen_data_struct_t; // Defined in cgen.h
 
+// 128-bit integers aligned to 8 bytes, such that values can be allocated from arenas (see ARENA_ALIGN)
+typedef __uint128_t value_uint128_t __attribute__((aligned(8)));
+typedef __int128_t value_int128_t __attribute__((aligned(8)));
+
 typedef struct value_t_struct {
   type_t *type;         // Do not own
   addrtype_t addrtype;
@@ -168,6 +216,8 @@ typedef struct value_t_struct {
     int32_t  int32;
     uint64_t uint64;
     int64_t  int64;
+    value_uint128_t uint128; // Constants of up to 16 bytes, see EVAL_MAX_CONST_SIZE
+    value_int128_t  int128;
     int64_t  offset;                  // Local address uses this field
     struct cgen_data_struct_t *gdata; // Global address uses this field
   };
@@ -180,6 +230,8 @@ typedef struct comp_t_struct {
   list_t *field_list;     // A list of field *; Does not contain promoted comp types; Owns memory;
   bintree_t *field_index; // These two provides both fast named access, and ordered storage; Owns memory
   size_t size;
+  size_t align;           // Alignment of the type; 1 if no definition
+  int has_anon;           // Fields of anonymous composite members are promoted into field_list
   int has_definition;     // Whether it is a forward definition (0 means yes)
 } comp_t;
 
@@ -194,6 +246,14 @@ typedef struct {
   type_t *type;        // Type of this field; Do not own memory
 } field_t;
 
+// Summary of type_print_layout()
+typedef struct {
+  size_t padding;          // Bytes not used by any field, including tail padding
+  int hole_count;          // Runs of unused bytes, including tail padding
+  int straddle_count;      // Fields that straddle a cache line if the composite is aligned to one
+  size_t min_size;         // Size with fields sorted by alignment; Same as size if fields cannot be reordered
+} type_layout_t;
+
 typedef struct enum_t_struct {
   char *offset;            // If name is not NULL this is the token's offset
   char *name;              // NULL if unnamed enum
@@ -215,10 +275,19 @@ typedef struct {
   type_t *result_type;
 } type_exp_t;
 
+typedef struct {           // Argument to callbacks of type_typeof()
+  type_cxt_t *cxt;
+  uint32_t options;
+} type_typeof_arg_t;
+
 static inline void type_error_not_supported(const char *offset, decl_prop_t decl_prop) {
   error_row_col_exit(offset, "Sorry, type \"%s\" not yet supported\n", token_decl_print(decl_prop));
 }
 
+// Reports a recoverable error and evaluates to the error type. Operators with an error-typed operand
+// evaluate to the error type without reporting, such that one mistake is only reported once
+#define type_error_cont(s, fmt, ...) (error_row_col_cont(s, fmt, ##__VA_ARGS__), &type_builtin_error)
+
 static inline type_t *type_getint(decl_prop_t decl_prop) {
   assert(BASETYPE_GET(decl_prop) >= BASETYPE_CHAR && BASETYPE_GET(decl_prop) <= BASETYPE_ULLONG);
   return &type_builtin_ints[BASETYPE_INDEX(decl_prop)];
@@ -237,6 +306,9 @@ static inline int type_is_char(type_t *type) {
 static inline int type_is_void(type_t *type) {
   return BASETYPE_GET(type->decl_prop) == BASETYPE_VOID;
 }
+static inline int type_is_error(type_t *type) {
+  return BASETYPE_GET(type->decl_prop) == BASETYPE_ERROR;
+}
 // Returns the size of integers
 static inline int type_get_int_size(type_t *type) {
   assert(type_is_int(type));
@@ -288,12 +360,15 @@ static inline int type_is_general_int(type_t *type) {
   return type_is_int(type) || type_is_enum(type) || type_is_bitfield(type);
 }
 static inline const char *type_printable_name(const char *name) { return name ? name : "<No Name>"; }
+static inline size_t type_align_up(size_t x, size_t align) { return (x + align - 1) / align * align; }
 
 // Returns a const char[full_size] type object
-type_t *type_get_strliteral(type_cxt_t *cxt, size_t full_size, char *offset); 
+type_t *type_get_strliteral(type_cxt_t *cxt, size_t full_size); 
 
-char *type_print_str(int channel, type_t *type, const char *name, int print_comp_body);
+char *type_print_str(type_cxt_t *cxt, int channel, type_t *type, const char *name, int print_comp_body);
 str_t *type_print(type_t *type, const char *name, str_t *s, int print_comp_body, int level);
+void type_field_range(field_t *field, size_t *begin, size_t *end);
+str_t *type_print_layout(type_t *type, str_t *s, type_layout_t *layout);
 
 scope_t *scope_init(int level);
 void scope_free(scope_t *scope);
@@ -301,8 +376,7 @@ void init_builtin_types();
 type_cxt_t *type_sys_init();
 void type_sys_free(type_cxt_t *cxt); 
 
-hashtable_t *scope_atlevel(type_cxt_t *cxt, int level, int domain);
-hashtable_t *scope_top_name(type_cxt_t *cxt, int domain);
+symbol_t *scope_symbol(type_cxt_t *cxt, int domain, char *name, int create); // Returns NULL if not found and !create
 int scope_numlevel(type_cxt_t *cxt);
 void scope_recurse(type_cxt_t *cxt);
 void scope_decurse(type_cxt_t *cxt);
@@ -310,10 +384,14 @@ void *scope_top_find(type_cxt_t *cxt, int domain, void *key);
 void scope_top_insert(type_cxt_t *cxt, int domain, void *key, void *value);
 void *scope_top_remove(type_cxt_t *cxt, int domain, void *key);
 void *scope_search(type_cxt_t *cxt, int domain, void *name);
-void scope_top_obj_insert(type_cxt_t *cxt, int domain, void *obj); // Adding an object into the topmost scope for memory mgmt
+void *scope_top_obj_alloc(type_cxt_t *cxt, int kind, size_t size); // Allocates an object in the topmost scope for memory mgmt
 
 type_t *type_init(type_cxt_t *cxt);
+hashval_t type_arg_hash(type_t *type);
 type_t *type_init_from(type_cxt_t *cxt, type_t *from, char *offset);
+hashval_t type_hash_cb(void *a);
+int type_eq_cb(void *a, void *b);
+type_t *type_canon(type_cxt_t *cxt, type_t *type);
 void type_free(void *ptr);
 comp_t *comp_init(type_cxt_t *cxt, char *name, char *source_offset, int has_definition);
 void comp_free(void *ptr);
@@ -327,6 +405,7 @@ void value_free(void *ptr);
 // Returns a type * object given a T_DECL node and optionally base type
 type_t *type_gettype(type_cxt_t *cxt, token_t *decl, token_t *basetype, uint32_t flags); 
 comp_t *type_getcomp(type_cxt_t *cxt, token_t *token, int is_forward);
+size_t type_alignof(type_t *type);
 enum_t *type_getenum(type_cxt_t *cxt, token_t *token);
 
 type_t *type_int_convert(type_t *lhs, type_t *rhs);
@@ -338,6 +417,10 @@ type_t *type_typeof_op_1(type_cxt_t *cxt, token_type_t op, type_t *op1);
 type_t *type_typeof_op_2(type_cxt_t *cxt, token_type_t op, type_t *op1, type_t *op2);
 type_t *type_typeof_op_3(type_cxt_t *cxt, token_type_t op, type_t *op1, type_t *op2, type_t *op3);
 type_t *type_typeof_op(type_cxt_t *cxt, token_type_t op, type_t *op1, type_t *op2, type_t *op3);
+int type_typeof_arity(token_t *exp, void *arg);
+void *type_typeof_visit(token_t *exp, void **results, void *arg);
 type_t *type_typeof(type_cxt_t *cxt, token_t *exp, uint32_t options); // Evaluate the type of an expression
+int type_annotate(type_cxt_t *cxt, token_t *token);
+type_t *type_typeof_node(type_cxt_t *cxt, token_t *exp, type_t **types, uint32_t options);
 
 #endif
\ No newline at end of file